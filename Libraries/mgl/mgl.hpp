@@ -12,12 +12,31 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include "./mglAnimation.hpp"    // IWYU pragma: keep
 #include "./mglApp.hpp"          // IWYU pragma: keep
+#include "./mglBVH.hpp"          // IWYU pragma: keep
+#include "./mglBounds.hpp"       // IWYU pragma: keep
+#include "./mglBuffers.hpp"      // IWYU pragma: keep
 #include "./mglCamera.hpp"       // IWYU pragma: keep
 #include "./mglConventions.hpp"  // IWYU pragma: keep
 #include "./mglError.hpp"        // IWYU pragma: keep
+#include "./mglFramePacer.hpp"   // IWYU pragma: keep
+#include "./mglFramePacket.hpp"  // IWYU pragma: keep
+#include "./mglInputLog.hpp"     // IWYU pragma: keep
+#include "./mglInstancing.hpp"   // IWYU pragma: keep
+#include "./mglJobs.hpp"         // IWYU pragma: keep
+#include "./mglMappedFile.hpp"   // IWYU pragma: keep
 #include "./mglMesh.hpp"         // IWYU pragma: keep
+#include "./mglMeshProcessing.hpp" // IWYU pragma: keep
+#include "./mglObjLoader.hpp"    // IWYU pragma: keep
+#include "./mglPak.hpp"          // IWYU pragma: keep
+#include "./mglPool.hpp"         // IWYU pragma: keep
 #include "./mglScenegraph.hpp"   // IWYU pragma: keep
 #include "./mglShader.hpp"       // IWYU pragma: keep
+#include "./mglStaticBatching.hpp" // IWYU pragma: keep
+#include "./mglStats.hpp"        // IWYU pragma: keep
+#include "./mglStreaming.hpp"    // IWYU pragma: keep
+#include "./mglTransformHierarchy.hpp" // IWYU pragma: keep
+#include "./mglUploadQueue.hpp"  // IWYU pragma: keep
 
 #endif /* MGL_HPP */
@@ -0,0 +1,236 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Keyframe Animation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglAnimation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <stdexcept>
+
+namespace mgl {
+
+static void checkKeys(std::size_t times, std::size_t values) {
+  if (times != values) {
+    std::cerr << "[ERROR] Animation channel has " << times << " times and "
+              << values << " values" << std::endl;
+    throw std::runtime_error("Mismatched animation keys.");
+  }
+}
+
+////////////////////////////////////////////////////////////////////// KeyCursor
+
+unsigned int KeyCursor::seek(const std::vector<float> &times, float time,
+                             float &alpha) const {
+  const unsigned int last = static_cast<unsigned int>(times.size()) - 1;
+  if (last == 0 || time <= times[0]) {
+    alpha = 0.0f;
+    return Key = 0;
+  }
+  if (time >= times[last]) {
+    alpha = 1.0f;
+    return Key = last - 1;
+  }
+  // Same or neighbouring interval as last time, otherwise search
+  unsigned int key = std::min(Key, last - 1);
+  if (time < times[key] || time >= times[key + 1]) {
+    if (key + 2 <= last && time >= times[key + 1] && time < times[key + 2]) {
+      key++;
+    } else if (key > 0 && time >= times[key - 1] && time < times[key]) {
+      key--;
+    } else {
+      key = static_cast<unsigned int>(
+                std::upper_bound(times.begin(), times.end(), time) -
+                times.begin()) -
+            1;
+    }
+  }
+  alpha = (time - times[key]) / (times[key + 1] - times[key]);
+  return Key = key;
+}
+
+////////////////////////////////////////////////////////////////// VectorChannel
+
+VectorChannel::VectorChannel(const std::vector<float> &times,
+                             const std::vector<glm::vec3> &values)
+    : Times(times) {
+  checkKeys(times.size(), values.size());
+  if (values.empty())
+    return;
+  glm::vec3 max = values[0];
+  Min = values[0];
+  for (const glm::vec3 &value : values) {
+    Min = glm::min(Min, value);
+    max = glm::max(max, value);
+  }
+  Step = (max - Min) / 65535.0f;
+  Keys.reserve(3 * values.size());
+  for (const glm::vec3 &value : values) {
+    for (int axis = 0; axis < 3; axis++) {
+      const float q =
+          Step[axis] > 0.0f ? (value[axis] - Min[axis]) / Step[axis] : 0.0f;
+      Keys.push_back(static_cast<std::uint16_t>(std::lround(q)));
+    }
+  }
+}
+
+bool VectorChannel::isEmpty() const { return Times.empty(); }
+
+glm::vec3 VectorChannel::getValue(unsigned int key) const {
+  return Min + Step * glm::vec3(Keys[3 * key], Keys[3 * key + 1],
+                                Keys[3 * key + 2]);
+}
+
+glm::vec3 VectorChannel::evaluate(float time) const {
+  if (Times.size() == 1)
+    return getValue(0);
+  float alpha;
+  const unsigned int key = Cursor.seek(Times, time, alpha);
+  return glm::mix(getValue(key), getValue(key + 1), alpha);
+}
+
+std::size_t VectorChannel::getMemoryUsage() const {
+  return Times.capacity() * sizeof(float) +
+         Keys.capacity() * sizeof(std::uint16_t);
+}
+
+std::size_t VectorChannel::getKeyCount() const { return Times.size(); }
+
+float VectorChannel::getTime(unsigned int key) const { return Times[key]; }
+
+//////////////////////////////////////////////////////////////// RotationChannel
+
+static const float SMALLEST_THREE_RANGE = 0.70710678f; // 1 / sqrt(2)
+static const float SMALLEST_THREE_SCALE = 32767.0f;
+
+void RotationChannel::encode(const glm::quat &rotation,
+                             std::uint16_t packed[3]) {
+  const glm::quat q = glm::normalize(rotation);
+  const float c[4] = {q.x, q.y, q.z, q.w};
+  int largest = 0;
+  for (int i = 1; i < 4; i++) {
+    if (std::fabs(c[i]) > std::fabs(c[largest]))
+      largest = i;
+  }
+  // q and -q are the same rotation; keep the dropped component positive
+  const float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+  for (int i = 0, j = 0; i < 4; i++) {
+    if (i == largest)
+      continue;
+    const float normalized =
+        (sign * c[i] / SMALLEST_THREE_RANGE + 1.0f) * 0.5f;
+    packed[j++] = static_cast<std::uint16_t>(
+        std::lround(glm::clamp(normalized, 0.0f, 1.0f) * SMALLEST_THREE_SCALE));
+  }
+  packed[0] |= static_cast<std::uint16_t>((largest & 1) << 15);
+  packed[1] |= static_cast<std::uint16_t>((largest >> 1) << 15);
+}
+
+glm::quat RotationChannel::decode(const std::uint16_t packed[3]) {
+  const int largest = (packed[0] >> 15) | ((packed[1] >> 15) << 1);
+  float c[4];
+  float sum = 0.0f;
+  for (int i = 0, j = 0; i < 4; i++) {
+    if (i == largest)
+      continue;
+    const float normalized = (packed[j++] & 0x7fff) / SMALLEST_THREE_SCALE;
+    c[i] = (normalized * 2.0f - 1.0f) * SMALLEST_THREE_RANGE;
+    sum += c[i] * c[i];
+  }
+  c[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+  return glm::quat(c[3], c[0], c[1], c[2]);
+}
+
+RotationChannel::RotationChannel(const std::vector<float> &times,
+                                 const std::vector<glm::quat> &values)
+    : Times(times) {
+  checkKeys(times.size(), values.size());
+  Keys.resize(3 * values.size());
+  for (std::size_t i = 0; i < values.size(); i++) {
+    encode(values[i], &Keys[3 * i]);
+  }
+}
+
+bool RotationChannel::isEmpty() const { return Times.empty(); }
+
+glm::quat RotationChannel::evaluate(float time) const {
+  if (Times.size() == 1)
+    return decode(&Keys[0]);
+  float alpha;
+  const unsigned int key = Cursor.seek(Times, time, alpha);
+  return glm::slerp(decode(&Keys[3 * key]), decode(&Keys[3 * key + 3]),
+                    alpha);
+}
+
+std::size_t RotationChannel::getMemoryUsage() const {
+  return Times.capacity() * sizeof(float) +
+         Keys.capacity() * sizeof(std::uint16_t);
+}
+
+std::size_t RotationChannel::getKeyCount() const { return Times.size(); }
+
+float RotationChannel::getTime(unsigned int key) const { return Times[key]; }
+
+glm::quat RotationChannel::getValue(unsigned int key) const {
+  return decode(&Keys[3 * key]);
+}
+
+///////////////////////////////////////////////////////////////// AnimationTrack
+
+glm::mat4 AnimationTrack::evaluate(float time) const {
+  glm::mat4 matrix(1.0f);
+  if (!Translation.isEmpty())
+    matrix = glm::translate(matrix, Translation.evaluate(time));
+  if (!Rotation.isEmpty())
+    matrix *= glm::mat4_cast(Rotation.evaluate(time));
+  if (!Scale.isEmpty())
+    matrix = glm::scale(matrix, Scale.evaluate(time));
+  return matrix;
+}
+
+std::size_t AnimationTrack::getMemoryUsage() const {
+  return sizeof(AnimationTrack) + Translation.getMemoryUsage() +
+         Rotation.getMemoryUsage() + Scale.getMemoryUsage();
+}
+
+// Keys of a channel that a start/end layer reproduces exactly: none, a
+// constant, or one key at 0 and one at 1.
+template <typename Channel> static bool isLayerChannel(const Channel &channel) {
+  const std::size_t keys = channel.getKeyCount();
+  return keys <= 1 || (keys == 2 && channel.getTime(0) == 0.0f &&
+                       channel.getTime(1) == 1.0f);
+}
+
+static glm::vec4 toVec4(const glm::quat &q) {
+  return glm::vec4(q.x, q.y, q.z, q.w);
+}
+
+bool AnimationTrack::getLayer(AnimationLayer &layer) const {
+  if (!isLayerChannel(Translation) || !isLayerChannel(Rotation) ||
+      !isLayerChannel(Scale))
+    return false;
+  layer = AnimationLayer();
+  if (!Translation.isEmpty()) {
+    const unsigned int last = Translation.getKeyCount() == 2 ? 1 : 0;
+    layer.StartTranslation = glm::vec4(Translation.getValue(0), 0.0f);
+    layer.EndTranslation = glm::vec4(Translation.getValue(last), 0.0f);
+  }
+  if (!Rotation.isEmpty()) {
+    const unsigned int last = Rotation.getKeyCount() == 2 ? 1 : 0;
+    layer.StartRotation = toVec4(Rotation.getValue(0));
+    layer.EndRotation = toVec4(Rotation.getValue(last));
+  }
+  if (!Scale.isEmpty()) {
+    const unsigned int last = Scale.getKeyCount() == 2 ? 1 : 0;
+    layer.StartScale = glm::vec4(Scale.getValue(0), 1.0f);
+    layer.EndScale = glm::vec4(Scale.getValue(last), 1.0f);
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Keyframe Animation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_ANIMATION_HPP
+#define MGL_ANIMATION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+namespace mgl {
+
+class KeyCursor;
+class VectorChannel;
+class RotationChannel;
+class AnimationTrack;
+struct AnimationLayer;
+
+////////////////////////////////////////////////////////////////////// KeyCursor
+
+// Remembers the key interval of the last lookup, so that playing a channel
+// forwards or backwards costs O(1) per evaluation instead of a binary search.
+class KeyCursor {
+public:
+  // Index i of the interval [Times[i], Times[i+1]) containing time, clamped
+  // to the valid range; the blend factor inside it goes to alpha.
+  unsigned int seek(const std::vector<float> &times, float time,
+                    float &alpha) const;
+
+private:
+  mutable unsigned int Key = 0;
+};
+
+////////////////////////////////////////////////////////////////// VectorChannel
+
+// Translation or scale keys, each component quantized to 16 bits over the
+// range spanned by the channel.
+class VectorChannel {
+public:
+  VectorChannel() = default;
+  VectorChannel(const std::vector<float> &times,
+                const std::vector<glm::vec3> &values);
+  bool isEmpty() const;
+  glm::vec3 evaluate(float time) const;
+  std::size_t getMemoryUsage() const;
+  std::size_t getKeyCount() const;
+  float getTime(unsigned int key) const;
+  glm::vec3 getValue(unsigned int key) const;
+
+private:
+  std::vector<float> Times;
+  std::vector<std::uint16_t> Keys; // 3 per key
+  glm::vec3 Min = glm::vec3(0.0f);
+  glm::vec3 Step = glm::vec3(0.0f);
+  KeyCursor Cursor;
+};
+
+//////////////////////////////////////////////////////////////// RotationChannel
+
+// Rotation keys in smallest-three form: the largest quaternion component is
+// dropped (and made positive) and the other three are stored in 15 bits each,
+// with the dropped index in the spare bits, for 6 bytes per key.
+class RotationChannel {
+public:
+  RotationChannel() = default;
+  RotationChannel(const std::vector<float> &times,
+                  const std::vector<glm::quat> &values);
+  bool isEmpty() const;
+  glm::quat evaluate(float time) const;
+  std::size_t getMemoryUsage() const;
+  std::size_t getKeyCount() const;
+  float getTime(unsigned int key) const;
+  glm::quat getValue(unsigned int key) const;
+
+  static void encode(const glm::quat &q, std::uint16_t packed[3]);
+  static glm::quat decode(const std::uint16_t packed[3]);
+
+private:
+  std::vector<float> Times;
+  std::vector<std::uint16_t> Keys; // 3 per key
+  KeyCursor Cursor;
+};
+
+///////////////////////////////////////////////////////////////// AnimationTrack
+
+// Independent translation, rotation and scale channels of one node. Missing
+// channels evaluate to the identity.
+class AnimationTrack {
+public:
+  VectorChannel Translation;
+  RotationChannel Rotation;
+  VectorChannel Scale;
+
+  glm::mat4 evaluate(float time) const;
+  std::size_t getMemoryUsage() const;
+  // The track as a single start/end pair over [0,1], as evaluated on the GPU
+  // by instanced animation. False if a channel has other keys than that.
+  bool getLayer(AnimationLayer &layer) const;
+};
+
+///////////////////////////////////////////////////////////////// AnimationLayer
+
+// One level of a GPU-evaluated hierarchy: T * R * S blended between a start
+// and an end state. Rotations are quaternions stored as (x, y, z, w); padded
+// to vec4s to match the std430 layout of the shader storage block.
+struct AnimationLayer {
+  glm::vec4 StartTranslation = glm::vec4(0.0f);
+  glm::vec4 EndTranslation = glm::vec4(0.0f);
+  glm::vec4 StartRotation = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  glm::vec4 EndRotation = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  glm::vec4 StartScale = glm::vec4(1.0f);
+  glm::vec4 EndScale = glm::vec4(1.0f);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_ANIMATION_HPP */
@@ -9,10 +9,16 @@
 #include "./mglApp.hpp"
 
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <iostream>
 #include <stdexcept>
+#include <thread>
 
 #include "./mglError.hpp" // IWYU pragma: keep -- required in debug mode
+#include "./mglJobs.hpp"
+#include "./mglUploadQueue.hpp"
 
 namespace mgl {
 
@@ -23,7 +29,15 @@ static void window_close_callback(GLFWwindow *window) {
 }
 
 static void window_size_callback(GLFWwindow *window, int width, int height) {
-  Engine::getInstance().getApp()->windowSizeCallback(window, width, height);
+  InputEvent event;
+  event.Type = InputEventType::WindowSize;
+  event.A = width;
+  event.B = height;
+  Engine::getInstance().handleInput(window, event);
+}
+
+static void window_refresh_callback(GLFWwindow *window) {
+  Engine::getInstance().requestRedraw();
 }
 
 static void glfw_error_callback(int error, const char *description) {
@@ -31,28 +45,50 @@ static void glfw_error_callback(int error, const char *description) {
 }
 
 static void cursor_pos_callback(GLFWwindow *window, double xpos, double ypos) {
-  Engine::getInstance().getApp()->cursorCallback(window, xpos, ypos);
+  InputEvent event;
+  event.Type = InputEventType::Cursor;
+  event.X = xpos;
+  event.Y = ypos;
+  Engine::getInstance().handleInput(window, event);
 }
 
 static void key_callback(GLFWwindow *window, int key, int scancode, int action,
                          int mods) {
-  Engine::getInstance().getApp()->keyCallback(window, key, scancode, action,
-                                              mods);
+  InputEvent event;
+  event.Type = InputEventType::Key;
+  event.A = key;
+  event.B = scancode;
+  event.C = action;
+  event.D = mods;
+  Engine::getInstance().handleInput(window, event);
 }
 
 static void mouse_button_callback(GLFWwindow *window, int button, int action,
                                   int mods) {
-  Engine::getInstance().getApp()->mouseButtonCallback(window, button, action,
-                                                      mods);
+  InputEvent event;
+  event.Type = InputEventType::MouseButton;
+  event.A = button;
+  event.C = action;
+  event.D = mods;
+  glfwGetCursorPos(window, &event.X, &event.Y);
+  Engine::getInstance().handleInput(window, event);
 }
 
 static void scroll_callback(GLFWwindow *window, double xoffset,
                             double yoffset) {
-  Engine::getInstance().getApp()->scrollCallback(window, xoffset, yoffset);
+  InputEvent event;
+  event.Type = InputEventType::Scroll;
+  event.X = xoffset;
+  event.Y = yoffset;
+  Engine::getInstance().handleInput(window, event);
 }
 
-static void joystick_callback(int jid, int event) {
-  Engine::getInstance().getApp()->joystickCallback(jid, event);
+static void joystick_callback(int jid, int event_type) {
+  InputEvent event;
+  event.Type = InputEventType::Joystick;
+  event.A = jid;
+  event.B = event_type;
+  Engine::getInstance().handleInput(nullptr, event);
 }
 
 ////////////////////////////////////////////////////////////////////////// SETUP
@@ -60,7 +96,14 @@ static void joystick_callback(int jid, int event) {
 Engine::Engine(void)
     : WindowWidth(640), WindowHeight(480), GlApp(nullptr), Window(nullptr),
       WindowTitle("OpenGL App GLFW Window 2025(c) Carlos Martinho"), GlMajor(3),
-      GlMinor(3), Fullscreen(0), Vsync(0) {}
+      GlMinor(3), Fullscreen(0), Vsync(0), Headless(false), FrameLimit(0),
+      FrameCount(0), MinFrameTime(0.0), MaxFrameTime(0.0), ReplayTimestep(0.0),
+      CursorX(0.0), CursorY(0.0), Threaded(false), Simulating(false),
+      SimulationFailed(false), PendingInputTime(0.0), OnDemand(false),
+      IdleTimeout(0.0), RedrawRequested(true), FramesSkipped(0),
+      FixedTimestep(0.0), MaxSteps(5), Accumulator(0.0),
+      InterpolationAlpha(1.0), SimulationSteps(0), AsyncUploads(false),
+      UploadWindow(nullptr) {}
 
 Engine::~Engine(void) {}
 
@@ -87,6 +130,84 @@ void Engine::setWindow(int width, int height, const char *title, int fullscreen,
   Vsync = vsync;
 }
 
+void Engine::setHeadless(bool headless) { Headless = headless; }
+
+void Engine::setFrameLimit(unsigned long long frames) { FrameLimit = frames; }
+
+unsigned long long Engine::getFrameCount() const { return FrameCount; }
+
+const FrameStats &Engine::getTotalStats() const { return TotalStats; }
+
+double Engine::getMinFrameTime() const { return MinFrameTime; }
+
+double Engine::getMaxFrameTime() const { return MaxFrameTime; }
+
+void Engine::setStatsWindow(std::size_t frames) { History.setWindow(frames); }
+
+StatRange Engine::getStatRange(StatCounter counter) const {
+  return History.range(counter);
+}
+
+const StatsHistory &Engine::getStatsHistory() const { return History; }
+
+void Engine::dumpStatsCsv(const std::string &filename) {
+  // Fail before the run rather than losing it at the end
+  if (!std::ofstream(filename, std::ios::app)) {
+    std::cerr << "[ERROR] Failed to open stats file: " << filename << std::endl;
+    throw std::runtime_error("Failed to open stats file.");
+  }
+  StatsCsv = filename;
+  History.setKeepAll(true);
+}
+
+void Engine::recordInput(const std::string &filename) {
+  Recorder = std::make_unique<InputLogWriter>(filename);
+}
+
+void Engine::replayInput(const std::string &filename, double timestep) {
+  Replayer = std::make_unique<InputLogReader>(filename);
+  ReplayTimestep = timestep;
+}
+
+void Engine::setMaxFramesInFlight(unsigned int frames) {
+  Pacer.setMaxFramesInFlight(frames);
+}
+
+void Engine::setTargetFrameRate(double fps) { Pacer.setTargetFrameRate(fps); }
+
+const FramePacer &Engine::getFramePacer() const { return Pacer; }
+
+void Engine::setOnDemand(bool on_demand, double idle_timeout) {
+  OnDemand = on_demand;
+  IdleTimeout = idle_timeout;
+}
+
+bool Engine::isOnDemand() const { return OnDemand; }
+
+void Engine::requestRedraw() { RedrawRequested = true; }
+
+void Engine::setAsyncUploads(bool async_uploads) {
+  AsyncUploads = async_uploads;
+}
+
+unsigned long long Engine::getFramesSkipped() const { return FramesSkipped; }
+
+void Engine::setFixedTimestep(double timestep, unsigned int max_steps) {
+  FixedTimestep = timestep;
+  MaxSteps = std::max(max_steps, 1u);
+}
+
+double Engine::getInterpolationAlpha() const { return InterpolationAlpha; }
+
+unsigned long long Engine::getSimulationSteps() const {
+  return SimulationSteps;
+}
+
+void Engine::getCursorPos(double *xpos, double *ypos) const {
+  *xpos = CursorX;
+  *ypos = CursorY;
+}
+
 /////////////////////////////////////////////////////////////////////////// INIT
 
 void Engine::setupWindow() {
@@ -108,6 +229,7 @@ void Engine::setupCallbacks() {
   glfwSetJoystickCallback(joystick_callback);
   glfwSetWindowCloseCallback(Window, window_close_callback);
   glfwSetWindowSizeCallback(Window, window_size_callback);
+  glfwSetWindowRefreshCallback(Window, window_refresh_callback);
 }
 
 void Engine::setupGLFW() {
@@ -117,6 +239,8 @@ void Engine::setupGLFW() {
   }
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, GlMajor);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, GlMinor);
+  // Headless runs render into a hidden window; no events reach the App.
+  glfwWindowHint(GLFW_VISIBLE, Headless ? GLFW_FALSE : GLFW_TRUE);
 #ifdef DEBUG
   glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
 #endif
@@ -137,6 +261,26 @@ void Engine::setupGLEW() {
   }
 }
 
+void Engine::setupUploads() {
+  if (!AsyncUploads)
+    return;
+  // GLFW creates windows on the main thread only; the upload thread just makes
+  // this hidden one's context current
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  UploadWindow = glfwCreateWindow(1, 1, "", nullptr, Window);
+  // Back to GLFW's default, keeping the context hints for any later window
+  glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+  if (!UploadWindow) {
+    throw std::runtime_error("Failed to create GLFW upload context.");
+  }
+  UploadQueue &uploads = UploadQueue::getInstance();
+  uploads.setNotify([this]() {
+    requestRedraw();
+    glfwPostEmptyEvent();
+  });
+  uploads.start(UploadWindow);
+}
+
 void Engine::setupOpenGL() {
   glClearColor(0.1f, 0.1f, 0.3f, 1.0f);
   glEnable(GL_DEPTH_TEST);
@@ -162,9 +306,12 @@ void displayInfo() {
 }
 
 void Engine::init() {
+  // Jobs needing the GL context run on the thread that owns it
+  JobSystem::getInstance().bindMainThread();
   setupGLFW();
   setupGLEW();
   setupOpenGL();
+  setupUploads();
   GlApp->initCallback(Window);
 #ifdef DEBUG
   displayInfo();
@@ -172,28 +319,310 @@ void Engine::init() {
 #endif
 }
 
+////////////////////////////////////////////////////////////////////////// INPUT
+
+void Engine::handleInput(GLFWwindow *window, const InputEvent &event) {
+  // While replaying, the log is the only source of input
+  if (Replayer)
+    return;
+  if (Recorder)
+    Recorder->write(event);
+  deliverInput(window, event);
+}
+
+void Engine::deliverInput(GLFWwindow *window, const InputEvent &event) {
+  // Threaded apps receive input on the simulation thread, batched per frame
+  double &input_time = Threaded ? CurrentBatch.InputTime : PendingInputTime;
+  if (input_time == 0.0)
+    input_time = glfwGetTime();
+  RedrawRequested = true;
+  if (Threaded) {
+    CurrentBatch.Events.push_back(event);
+  } else {
+    dispatchInput(window, event);
+  }
+}
+
+void Engine::dispatchInput(GLFWwindow *window, const InputEvent &event) {
+  switch (event.Type) {
+  case InputEventType::Frame:
+    break;
+  case InputEventType::Cursor:
+    CursorX = event.X;
+    CursorY = event.Y;
+    GlApp->cursorCallback(window, event.X, event.Y);
+    break;
+  case InputEventType::Key:
+    GlApp->keyCallback(window, event.A, event.B, event.C, event.D);
+    break;
+  case InputEventType::MouseButton:
+    CursorX = event.X;
+    CursorY = event.Y;
+    GlApp->mouseButtonCallback(window, event.A, event.C, event.D);
+    break;
+  case InputEventType::Scroll:
+    GlApp->scrollCallback(window, event.X, event.Y);
+    break;
+  case InputEventType::WindowSize:
+    GlApp->windowSizeCallback(window, event.A, event.B);
+    break;
+  case InputEventType::Joystick:
+    GlApp->joystickCallback(event.A, event.B);
+    break;
+  }
+}
+
+bool Engine::replayFrame(double &elapsed) {
+  InputEvent event;
+  if (!Replayer->next(event))
+    return false;
+  // replayEvents stops at a frame marker, so anything else is out of sync
+  if (event.Type != InputEventType::Frame) {
+    std::cerr << "[ERROR] Input log out of sync: expected a frame marker"
+              << std::endl;
+    throw std::runtime_error("Input log out of sync.");
+  }
+  elapsed = ReplayTimestep > 0.0 ? ReplayTimestep : event.X;
+  return true;
+}
+
+void Engine::replayEvents() {
+  // Events recorded between frames N and N+1 are replayed at the same point
+  InputEventType type;
+  InputEvent event;
+  while (Replayer->peek(type) && type != InputEventType::Frame) {
+    Replayer->next(event);
+    deliverInput(Window, event);
+  }
+}
+
 //////////////////////////////////////////////////////////////////////////// RUN
 
-void Engine::run() {
+void Engine::recordFrame(double frame_time) {
+  FrameStats &stats = currentFrameStats();
+  stats.FrameTime = frame_time;
+  TotalStats += stats;
+  History.push(stats);
+  MinFrameTime = FrameCount ? std::min(MinFrameTime, frame_time) : frame_time;
+  MaxFrameTime = FrameCount ? std::max(MaxFrameTime, frame_time) : frame_time;
+  if (++FrameCount == FrameLimit) {
+    glfwSetWindowShouldClose(Window, GLFW_TRUE);
+  }
+}
+
+bool Engine::beginFrame(double &last_time, double &elapsed) {
+  double time = glfwGetTime();
+  elapsed = time - last_time;
+  last_time = time;
+  if (Replayer && !replayFrame(elapsed)) {
+    glfwSetWindowShouldClose(Window, GLFW_TRUE);
+    return false;
+  }
+  if (Recorder) {
+    InputEvent frame;
+    frame.Type = InputEventType::Frame;
+    frame.X = elapsed;
+    Recorder->write(frame);
+  }
+  currentFrameStats().reset();
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+  // Uploads finished since the last frame become visible to this one
+  UploadQueue::getInstance().publish();
+  return true;
+}
+
+void Engine::pollInput() {
+  // With nothing to draw, sleep in the event queue instead of spinning
+  const bool idle = OnDemand && !Threaded && !Replayer && !RedrawRequested;
+  if (idle && IdleTimeout > 0.0) {
+    glfwWaitEventsTimeout(IdleTimeout);
+  } else if (idle) {
+    glfwWaitEvents();
+  } else {
+    glfwPollEvents();
+  }
+  if (Replayer)
+    replayEvents();
+}
+
+void Engine::stepSimulation(double elapsed) {
+  if (FixedTimestep <= 0.0) {
+    GlApp->fixedUpdateCallback(Window, elapsed);
+    SimulationSteps++;
+    InterpolationAlpha = 1.0;
+    return;
+  }
+  Accumulator += elapsed;
+  unsigned int steps = 0;
+  while (Accumulator >= FixedTimestep && steps < MaxSteps) {
+    GlApp->fixedUpdateCallback(Window, FixedTimestep);
+    Accumulator -= FixedTimestep;
+    steps++;
+  }
+  SimulationSteps += steps;
+  // After a long stall, catch up no further than MaxSteps
+  if (Accumulator >= FixedTimestep)
+    Accumulator = std::fmod(Accumulator, FixedTimestep);
+  InterpolationAlpha = Accumulator / FixedTimestep;
+}
+
+void Engine::endFrame(double frame_start, double input_time) {
+  glfwSwapBuffers(Window);
+  Pacer.frameSubmitted();
+  const double presented = glfwGetTime();
+  if (input_time > 0.0)
+    Pacer.recordLatency(presented - input_time);
+  recordFrame(presented - frame_start);
+}
+
+void Engine::runSerial() {
   double last_time = glfwGetTime();
+  double elapsed_time = 0.0;
   while (!glfwWindowShouldClose(Window)) {
     try {
-      double time = glfwGetTime();
-      double elapsed_time = time - last_time;
-      last_time = time;
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |
-              GL_STENCIL_BUFFER_BIT);
+      // Input is sampled after pacing so the frame reflects the latest state
+      Pacer.wait();
+      pollInput();
+      JobSystem::getInstance().runMainThreadJobs();
+      if (glfwWindowShouldClose(Window))
+        break;
+      if (OnDemand && !Replayer && !RedrawRequested.exchange(false)) {
+        // Woken without a reason to redraw; idle time is not animation time
+        FramesSkipped++;
+        last_time = glfwGetTime();
+        continue;
+      }
+      if (!beginFrame(last_time, elapsed_time))
+        break;
+      const double input_time = PendingInputTime;
+      PendingInputTime = 0.0;
+      stepSimulation(elapsed_time);
       GlApp->displayCallback(Window, elapsed_time);
-      glfwSwapBuffers(Window);
-      glfwPollEvents();
+      endFrame(last_time, input_time);
     } catch (const std::exception &e) {
       std::cerr << "FRAME EXCEPTION: " << e.what() << std::endl;
       glfwSetWindowShouldClose(Window, GLFW_TRUE);
     }
   }
+}
+
+///////////////////////////////////////////////////////////////////// THREADING
+
+void Engine::setThreaded(bool threaded) { Threaded = threaded; }
+
+Engine::InputBatch Engine::takeInputBatch(unsigned long long frame) {
+  // Frame N is simulated with the input gathered after frame N-2 was drawn.
+  // That batch is always complete once a packet is free to write, so threaded
+  // runs see the same input on the same frame regardless of timing.
+  InputBatch batch;
+  if (frame < 2)
+    return batch;
+  std::lock_guard<std::mutex> lock(InputMutex);
+  batch = std::move(InputBatches.front());
+  InputBatches.pop_front();
+  return batch;
+}
+
+void Engine::simulationLoop() {
+  while (Simulating) {
+    FramePacket *packet = Packets.beginWrite();
+    if (!packet) {
+      std::this_thread::yield();
+      continue;
+    }
+    try {
+      const unsigned long long frame = Packets.produced();
+      InputBatch batch = takeInputBatch(frame);
+      for (const InputEvent &event : batch.Events) {
+        dispatchInput(Window, event);
+      }
+      packet->clear();
+      packet->FrameIndex = frame;
+      packet->InputTime = batch.InputTime;
+      currentFrameStats().reset();
+      stepSimulation(batch.Elapsed);
+      GlApp->simulateCallback(Window, batch.Elapsed, *packet);
+      packet->Stats = currentFrameStats();
+      Packets.endWrite();
+    } catch (const std::exception &e) {
+      std::cerr << "SIMULATION EXCEPTION: " << e.what() << std::endl;
+      SimulationFailed = true;
+      return;
+    }
+  }
+}
+
+void Engine::runThreaded() {
+  Simulating = true;
+  SimulationFailed = false;
+  std::thread simulation(&Engine::simulationLoop, this);
+
+  double last_time = glfwGetTime();
+  double elapsed_time = 0.0;
+  while (!glfwWindowShouldClose(Window)) {
+    try {
+      // The simulation thread may be waiting on GL work
+      JobSystem::getInstance().runMainThreadJobs();
+      const FramePacket *packet = Packets.beginRead();
+      if (!packet) {
+        if (SimulationFailed)
+          glfwSetWindowShouldClose(Window, GLFW_TRUE);
+        std::this_thread::yield();
+        continue;
+      }
+      Pacer.wait();
+      CurrentBatch.Frame = packet->FrameIndex;
+      CurrentBatch.InputTime = 0.0;
+      CurrentBatch.Events.clear();
+      pollInput();
+      if (glfwWindowShouldClose(Window) ||
+          !beginFrame(last_time, elapsed_time))
+        break;
+      CurrentBatch.Elapsed = elapsed_time;
+      // The packet's camera matrices are uploaded right before its draws
+      GlApp->submitCallback(Window, *packet);
+      currentFrameStats() += packet->Stats;
+      endFrame(last_time, packet->InputTime);
+      {
+        std::lock_guard<std::mutex> lock(InputMutex);
+        InputBatches.push_back(std::move(CurrentBatch));
+      }
+      Packets.endRead();
+    } catch (const std::exception &e) {
+      std::cerr << "FRAME EXCEPTION: " << e.what() << std::endl;
+      glfwSetWindowShouldClose(Window, GLFW_TRUE);
+    }
+  }
+
+  Simulating = false;
+  simulation.join();
+}
+
+void Engine::run() {
+  if (Threaded) {
+    runThreaded();
+  } else {
+    runSerial();
+  }
+  Recorder.reset();
+  Replayer.reset();
+  Pacer.release();
+  UploadQueue::getInstance().stop();
+  if (UploadWindow) {
+    glfwDestroyWindow(UploadWindow);
+    UploadWindow = nullptr;
+  }
   glfwDestroyWindow(Window);
   Window = nullptr;
   glfwTerminate();
+  if (StatsCsv.empty())
+    return;
+  try {
+    History.writeCsv(StatsCsv);
+  } catch (const std::exception &e) {
+    // Already reported; the caller still gets to print its own results
+    std::cerr << "[ERROR] Frame stats not written: " << e.what() << std::endl;
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -12,7 +12,18 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/ext.hpp>
+#include <atomic>
+#include <deque>
 #include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "./mglFramePacer.hpp"
+#include "./mglFramePacket.hpp"
+#include "./mglInputLog.hpp"
+#include "./mglStats.hpp"
 
 namespace mgl {
 
@@ -35,6 +46,22 @@ public:
   virtual void scrollCallback(GLFWwindow *window, double xoffset,
                               double yoffset) {}
   virtual void joystickCallback(int jid, int event) {}
+  // Advances the simulation by dt, before the frame is drawn. With a fixed
+  // timestep (see Engine::setFixedTimestep) it runs zero or more times per
+  // frame and the frame should be drawn between the last two simulated states
+  // using Engine::getInterpolationAlpha; otherwise it runs once per frame with
+  // the frame's elapsed time. Runs on the simulation thread in threaded mode.
+  virtual void fixedUpdateCallback(GLFWwindow *window, double dt) {}
+
+  // Threaded mode (see Engine::setThreaded): simulateCallback runs on the
+  // simulation thread, without a GL context, and describes the next frame in
+  // the packet; input callbacks are also delivered on that thread.
+  // submitCallback renders a completed packet on the GL thread.
+  virtual void simulateCallback(GLFWwindow *window, double elapsed,
+                                FramePacket &packet) {}
+  virtual void submitCallback(GLFWwindow *window, const FramePacket &packet) {
+    packet.submit();
+  }
 
 protected:
   virtual ~App() {}
@@ -53,9 +80,50 @@ public:
   void setOpenGL(int major, int minor);
   void setWindow(int width, int height, const char *title, int fullscreen,
                  int vsync);
+  void setHeadless(bool headless);
+  void setFrameLimit(unsigned long long frames);
+  void recordInput(const std::string &filename);
+  void replayInput(const std::string &filename, double timestep = 0.0);
+  void setThreaded(bool threaded);
+  void setMaxFramesInFlight(unsigned int frames);
+  void setTargetFrameRate(double fps);
+  // On-demand rendering: the serial loop sleeps until input arrives or a redraw
+  // is requested, waking at least every idle_timeout seconds (0 = never).
+  // Ignored while replaying input.
+  void setOnDemand(bool on_demand, double idle_timeout = 0.0);
+  bool isOnDemand() const;
+  // Thread-safe; asks for at least one more frame in on-demand mode.
+  void requestRedraw();
+  // Creates buffers and textures on a dedicated thread with its own shared GL
+  // context (see UploadQueue); they appear at the start of a later frame.
+  void setAsyncUploads(bool async_uploads);
   void init();
   void run();
 
+  // Cursor position as seen by the App, live or replayed.
+  void getCursorPos(double *xpos, double *ypos) const;
+  void handleInput(GLFWwindow *window, const InputEvent &event);
+
+  unsigned long long getFrameCount() const;
+  const FrameStats &getTotalStats() const;
+  double getMinFrameTime() const;
+  double getMaxFrameTime() const;
+  const FramePacer &getFramePacer() const;
+  // Rolling min/avg/max of a counter over the last setStatsWindow frames.
+  void setStatsWindow(std::size_t frames);
+  StatRange getStatRange(StatCounter counter) const;
+  const StatsHistory &getStatsHistory() const;
+  // Writes every frame's counters to a CSV file when run() returns. Throws
+  // std::runtime_error right away if the file cannot be written.
+  void dumpStatsCsv(const std::string &filename);
+  unsigned long long getFramesSkipped() const;
+  // Simulation step in seconds, 0 for one variable step per frame. At most
+  // max_steps are run per frame; time beyond that is dropped.
+  void setFixedTimestep(double timestep, unsigned int max_steps = 5);
+  // Fraction of a step between the last simulated state and the next one.
+  double getInterpolationAlpha() const;
+  unsigned long long getSimulationSteps() const;
+
 protected:
   virtual ~Engine();
 
@@ -67,12 +135,64 @@ private:
   int GlMajor, GlMinor;
   int Fullscreen;
   int Vsync;
+  bool Headless;
+  unsigned long long FrameLimit;
+  unsigned long long FrameCount;
+  FrameStats TotalStats;
+  double MinFrameTime, MaxFrameTime;
+  StatsHistory History;
+  std::string StatsCsv;
+  std::unique_ptr<InputLogWriter> Recorder;
+  std::unique_ptr<InputLogReader> Replayer;
+  double ReplayTimestep;
+  double CursorX, CursorY;
+
+  struct InputBatch {
+    unsigned long long Frame = 0;
+    double Elapsed = 0.0;
+    double InputTime = 0.0;
+    std::vector<InputEvent> Events;
+  };
+  bool Threaded;
+  std::atomic<bool> Simulating;
+  std::atomic<bool> SimulationFailed;
+  FramePacketBuffer Packets;
+  InputBatch CurrentBatch;
+  std::deque<InputBatch> InputBatches;
+  std::mutex InputMutex;
+  FramePacer Pacer;
+  double PendingInputTime;
+  bool OnDemand;
+  double IdleTimeout;
+  std::atomic<bool> RedrawRequested;
+  unsigned long long FramesSkipped;
+  double FixedTimestep;
+  unsigned int MaxSteps;
+  double Accumulator;
+  double InterpolationAlpha;
+  unsigned long long SimulationSteps;
+  bool AsyncUploads;
+  GLFWwindow *UploadWindow;
 
   void setupWindow();
   void setupGLFW();
   void setupGLEW();
   void setupOpenGL();
   void setupCallbacks();
+  void setupUploads();
+  void recordFrame(double frame_time);
+  void dispatchInput(GLFWwindow *window, const InputEvent &event);
+  void deliverInput(GLFWwindow *window, const InputEvent &event);
+  bool replayFrame(double &elapsed);
+  void replayEvents();
+  void pollInput();
+  void stepSimulation(double elapsed);
+  bool beginFrame(double &last_time, double &elapsed);
+  void endFrame(double frame_start, double input_time);
+  void runSerial();
+  void runThreaded();
+  void simulationLoop();
+  InputBatch takeInputBatch(unsigned long long frame);
 
 public:
   Engine(Engine const &) = delete;
@@ -0,0 +1,748 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Bounding Volume Hierarchies
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglBVH.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MGL_BVH_SSE
+#include <emmintrin.h>
+#endif
+
+namespace mgl {
+
+//////////////////////////////////////////////////////////////////////////// BVH
+
+static const unsigned int BVH_BINS = 16;
+static const unsigned int BVH_MAX_DEPTH = 60; // traversal stack holds 64
+
+static float surfaceArea(const BoundingBox &box) {
+  if (box.isEmpty())
+    return 0.0f;
+  const glm::vec3 e = box.size();
+  return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+}
+
+void BVH::build(const std::vector<BoundingBox> &boxes,
+                unsigned int max_leaf_size) {
+  clear();
+  if (boxes.empty())
+    return;
+  Order.resize(boxes.size());
+  std::iota(Order.begin(), Order.end(), 0u);
+  std::vector<glm::vec3> centroids(boxes.size());
+  for (std::size_t i = 0; i < boxes.size(); i++) {
+    centroids[i] = boxes[i].center();
+  }
+  Nodes.reserve(2 * boxes.size());
+  BVHNode root;
+  root.LeftFirst = 0;
+  root.Count = static_cast<unsigned int>(boxes.size());
+  Nodes.push_back(root);
+  subdivide(0, boxes, centroids, std::max(max_leaf_size, 1u), 0);
+  Nodes.shrink_to_fit();
+}
+
+void BVH::subdivide(unsigned int node, const std::vector<BoundingBox> &boxes,
+                    const std::vector<glm::vec3> &centroids,
+                    unsigned int max_leaf_size, unsigned int depth) {
+  const unsigned int first = Nodes[node].LeftFirst;
+  const unsigned int count = Nodes[node].Count;
+  BoundingBox bounds, centroid_bounds;
+  for (unsigned int i = first; i < first + count; i++) {
+    bounds.extend(boxes[Order[i]]);
+    centroid_bounds.extend(centroids[Order[i]]);
+  }
+  Nodes[node].Min = bounds.Min;
+  Nodes[node].Max = bounds.Max;
+  if (count == 1 || depth >= BVH_MAX_DEPTH)
+    return;
+
+  // Binned surface area heuristic over the centroid extent of each axis
+  int best_axis = -1;
+  unsigned int best_split = 0;
+  float best_cost = FLT_MAX;
+  const glm::vec3 extent = centroid_bounds.size();
+  for (int axis = 0; axis < 3; axis++) {
+    if (extent[axis] <= 0.0f)
+      continue;
+    BoundingBox bin_bounds[BVH_BINS];
+    unsigned int bin_count[BVH_BINS] = {};
+    const float scale = BVH_BINS / extent[axis];
+    for (unsigned int i = first; i < first + count; i++) {
+      const unsigned int bin = std::min(
+          BVH_BINS - 1, static_cast<unsigned int>(
+                            (centroids[Order[i]][axis] -
+                             centroid_bounds.Min[axis]) * scale));
+      bin_bounds[bin].extend(boxes[Order[i]]);
+      bin_count[bin]++;
+    }
+    float left_area[BVH_BINS - 1];
+    unsigned int left_count[BVH_BINS - 1];
+    BoundingBox sweep;
+    unsigned int sum = 0;
+    for (unsigned int i = 0; i < BVH_BINS - 1; i++) {
+      sweep.extend(bin_bounds[i]);
+      sum += bin_count[i];
+      left_area[i] = surfaceArea(sweep);
+      left_count[i] = sum;
+    }
+    sweep = BoundingBox();
+    sum = 0;
+    for (unsigned int i = BVH_BINS - 1; i > 0; i--) {
+      sweep.extend(bin_bounds[i]);
+      sum += bin_count[i];
+      if (left_count[i - 1] == 0 || sum == 0)
+        continue;
+      const float cost =
+          left_count[i - 1] * left_area[i - 1] + sum * surfaceArea(sweep);
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_split = i;
+      }
+    }
+  }
+  if (best_axis < 0)
+    return; // all centroids coincide
+
+  // A traversal step costs about as much as one primitive test
+  const float leaf_cost = count * surfaceArea(bounds);
+  const float split_cost = surfaceArea(bounds) + best_cost;
+  if (count <= max_leaf_size && split_cost >= leaf_cost)
+    return;
+
+  const float scale = BVH_BINS / extent[best_axis];
+  const float origin = centroid_bounds.Min[best_axis];
+  unsigned int *middle = std::partition(
+      &Order[first], &Order[first] + count, [&](unsigned int i) {
+        const unsigned int bin = std::min(
+            BVH_BINS - 1, static_cast<unsigned int>(
+                              (centroids[i][best_axis] - origin) * scale));
+        return bin < best_split;
+      });
+  const unsigned int left_count =
+      static_cast<unsigned int>(middle - &Order[first]);
+  if (left_count == 0 || left_count == count)
+    return;
+
+  const unsigned int left = static_cast<unsigned int>(Nodes.size());
+  BVHNode child;
+  child.LeftFirst = first;
+  child.Count = left_count;
+  Nodes.push_back(child);
+  child.LeftFirst = first + left_count;
+  child.Count = count - left_count;
+  Nodes.push_back(child);
+  Nodes[node].LeftFirst = left;
+  Nodes[node].Count = 0;
+  subdivide(left, boxes, centroids, max_leaf_size, depth + 1);
+  subdivide(left + 1, boxes, centroids, max_leaf_size, depth + 1);
+}
+
+void BVH::clear() {
+  Nodes.clear();
+  Order.clear();
+}
+
+void BVH::swap(BVH &other) {
+  Nodes.swap(other.Nodes);
+  Order.swap(other.Order);
+}
+
+bool BVH::isEmpty() const { return Nodes.empty(); }
+
+std::size_t BVH::getNodeCount() const { return Nodes.size(); }
+
+unsigned int BVH::getPrimitive(unsigned int i) const { return Order[i]; }
+
+//////////////////////////////////////////////////////////////////// TriangleBVH
+
+void TriangleBVH::build(const std::vector<glm::vec3> &positions,
+                        const std::vector<unsigned int> &indices) {
+  build(positions.data(), indices.data(), indices.size());
+}
+
+void TriangleBVH::build(const glm::vec3 *positions, const unsigned int *indices,
+                        std::size_t index_count) {
+  clear();
+  TriangleCount = index_count / 3;
+  std::vector<BoundingBox> boxes(TriangleCount);
+  for (std::size_t i = 0; i < TriangleCount; i++) {
+    for (int k = 0; k < 3; k++) {
+      boxes[i].extend(positions[indices[3 * i + k]]);
+    }
+  }
+  BVH::build(boxes);
+
+  // Repack each leaf's triangles into SIMD groups and point the leaf at them
+  for (BVHNode &node : Nodes) {
+    if (!node.isLeaf())
+      continue;
+    const unsigned int first_pack = static_cast<unsigned int>(Packs.size());
+    for (unsigned int i = 0; i < node.Count; i++) {
+      if (i % 4 == 0) {
+        TrianglePack pack;
+        std::memset(&pack, 0, sizeof(pack));
+        Packs.push_back(pack);
+      }
+      TrianglePack &pack = Packs.back();
+      const unsigned int lane = i % 4;
+      const unsigned int triangle = Order[node.LeftFirst + i];
+      const glm::vec3 &v0 = positions[indices[3 * triangle]];
+      const glm::vec3 e1 = positions[indices[3 * triangle + 1]] - v0;
+      const glm::vec3 e2 = positions[indices[3 * triangle + 2]] - v0;
+      for (int axis = 0; axis < 3; axis++) {
+        pack.V0[axis][lane] = v0[axis];
+        pack.E1[axis][lane] = e1[axis];
+        pack.E2[axis][lane] = e2[axis];
+      }
+      pack.Triangles[lane] = triangle;
+    }
+    node.LeftFirst = first_pack;
+  }
+  Order.clear();
+  Order.shrink_to_fit();
+}
+
+void TriangleBVH::clear() {
+  BVH::clear();
+  Packs.clear();
+  TriangleCount = 0;
+}
+
+std::size_t TriangleBVH::getTriangleCount() const { return TriangleCount; }
+
+std::size_t TriangleBVH::getMemoryUsage() const {
+  return Nodes.capacity() * sizeof(BVHNode) +
+         Packs.capacity() * sizeof(TrianglePack);
+}
+
+static const float TRIANGLE_EPSILON = 1e-12f;
+
+#ifdef MGL_BVH_SSE
+
+// Moller-Trumbore against four triangles at once.
+static bool intersectPack(const TrianglePack &pack, const Ray &ray,
+                          RayHit &hit) {
+  const __m128 dx = _mm_set1_ps(ray.Direction.x);
+  const __m128 dy = _mm_set1_ps(ray.Direction.y);
+  const __m128 dz = _mm_set1_ps(ray.Direction.z);
+  const __m128 e1x = _mm_loadu_ps(pack.E1[0]);
+  const __m128 e1y = _mm_loadu_ps(pack.E1[1]);
+  const __m128 e1z = _mm_loadu_ps(pack.E1[2]);
+  const __m128 e2x = _mm_loadu_ps(pack.E2[0]);
+  const __m128 e2y = _mm_loadu_ps(pack.E2[1]);
+  const __m128 e2z = _mm_loadu_ps(pack.E2[2]);
+
+  const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+  const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+  const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+  const __m128 det =
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)),
+                 _mm_mul_ps(e1z, pz));
+  const __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+  const __m128 tx =
+      _mm_sub_ps(_mm_set1_ps(ray.Origin.x), _mm_loadu_ps(pack.V0[0]));
+  const __m128 ty =
+      _mm_sub_ps(_mm_set1_ps(ray.Origin.y), _mm_loadu_ps(pack.V0[1]));
+  const __m128 tz =
+      _mm_sub_ps(_mm_set1_ps(ray.Origin.z), _mm_loadu_ps(pack.V0[2]));
+  const __m128 u = _mm_mul_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)),
+                 _mm_mul_ps(tz, pz)),
+      inv_det);
+
+  const __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+  const __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+  const __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+  const __m128 v = _mm_mul_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)),
+                 _mm_mul_ps(dz, qz)),
+      inv_det);
+  const __m128 t = _mm_mul_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)),
+                 _mm_mul_ps(e2z, qz)),
+      inv_det);
+
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 abs_det = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+  __m128 mask = _mm_cmpgt_ps(abs_det, _mm_set1_ps(TRIANGLE_EPSILON));
+  mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+  mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+  mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+  mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, zero));
+  mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(hit.Distance)));
+  const int lanes = _mm_movemask_ps(mask);
+  if (!lanes)
+    return false;
+
+  float distances[4];
+  _mm_storeu_ps(distances, t);
+  for (int lane = 0; lane < 4; lane++) {
+    if ((lanes & (1 << lane)) && distances[lane] < hit.Distance) {
+      hit.Distance = distances[lane];
+      hit.Triangle = pack.Triangles[lane];
+    }
+  }
+  return true;
+}
+
+#else
+
+static bool intersectPack(const TrianglePack &pack, const Ray &ray,
+                          RayHit &hit) {
+  bool found = false;
+  for (int lane = 0; lane < 4; lane++) {
+    const glm::vec3 v0(pack.V0[0][lane], pack.V0[1][lane], pack.V0[2][lane]);
+    const glm::vec3 e1(pack.E1[0][lane], pack.E1[1][lane], pack.E1[2][lane]);
+    const glm::vec3 e2(pack.E2[0][lane], pack.E2[1][lane], pack.E2[2][lane]);
+    const glm::vec3 p = glm::cross(ray.Direction, e2);
+    const float det = glm::dot(e1, p);
+    if (std::fabs(det) <= TRIANGLE_EPSILON)
+      continue;
+    const float inv_det = 1.0f / det;
+    const glm::vec3 s = ray.Origin - v0;
+    const float u = glm::dot(s, p) * inv_det;
+    const glm::vec3 q = glm::cross(s, e1);
+    const float v = glm::dot(ray.Direction, q) * inv_det;
+    const float t = glm::dot(e2, q) * inv_det;
+    if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > 0.0f &&
+        t < hit.Distance) {
+      hit.Distance = t;
+      hit.Triangle = pack.Triangles[lane];
+      found = true;
+    }
+  }
+  return found;
+}
+
+#endif
+
+bool TriangleBVH::intersect(const Ray &ray, RayHit &hit) const {
+  bool found = false;
+  traverse(ray, hit.Distance, [&](const BVHNode &leaf) {
+    const unsigned int packs = (leaf.Count + 3) / 4;
+    for (unsigned int i = 0; i < packs; i++) {
+      found |= intersectPack(Packs[leaf.LeftFirst + i], ray, hit);
+    }
+  });
+  return found;
+}
+
+///////////////////////////////////////////////////////////////////// DynamicBVH
+
+static const unsigned int NO_NODE = ~0u;
+
+DynamicBVH::DynamicBVH()
+    : ProxyCount(0), StructureChanged(false), Generation(0),
+      RebuildThreshold(1.5f), BuildCost(0.0f), Cost(0.0f), AreaSum(0.0f),
+      Rebuilds(0) {}
+
+DynamicBVH::~DynamicBVH() {
+  if (PendingRebuild.valid())
+    PendingRebuild.wait();
+}
+
+unsigned int DynamicBVH::insert(const BoundingBox &box) {
+  unsigned int proxy;
+  if (!FreeProxies.empty()) {
+    proxy = FreeProxies.back();
+    FreeProxies.pop_back();
+  } else {
+    proxy = static_cast<unsigned int>(Boxes.size());
+    Boxes.emplace_back();
+    Alive.push_back(0);
+    Dirty.push_back(0);
+    LeafOf.push_back(NO_NODE);
+  }
+  Boxes[proxy] = box;
+  Alive[proxy] = 1;
+  ProxyCount++;
+  StructureChanged = true;
+  return proxy;
+}
+
+void DynamicBVH::remove(unsigned int proxy) {
+  Alive[proxy] = 0;
+  Boxes[proxy] = BoundingBox();
+  FreeProxies.push_back(proxy);
+  ProxyCount--;
+  StructureChanged = true;
+}
+
+void DynamicBVH::update(unsigned int proxy, const BoundingBox &box) {
+  Boxes[proxy] = box;
+  if (!Dirty[proxy]) {
+    Dirty[proxy] = 1;
+    DirtyProxies.push_back(proxy);
+  }
+}
+
+void DynamicBVH::clear() {
+  BVH::clear();
+  Boxes.clear();
+  Alive.clear();
+  Dirty.clear();
+  FreeProxies.clear();
+  DirtyProxies.clear();
+  Parents.clear();
+  LeafOf.clear();
+  ProxyCount = 0;
+  StructureChanged = false;
+  Generation++;
+  BuildCost = Cost = AreaSum = 0.0f;
+}
+
+void DynamicBVH::setRebuildThreshold(float ratio) { RebuildThreshold = ratio; }
+
+std::size_t DynamicBVH::size() const { return ProxyCount; }
+
+const BoundingBox &DynamicBVH::getBounds(unsigned int proxy) const {
+  return Boxes[proxy];
+}
+
+float DynamicBVH::getCostRatio() const {
+  return BuildCost > 0.0f ? Cost / BuildCost : 1.0f;
+}
+
+unsigned long long DynamicBVH::getRebuildCount() const { return Rebuilds; }
+
+DynamicBVH::Rebuild DynamicBVH::snapshot() const {
+  Rebuild rebuild;
+  rebuild.Generation = Generation;
+  rebuild.Proxies.reserve(ProxyCount);
+  for (unsigned int proxy = 0; proxy < Boxes.size(); proxy++) {
+    if (Alive[proxy])
+      rebuild.Proxies.push_back(proxy);
+  }
+  return rebuild;
+}
+
+void DynamicBVH::adopt(Rebuild &rebuild) {
+  swap(rebuild.Tree);
+  for (unsigned int &primitive : Order) {
+    primitive = rebuild.Proxies[primitive];
+  }
+  linkNodes();
+  Rebuilds++;
+}
+
+void DynamicBVH::linkNodes() {
+  Parents.assign(Nodes.size(), NO_NODE);
+  std::fill(LeafOf.begin(), LeafOf.end(), NO_NODE);
+  for (unsigned int i = 0; i < Nodes.size(); i++) {
+    const BVHNode &node = Nodes[i];
+    if (node.isLeaf()) {
+      for (unsigned int j = 0; j < node.Count; j++) {
+        LeafOf[Order[node.LeftFirst + j]] = i;
+      }
+    } else {
+      Parents[node.LeftFirst] = i;
+      Parents[node.LeftFirst + 1] = i;
+    }
+  }
+}
+
+static void setBounds(BVHNode &node, const BoundingBox &box) {
+  node.Min = box.Min;
+  node.Max = box.Max;
+}
+
+static BoundingBox nodeBounds(const BVHNode &node) {
+  BoundingBox box;
+  box.Min = node.Min;
+  box.Max = node.Max;
+  return box;
+}
+
+void DynamicBVH::refitAll() {
+  // Children are always stored after their parent
+  float cost = 0.0f;
+  for (std::size_t i = Nodes.size(); i-- > 0;) {
+    BVHNode &node = Nodes[i];
+    if (node.isLeaf()) {
+      const BoundingBox &first = Boxes[Order[node.LeftFirst]];
+      node.Min = first.Min;
+      node.Max = first.Max;
+      for (unsigned int j = 1; j < node.Count; j++) {
+        const BoundingBox &box = Boxes[Order[node.LeftFirst + j]];
+        node.Min = glm::min(node.Min, box.Min);
+        node.Max = glm::max(node.Max, box.Max);
+      }
+    } else {
+      const BVHNode &left = Nodes[node.LeftFirst];
+      const BVHNode &right = Nodes[node.LeftFirst + 1];
+      node.Min = glm::min(left.Min, right.Min);
+      node.Max = glm::max(left.Max, right.Max);
+    }
+    const float area = surfaceArea(nodeBounds(node));
+    cost += node.isLeaf() ? area * node.Count : area;
+  }
+  AreaSum = cost;
+  normalizeCost();
+}
+
+void DynamicBVH::refitDirty() {
+  for (unsigned int proxy : DirtyProxies) {
+    unsigned int i = LeafOf[proxy];
+    while (i != NO_NODE) {
+      BVHNode &node = Nodes[i];
+      BoundingBox box;
+      if (node.isLeaf()) {
+        for (unsigned int j = 0; j < node.Count; j++) {
+          box.extend(Boxes[Order[node.LeftFirst + j]]);
+        }
+      } else {
+        box = nodeBounds(Nodes[node.LeftFirst]);
+        box.extend(nodeBounds(Nodes[node.LeftFirst + 1]));
+      }
+      // Ancestors only change while the box keeps changing
+      if (box.Min == node.Min && box.Max == node.Max)
+        break;
+      // Keep the SAH cost current, so slowly degrading trees still rebuild
+      const float weight = node.isLeaf() ? static_cast<float>(node.Count) : 1.0f;
+      AreaSum += weight * (surfaceArea(box) - surfaceArea(nodeBounds(node)));
+      setBounds(node, box);
+      i = Parents[i];
+    }
+  }
+  normalizeCost();
+}
+
+void DynamicBVH::computeCost() {
+  AreaSum = 0.0f;
+  for (const BVHNode &node : Nodes) {
+    const float area = surfaceArea(nodeBounds(node));
+    AreaSum += node.isLeaf() ? area * node.Count : area;
+  }
+  normalizeCost();
+}
+
+void DynamicBVH::normalizeCost() {
+  const float root_area = Nodes.empty() ? 0.0f : surfaceArea(nodeBounds(Nodes[0]));
+  Cost = root_area > 0.0f ? AreaSum / root_area : 0.0f;
+}
+
+void DynamicBVH::refit() {
+  if (StructureChanged) {
+    StructureChanged = false;
+    Generation++;
+    Rebuild rebuild = snapshot();
+    std::vector<BoundingBox> boxes(rebuild.Proxies.size());
+    for (std::size_t i = 0; i < boxes.size(); i++) {
+      boxes[i] = Boxes[rebuild.Proxies[i]];
+    }
+    rebuild.Tree.build(boxes, 1);
+    adopt(rebuild);
+    computeCost();
+    BuildCost = Cost;
+  } else if (DirtyProxies.size() * 4 > ProxyCount) {
+    refitAll();
+  } else {
+    refitDirty();
+  }
+  for (unsigned int proxy : DirtyProxies) {
+    Dirty[proxy] = 0;
+  }
+  DirtyProxies.clear();
+
+  if (PendingRebuild.valid() &&
+      PendingRebuild.wait_for(std::chrono::seconds(0)) ==
+          std::future_status::ready) {
+    Rebuild rebuild = PendingRebuild.get();
+    if (rebuild.Generation == Generation) {
+      // Proxies kept moving during the build; refit to their current boxes
+      adopt(rebuild);
+      refitAll();
+      BuildCost = Cost;
+    }
+  }
+  if (!PendingRebuild.valid() && RebuildThreshold > 0.0f &&
+      getCostRatio() > RebuildThreshold) {
+    Rebuild rebuild = snapshot();
+    std::vector<BoundingBox> boxes(rebuild.Proxies.size());
+    for (std::size_t i = 0; i < boxes.size(); i++) {
+      boxes[i] = Boxes[rebuild.Proxies[i]];
+    }
+    PendingRebuild = std::async(
+        std::launch::async,
+        [](Rebuild rebuild, std::vector<BoundingBox> boxes) {
+          rebuild.Tree.build(boxes, 1);
+          return rebuild;
+        },
+        std::move(rebuild), std::move(boxes));
+  }
+}
+
+void DynamicBVH::raycast(const std::vector<Ray> &rays,
+                         std::vector<ProxyHit> &hits) const {
+  raycast(rays, hits,
+          [this](unsigned int proxy, const Ray &ray, float &distance) {
+            BVHNode node;
+            setBounds(node, Boxes[proxy]);
+            float t;
+            if (!node.intersect(ray.Origin, 1.0f / ray.Direction, distance, t))
+              return false;
+            distance = t;
+            return true;
+          });
+}
+
+void DynamicBVH::overlap(const std::vector<BoundingBox> &boxes,
+                         std::vector<std::vector<unsigned int>> &proxies) const {
+  proxies.resize(boxes.size());
+  for (std::size_t i = 0; i < boxes.size(); i++) {
+    proxies[i].clear();
+    gatherOverlaps(boxes[i], proxies[i]);
+  }
+}
+
+void DynamicBVH::cull(const std::vector<Frustum> &frustums,
+                      std::vector<std::vector<unsigned int>> &proxies) const {
+  proxies.resize(frustums.size());
+  for (std::size_t i = 0; i < frustums.size(); i++) {
+    proxies[i].clear();
+    gatherVisible(frustums[i], proxies[i]);
+  }
+}
+
+void DynamicBVH::nearest(const std::vector<glm::vec3> &points, unsigned int k,
+                         std::vector<std::vector<unsigned int>> &proxies) const {
+  proxies.resize(points.size());
+  for (std::size_t i = 0; i < points.size(); i++) {
+    proxies[i].clear();
+    gatherNearest(points[i], k, proxies[i]);
+  }
+}
+
+static bool overlaps(const BoundingBox &a, const glm::vec3 &min,
+                     const glm::vec3 &max) {
+  return a.Min.x <= max.x && a.Max.x >= min.x && a.Min.y <= max.y &&
+         a.Max.y >= min.y && a.Min.z <= max.z && a.Max.z >= min.z;
+}
+
+void DynamicBVH::gatherOverlaps(const BoundingBox &box,
+                                std::vector<unsigned int> &proxies) const {
+  if (Nodes.empty())
+    return;
+  unsigned int stack[64];
+  unsigned int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const BVHNode &node = Nodes[stack[--top]];
+    if (!overlaps(box, node.Min, node.Max))
+      continue;
+    if (node.isLeaf()) {
+      for (unsigned int j = 0; j < node.Count; j++) {
+        const unsigned int proxy = Order[node.LeftFirst + j];
+        if (overlaps(box, Boxes[proxy].Min, Boxes[proxy].Max))
+          proxies.push_back(proxy);
+      }
+    } else {
+      stack[top++] = node.LeftFirst;
+      stack[top++] = node.LeftFirst + 1;
+    }
+  }
+}
+
+void DynamicBVH::gatherVisible(const Frustum &frustum,
+                               std::vector<unsigned int> &proxies) const {
+  if (Nodes.empty())
+    return;
+  struct Entry {
+    unsigned int Node;
+    bool Inside;
+  };
+  Entry stack[64];
+  unsigned int top = 0;
+  stack[top++] = Entry{0, false};
+  while (top > 0) {
+    const Entry entry = stack[--top];
+    const BVHNode &node = Nodes[entry.Node];
+    bool inside = entry.Inside;
+    if (!inside) {
+      const BoundingBox box = nodeBounds(node);
+      if (!frustum.intersects(box))
+        continue;
+      // Everything below a fully visible node is visible
+      inside = frustum.contains(box);
+    }
+    if (node.isLeaf()) {
+      for (unsigned int j = 0; j < node.Count; j++) {
+        const unsigned int proxy = Order[node.LeftFirst + j];
+        if (inside || frustum.intersects(Boxes[proxy]))
+          proxies.push_back(proxy);
+      }
+    } else {
+      stack[top++] = Entry{node.LeftFirst, inside};
+      stack[top++] = Entry{node.LeftFirst + 1, inside};
+    }
+  }
+}
+
+static float distanceSquared(const glm::vec3 &point, const glm::vec3 &min,
+                             const glm::vec3 &max) {
+  const glm::vec3 d =
+      glm::max(glm::max(min - point, point - max), glm::vec3(0.0f));
+  return glm::dot(d, d);
+}
+
+void DynamicBVH::gatherNearest(const glm::vec3 &point, unsigned int k,
+                               std::vector<unsigned int> &proxies) const {
+  if (Nodes.empty() || k == 0)
+    return;
+  typedef std::pair<float, unsigned int> Candidate;
+  // Nodes by increasing distance; best proxies kept in a max-heap of size k
+  std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>>
+      open;
+  std::priority_queue<Candidate> best;
+  open.push(Candidate(distanceSquared(point, Nodes[0].Min, Nodes[0].Max), 0));
+  while (!open.empty()) {
+    const Candidate candidate = open.top();
+    open.pop();
+    if (best.size() == k && candidate.first > best.top().first)
+      break;
+    const BVHNode &node = Nodes[candidate.second];
+    if (node.isLeaf()) {
+      for (unsigned int j = 0; j < node.Count; j++) {
+        const unsigned int proxy = Order[node.LeftFirst + j];
+        const float d =
+            distanceSquared(point, Boxes[proxy].Min, Boxes[proxy].Max);
+        if (best.size() < k) {
+          best.push(Candidate(d, proxy));
+        } else if (d < best.top().first) {
+          best.pop();
+          best.push(Candidate(d, proxy));
+        }
+      }
+    } else {
+      for (unsigned int child = node.LeftFirst; child <= node.LeftFirst + 1;
+           child++) {
+        open.push(Candidate(
+            distanceSquared(point, Nodes[child].Min, Nodes[child].Max),
+            child));
+      }
+    }
+  }
+  proxies.resize(best.size());
+  for (std::size_t i = proxies.size(); i-- > 0;) {
+    proxies[i] = best.top().second;
+    best.pop();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
@@ -0,0 +1,276 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Bounding Volume Hierarchies
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_BVH_HPP
+#define MGL_BVH_HPP
+
+#include <algorithm>
+#include <cfloat>
+#include <future>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "./mglBounds.hpp"
+
+namespace mgl {
+
+struct BVHNode;
+struct RayHit;
+class BVH;
+struct TrianglePack;
+class TriangleBVH;
+struct ProxyHit;
+class DynamicBVH;
+
+//////////////////////////////////////////////////////////////////////// BVHNode
+
+// 32 bytes. Interior nodes have Count 0 and their children at LeftFirst and
+// LeftFirst + 1; leaves hold Count primitives starting at LeftFirst.
+struct BVHNode {
+  glm::vec3 Min;
+  unsigned int LeftFirst;
+  glm::vec3 Max;
+  unsigned int Count;
+
+  bool isLeaf() const { return Count > 0; }
+  // Slab test against a ray given by its origin and reciprocal direction.
+  bool intersect(const glm::vec3 &origin, const glm::vec3 &inv_direction,
+                 float t_max, float &t_near) const {
+    const glm::vec3 t0 = (Min - origin) * inv_direction;
+    const glm::vec3 t1 = (Max - origin) * inv_direction;
+    const glm::vec3 t_min = glm::min(t0, t1);
+    const glm::vec3 t_far = glm::max(t0, t1);
+    t_near = std::max(std::max(t_min.x, t_min.y), std::max(t_min.z, 0.0f));
+    const float t_exit =
+        std::min(std::min(t_far.x, t_far.y), std::min(t_far.z, t_max));
+    return t_near <= t_exit;
+  }
+};
+
+///////////////////////////////////////////////////////////////////////// RayHit
+
+struct RayHit {
+  float Distance = FLT_MAX; // also the search limit when passed in
+  unsigned int Triangle = ~0u;
+
+  bool isHit() const { return Triangle != ~0u; }
+};
+
+//////////////////////////////////////////////////////////////////////////// BVH
+
+// Binned SAH hierarchy over boxes, flattened into a single node array.
+class BVH {
+public:
+  void build(const std::vector<BoundingBox> &boxes,
+             unsigned int max_leaf_size = 4);
+  void clear();
+  void swap(BVH &other);
+  bool isEmpty() const;
+  std::size_t getNodeCount() const;
+  // Index of the box stored at position i of the leaves.
+  unsigned int getPrimitive(unsigned int i) const;
+
+  // Visits the leaves the ray reaches before t_max, nearest first. The visitor
+  // may shorten t_max to prune the rest of the traversal.
+  template <typename LeafVisitor>
+  void traverse(const Ray &ray, float &t_max, LeafVisitor visit) const;
+
+protected:
+  std::vector<BVHNode> Nodes;
+  std::vector<unsigned int> Order;
+
+private:
+  void subdivide(unsigned int node, const std::vector<BoundingBox> &boxes,
+                 const std::vector<glm::vec3> &centroids,
+                 unsigned int max_leaf_size, unsigned int depth);
+};
+
+template <typename LeafVisitor>
+void BVH::traverse(const Ray &ray, float &t_max, LeafVisitor visit) const {
+  struct Entry {
+    unsigned int Node;
+    float Distance;
+  };
+  if (Nodes.empty())
+    return;
+  const glm::vec3 inv_direction = 1.0f / ray.Direction;
+  float t;
+  if (!Nodes[0].intersect(ray.Origin, inv_direction, t_max, t))
+    return;
+  Entry stack[64];
+  unsigned int top = 0;
+  unsigned int node = 0;
+  for (;;) {
+    const BVHNode &current = Nodes[node];
+    if (current.isLeaf()) {
+      visit(current);
+    } else {
+      const unsigned int left = current.LeftFirst, right = left + 1;
+      float t_left, t_right;
+      const bool hit_left =
+          Nodes[left].intersect(ray.Origin, inv_direction, t_max, t_left);
+      const bool hit_right =
+          Nodes[right].intersect(ray.Origin, inv_direction, t_max, t_right);
+      if (hit_left && hit_right) {
+        const bool left_first = t_left <= t_right;
+        stack[top++] = left_first ? Entry{right, t_right} : Entry{left, t_left};
+        node = left_first ? left : right;
+        continue;
+      }
+      if (hit_left || hit_right) {
+        node = hit_left ? left : right;
+        continue;
+      }
+    }
+    // Skip subtrees that start beyond the closest hit found so far
+    while (top > 0 && stack[top - 1].Distance > t_max)
+      top--;
+    if (top == 0)
+      return;
+    node = stack[--top].Node;
+  }
+}
+
+/////////////////////////////////////////////////////////////////// TrianglePack
+
+// Four triangles in structure-of-arrays layout for the SIMD kernel. Unused
+// lanes have zero edges and never report a hit.
+struct TrianglePack {
+  float V0[3][4];
+  float E1[3][4];
+  float E2[3][4];
+  unsigned int Triangles[4];
+};
+
+//////////////////////////////////////////////////////////////////// TriangleBVH
+
+// Triangle hierarchy of a mesh. Leaves point at runs of TrianglePacks.
+class TriangleBVH : private BVH {
+public:
+  using BVH::getNodeCount;
+  using BVH::isEmpty;
+  void build(const std::vector<glm::vec3> &positions,
+             const std::vector<unsigned int> &indices);
+  void build(const glm::vec3 *positions, const unsigned int *indices,
+             std::size_t index_count);
+  void clear();
+  std::size_t getTriangleCount() const;
+  std::size_t getMemoryUsage() const;
+  // Closest hit nearer than hit.Distance; updates hit and returns true if any.
+  bool intersect(const Ray &ray, RayHit &hit) const;
+
+private:
+  std::vector<TrianglePack> Packs;
+  std::size_t TriangleCount = 0;
+};
+
+/////////////////////////////////////////////////////////////////////// ProxyHit
+
+struct ProxyHit {
+  unsigned int Proxy = ~0u;
+  float Distance = FLT_MAX;
+
+  bool isHit() const { return Proxy != ~0u; }
+};
+
+///////////////////////////////////////////////////////////////////// DynamicBVH
+
+// Hierarchy over moving boxes ("proxies"). Moved proxies are refitted in
+// place; once refitting has degraded the SAH cost past a threshold, a fresh
+// tree is built on a background thread and swapped in when ready. Inserting
+// or removing proxies rebuilds synchronously on the next refit.
+class DynamicBVH : private BVH {
+public:
+  DynamicBVH();
+  ~DynamicBVH();
+  DynamicBVH(const DynamicBVH &) = delete;
+  DynamicBVH &operator=(const DynamicBVH &) = delete;
+
+  unsigned int insert(const BoundingBox &box);
+  void remove(unsigned int proxy);
+  void update(unsigned int proxy, const BoundingBox &box);
+  void clear();
+  void refit();
+  // Cost relative to the last build that triggers a rebuild, 0 disables.
+  void setRebuildThreshold(float ratio);
+
+  std::size_t size() const;
+  const BoundingBox &getBounds(unsigned int proxy) const;
+  float getCostRatio() const;
+  unsigned long long getRebuildCount() const;
+  using BVH::getNodeCount;
+  using BVH::getPrimitive;
+  using BVH::traverse;
+
+  // Batched queries. Results of query i are written to slot i.
+  void raycast(const std::vector<Ray> &rays, std::vector<ProxyHit> &hits) const;
+  // narrowphase(proxy, ray, distance) returns true and lowers distance on a
+  // closer hit inside the proxy, e.g. against its triangles.
+  template <typename Narrowphase>
+  void raycast(const std::vector<Ray> &rays, std::vector<ProxyHit> &hits,
+               Narrowphase narrowphase) const;
+  void overlap(const std::vector<BoundingBox> &boxes,
+               std::vector<std::vector<unsigned int>> &proxies) const;
+  void cull(const std::vector<Frustum> &frustums,
+            std::vector<std::vector<unsigned int>> &proxies) const;
+  // Up to k proxies closest to each point, nearest first.
+  void nearest(const std::vector<glm::vec3> &points, unsigned int k,
+               std::vector<std::vector<unsigned int>> &proxies) const;
+
+private:
+  struct Rebuild {
+    BVH Tree;
+    std::vector<unsigned int> Proxies;
+    unsigned long long Generation = 0;
+  };
+  std::vector<BoundingBox> Boxes;
+  std::vector<unsigned char> Alive, Dirty;
+  std::vector<unsigned int> FreeProxies, DirtyProxies;
+  std::vector<unsigned int> Parents, LeafOf;
+  std::size_t ProxyCount;
+  bool StructureChanged;
+  unsigned long long Generation;
+  float RebuildThreshold, BuildCost, Cost;
+  float AreaSum; // numerator of Cost, kept up to date by partial refits
+  unsigned long long Rebuilds;
+  std::future<Rebuild> PendingRebuild;
+
+  Rebuild snapshot() const;
+  void adopt(Rebuild &rebuild);
+  void linkNodes();
+  void refitAll();
+  void refitDirty();
+  void computeCost();
+  void normalizeCost();
+  void gatherOverlaps(const BoundingBox &box,
+                      std::vector<unsigned int> &proxies) const;
+  void gatherVisible(const Frustum &frustum,
+                     std::vector<unsigned int> &proxies) const;
+  void gatherNearest(const glm::vec3 &point, unsigned int k,
+                     std::vector<unsigned int> &proxies) const;
+};
+
+template <typename Narrowphase>
+void DynamicBVH::raycast(const std::vector<Ray> &rays,
+                         std::vector<ProxyHit> &hits,
+                         Narrowphase narrowphase) const {
+  hits.assign(rays.size(), ProxyHit());
+  for (std::size_t i = 0; i < rays.size(); i++) {
+    ProxyHit &hit = hits[i];
+    traverse(rays[i], hit.Distance, [&](const BVHNode &leaf) {
+      for (unsigned int j = 0; j < leaf.Count; j++) {
+        const unsigned int proxy = Order[leaf.LeftFirst + j];
+        if (narrowphase(proxy, rays[i], hit.Distance))
+          hit.Proxy = proxy;
+      }
+    });
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_BVH_HPP */
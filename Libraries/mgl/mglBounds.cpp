@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Bounding Volumes
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglBounds.hpp"
+
+namespace mgl {
+
+//////////////////////////////////////////////////////////////////// BoundingBox
+
+bool BoundingBox::isEmpty() const {
+  return Min.x > Max.x || Min.y > Max.y || Min.z > Max.z;
+}
+
+glm::vec3 BoundingBox::center() const { return (Min + Max) * 0.5f; }
+
+glm::vec3 BoundingBox::size() const { return Max - Min; }
+
+void BoundingBox::extend(const glm::vec3 &point) {
+  Min = glm::min(Min, point);
+  Max = glm::max(Max, point);
+}
+
+void BoundingBox::extend(const BoundingBox &box) {
+  Min = glm::min(Min, box.Min);
+  Max = glm::max(Max, box.Max);
+}
+
+BoundingBox BoundingBox::transform(const glm::mat4 &matrix) const {
+  if (isEmpty())
+    return *this;
+  // Arvo's method: project the box extents on each axis of the matrix
+  const glm::vec3 c = center();
+  const glm::vec3 e = Max - c;
+  const glm::vec3 wc = glm::vec3(matrix * glm::vec4(c, 1.0f));
+  glm::vec3 we;
+  for (int i = 0; i < 3; i++) {
+    we[i] = glm::abs(matrix[0][i]) * e.x + glm::abs(matrix[1][i]) * e.y +
+            glm::abs(matrix[2][i]) * e.z;
+  }
+  BoundingBox box;
+  box.Min = wc - we;
+  box.Max = wc + we;
+  return box;
+}
+
+//////////////////////////////////////////////////////////////////////// Frustum
+
+Frustum::Frustum() {
+  for (glm::vec4 &plane : Planes)
+    plane = glm::vec4(0.0f);
+}
+
+Frustum::Frustum(const glm::mat4 &m) {
+  // Gribb-Hartmann plane extraction from the clip-space rows
+  const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+  const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+  const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+  const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+  Planes[0] = row3 + row0;
+  Planes[1] = row3 - row0;
+  Planes[2] = row3 + row1;
+  Planes[3] = row3 - row1;
+  Planes[4] = row3 + row2;
+  Planes[5] = row3 - row2;
+}
+
+bool Frustum::intersects(const BoundingBox &box) const {
+  for (const glm::vec4 &plane : Planes) {
+    // Corner of the box furthest along the plane normal
+    const glm::vec3 p(plane.x >= 0.0f ? box.Max.x : box.Min.x,
+                      plane.y >= 0.0f ? box.Max.y : box.Min.y,
+                      plane.z >= 0.0f ? box.Max.z : box.Min.z);
+    if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f)
+      return false;
+  }
+  return true;
+}
+
+bool Frustum::contains(const BoundingBox &box) const {
+  for (const glm::vec4 &plane : Planes) {
+    // Corner of the box furthest against the plane normal
+    const glm::vec3 n(plane.x >= 0.0f ? box.Min.x : box.Max.x,
+                      plane.y >= 0.0f ? box.Min.y : box.Max.y,
+                      plane.z >= 0.0f ? box.Min.z : box.Max.z);
+    if (glm::dot(glm::vec3(plane), n) + plane.w < 0.0f)
+      return false;
+  }
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////////// Ray
+
+Ray Ray::fromScreen(const glm::vec2 &position, const glm::ivec4 &viewport,
+                    const glm::mat4 &viewprojection) {
+  // Window y grows downwards, normalized device y upwards
+  const glm::vec2 ndc(
+      2.0f * (position.x - viewport.x) / viewport.z - 1.0f,
+      1.0f - 2.0f * (position.y - viewport.y) / viewport.w);
+  const glm::mat4 inverse = glm::inverse(viewprojection);
+  glm::vec4 near_point = inverse * glm::vec4(ndc, -1.0f, 1.0f);
+  glm::vec4 far_point = inverse * glm::vec4(ndc, 1.0f, 1.0f);
+  near_point /= near_point.w;
+  far_point /= far_point.w;
+  Ray ray;
+  ray.Origin = glm::vec3(near_point);
+  ray.Direction = glm::normalize(glm::vec3(far_point - near_point));
+  return ray;
+}
+
+Ray Ray::transform(const glm::mat4 &matrix) const {
+  // The direction is left unnormalized so that t keeps its meaning
+  Ray ray;
+  ray.Origin = glm::vec3(matrix * glm::vec4(Origin, 1.0f));
+  ray.Direction = glm::vec3(matrix * glm::vec4(Direction, 0.0f));
+  return ray;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
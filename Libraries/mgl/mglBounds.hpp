@@ -0,0 +1,65 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Bounding Volumes
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_BOUNDS_HPP
+#define MGL_BOUNDS_HPP
+
+#include <cfloat>
+#include <glm/glm.hpp>
+
+namespace mgl {
+
+struct BoundingBox;
+class Frustum;
+struct Ray;
+
+//////////////////////////////////////////////////////////////////// BoundingBox
+
+struct BoundingBox {
+  glm::vec3 Min = glm::vec3(FLT_MAX);
+  glm::vec3 Max = glm::vec3(-FLT_MAX);
+
+  bool isEmpty() const;
+  glm::vec3 center() const;
+  glm::vec3 size() const;
+  void extend(const glm::vec3 &point);
+  void extend(const BoundingBox &box);
+  // Axis-aligned box enclosing this box after an affine transform.
+  BoundingBox transform(const glm::mat4 &matrix) const;
+};
+
+//////////////////////////////////////////////////////////////////////// Frustum
+
+class Frustum {
+public:
+  // A default frustum accepts everything.
+  Frustum();
+  explicit Frustum(const glm::mat4 &viewprojection);
+  bool intersects(const BoundingBox &box) const;
+  // True when the box is entirely inside.
+  bool contains(const BoundingBox &box) const;
+
+private:
+  glm::vec4 Planes[6];
+};
+
+//////////////////////////////////////////////////////////////////////////// Ray
+
+struct Ray {
+  glm::vec3 Origin = glm::vec3(0.0f);
+  glm::vec3 Direction = glm::vec3(0.0f, 0.0f, -1.0f);
+
+  // Ray through a window position, from the near to the far plane.
+  static Ray fromScreen(const glm::vec2 &position, const glm::ivec4 &viewport,
+                        const glm::mat4 &viewprojection);
+  // Same ray expressed in another space; distances along it are preserved.
+  Ray transform(const glm::mat4 &matrix) const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_BOUNDS_HPP */
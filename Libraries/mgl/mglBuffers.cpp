@@ -0,0 +1,125 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Buffers and Vertex Arrays
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglBuffers.hpp"
+
+#include <atomic>
+
+namespace mgl {
+
+namespace {
+
+std::atomic<bool> DirectStateAccess(true);
+
+GLbitfield storageFlags(BufferUsage usage) {
+  return usage == BufferUsage::Dynamic || usage == BufferUsage::Stream
+             ? GL_DYNAMIC_STORAGE_BIT
+             : 0;
+}
+
+GLenum usageHint(BufferUsage usage) {
+  switch (usage) {
+  case BufferUsage::Dynamic:
+    return GL_DYNAMIC_DRAW;
+  case BufferUsage::Stream:
+    return GL_STREAM_DRAW;
+  case BufferUsage::Gpu:
+    return GL_DYNAMIC_COPY;
+  default:
+    return GL_STATIC_DRAW;
+  }
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////// Buffers
+
+bool hasDirectStateAccess() {
+  return DirectStateAccess &&
+         (GLEW_VERSION_4_5 ||
+          (GLEW_ARB_direct_state_access && GLEW_ARB_buffer_storage));
+}
+
+void setDirectStateAccess(bool enabled) { DirectStateAccess = enabled; }
+
+GLuint createBuffer(GLsizeiptr bytes, const void *data, BufferUsage usage) {
+  GLuint buffer;
+  if (hasDirectStateAccess()) {
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, bytes, data, storageFlags(usage));
+  } else {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, bytes, data, usageHint(usage));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  }
+  return buffer;
+}
+
+void updateBuffer(GLuint buffer, GLintptr offset, GLsizeiptr bytes,
+                  const void *data) {
+  if (hasDirectStateAccess()) {
+    glNamedBufferSubData(buffer, offset, bytes, data);
+  } else {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  }
+}
+
+void readBuffer(GLuint buffer, GLintptr offset, GLsizeiptr bytes, void *data) {
+  if (hasDirectStateAccess()) {
+    glGetNamedBufferSubData(buffer, offset, bytes, data);
+  } else {
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, offset, bytes, data);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  }
+}
+
+////////////////////////////////////////////////////////////////// Vertex Arrays
+
+GLuint createVertexArray() {
+  GLuint vao;
+  if (hasDirectStateAccess()) {
+    glCreateVertexArrays(1, &vao);
+  } else {
+    glGenVertexArrays(1, &vao);
+  }
+  return vao;
+}
+
+void setVertexAttribute(GLuint vao, GLuint index, GLint size, GLuint buffer,
+                        GLintptr offset, GLsizei stride) {
+  if (hasDirectStateAccess()) {
+    // One buffer binding per attribute, numbered like the attribute
+    glEnableVertexArrayAttrib(vao, index);
+    glVertexArrayAttribFormat(vao, index, size, GL_FLOAT, GL_FALSE, 0);
+    glVertexArrayAttribBinding(vao, index, index);
+    glVertexArrayVertexBuffer(vao, index, buffer, offset, stride);
+  } else {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnableVertexAttribArray(index);
+    glVertexAttribPointer(index, size, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<void *>(offset));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+}
+
+void setIndexBuffer(GLuint vao, GLuint buffer) {
+  if (hasDirectStateAccess()) {
+    glVertexArrayElementBuffer(vao, buffer);
+  } else {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+    glBindVertexArray(0);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
@@ -0,0 +1,48 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Buffers and Vertex Arrays
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_BUFFERS_HPP
+#define MGL_BUFFERS_HPP
+
+#include <GL/glew.h>
+
+namespace mgl {
+
+// Buffers and vertex arrays are created and edited through direct state access
+// (GL 4.5, or ARB_direct_state_access with ARB_buffer_storage), and buffers
+// get immutable storage. On older contexts, such as 3.3, the same functions
+// bind the object to edit it and unbind it afterwards: GL_COPY_WRITE_BUFFER
+// for buffers, so the vertex array and indexed bindings are left alone.
+
+// Whether the direct state access path is in use. Disabling it forces the
+// fallback; set it before creating any objects.
+bool hasDirectStateAccess();
+void setDirectStateAccess(bool enabled);
+
+enum class BufferUsage {
+  Static,  // written once, at creation
+  Dynamic, // rewritten now and then with updateBuffer
+  Stream,  // rewritten every frame with updateBuffer
+  Gpu      // written by shaders only
+};
+
+// data may be null when the usage allows writing the buffer later.
+GLuint createBuffer(GLsizeiptr bytes, const void *data, BufferUsage usage);
+void updateBuffer(GLuint buffer, GLintptr offset, GLsizeiptr bytes,
+                  const void *data);
+void readBuffer(GLuint buffer, GLintptr offset, GLsizeiptr bytes, void *data);
+
+GLuint createVertexArray();
+// Float attribute index with size components, read from buffer starting at
+// offset, stride bytes apart (never 0 for tightly packed).
+void setVertexAttribute(GLuint vao, GLuint index, GLint size, GLuint buffer,
+                        GLintptr offset, GLsizei stride);
+void setIndexBuffer(GLuint vao, GLuint buffer);
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_BUFFERS_HPP */
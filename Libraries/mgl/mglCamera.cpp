@@ -8,46 +8,45 @@
 
 #include "./mglCamera.hpp"
 
+#include "./mglBuffers.hpp"
+#include "./mglStats.hpp"
+
 namespace mgl {
 
 ///////////////////////////////////////////////////////////////////////// Camera
 
 Camera::Camera(GLuint bindingpoint)
     : ViewMatrix(glm::mat4(1.0f)), ProjectionMatrix(glm::mat4(1.0f)) {
-  glGenBuffers(1, &UboId);
-  glBindBuffer(GL_UNIFORM_BUFFER, UboId);
-  glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4) * 2, 0, GL_STREAM_DRAW);
-  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4),
-                  glm::value_ptr(ViewMatrix));
-  glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4),
-                  glm::value_ptr(ProjectionMatrix));
+  const glm::mat4 matrices[2] = {ViewMatrix, ProjectionMatrix};
+  UboId = createBuffer(sizeof(matrices), matrices, BufferUsage::Stream);
   glBindBufferBase(GL_UNIFORM_BUFFER, bindingpoint, UboId);
-  glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
-Camera::~Camera() {
-  glBindBuffer(GL_UNIFORM_BUFFER, 0);
-  glDeleteBuffers(1, &UboId);
-}
+Camera::~Camera() { glDeleteBuffers(1, &UboId); }
 
 glm::mat4 Camera::getViewMatrix() const { return ViewMatrix; }
 
 void Camera::setViewMatrix(const glm::mat4 &viewmatrix) {
   ViewMatrix = viewmatrix;
-  glBindBuffer(GL_UNIFORM_BUFFER, UboId);
-  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4),
-                  glm::value_ptr(ViewMatrix));
-  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  updateBuffer(UboId, 0, sizeof(glm::mat4), glm::value_ptr(ViewMatrix));
+  countUpload();
 }
 
 glm::mat4 Camera::getProjectionMatrix() const { return ProjectionMatrix; }
 
 void Camera::setProjectionMatrix(const glm::mat4 &projectionmatrix) {
   ProjectionMatrix = projectionmatrix;
-  glBindBuffer(GL_UNIFORM_BUFFER, UboId);
-  glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4),
-                  glm::value_ptr(ProjectionMatrix));
-  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  updateBuffer(UboId, sizeof(glm::mat4), sizeof(glm::mat4),
+               glm::value_ptr(ProjectionMatrix));
+  countUpload();
+}
+
+void Camera::countUpload() {
+  FrameStats &stats = currentFrameStats();
+  if (!hasDirectStateAccess())
+    stats.BufferBinds++;
+  stats.UniformUploads++;
+  stats.BufferBytes += sizeof(glm::mat4);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -24,6 +24,7 @@ private:
   GLuint UboId;
   glm::mat4 ViewMatrix;
   glm::mat4 ProjectionMatrix;
+  void countUpload();
 
 public:
   explicit Camera(GLuint bindingpoint);
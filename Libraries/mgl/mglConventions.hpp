@@ -19,6 +19,11 @@ const char VIEW_MATRIX[] = "ViewMatrix";
 const char PROJECTION_MATRIX[] = "ProjectionMatrix";
 const char TEXTURE_MATRIX[] = "TextureMatrix";
 const char CAMERA_BLOCK[] = "Camera";
+const char ANIMATION_TIME[] = "AnimationTime";
+const char INSTANCE_OFFSET[] = "InstanceOffset";
+const char TRANSFORM_INDEX[] = "TransformIndex";
+const char LEVEL_FIRST[] = "LevelFirst";
+const char LEVEL_COUNT[] = "LevelCount";
 
 const char POSITION_ATTRIBUTE[] = "inPosition";
 const char NORMAL_ATTRIBUTE[] = "inNormal";
@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Frame Pacing
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglFramePacer.hpp"
+
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace mgl {
+
+///////////////////////////////////////////////////////////////////// FramePacer
+
+FramePacer::FramePacer()
+    : MaxFramesInFlight(2), TargetFramePeriod(0.0), LastFrameStart(0.0),
+      Frames(0), TotalFenceWait(0.0), MaxFenceWait(0.0), TotalLimiterWait(0.0),
+      LatencySamples(0), TotalLatency(0.0), MaxLatency(0.0) {}
+
+void FramePacer::setMaxFramesInFlight(unsigned int frames) {
+  MaxFramesInFlight = frames;
+}
+
+void FramePacer::setTargetFrameRate(double fps) {
+  TargetFramePeriod = fps > 0.0 ? 1.0 / fps : 0.0;
+}
+
+void FramePacer::wait() {
+  double start = glfwGetTime();
+  while (MaxFramesInFlight && Fences.size() >= MaxFramesInFlight) {
+    GLenum result = glClientWaitSync(Fences.front(), GL_SYNC_FLUSH_COMMANDS_BIT,
+                                     1000000000); // 1s in nanoseconds
+    if (result == GL_TIMEOUT_EXPIRED)
+      continue;
+    glDeleteSync(Fences.front());
+    Fences.pop_front();
+  }
+  double fence_wait = glfwGetTime() - start;
+  TotalFenceWait += fence_wait;
+  MaxFenceWait = std::max(MaxFenceWait, fence_wait);
+
+  if (TargetFramePeriod > 0.0 && Frames > 0) {
+    start = glfwGetTime();
+    const double deadline = LastFrameStart + TargetFramePeriod;
+    // Sleep coarsely, then spin the last millisecond for accuracy
+    while (deadline - glfwGetTime() > 0.002) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    while (glfwGetTime() < deadline) {
+      std::this_thread::yield();
+    }
+    TotalLimiterWait += glfwGetTime() - start;
+  }
+  LastFrameStart = glfwGetTime();
+}
+
+void FramePacer::frameSubmitted() {
+  Frames++;
+  if (MaxFramesInFlight) {
+    Fences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+  }
+}
+
+void FramePacer::recordLatency(double latency) {
+  LatencySamples++;
+  TotalLatency += latency;
+  MaxLatency = std::max(MaxLatency, latency);
+}
+
+void FramePacer::release() {
+  for (GLsync fence : Fences) {
+    glDeleteSync(fence);
+  }
+  Fences.clear();
+}
+
+unsigned long long FramePacer::getFrames() const { return Frames; }
+
+double FramePacer::getTotalFenceWait() const { return TotalFenceWait; }
+
+double FramePacer::getMaxFenceWait() const { return MaxFenceWait; }
+
+double FramePacer::getTotalLimiterWait() const { return TotalLimiterWait; }
+
+unsigned long long FramePacer::getLatencySamples() const {
+  return LatencySamples;
+}
+
+double FramePacer::getTotalLatency() const { return TotalLatency; }
+
+double FramePacer::getMaxLatency() const { return MaxLatency; }
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
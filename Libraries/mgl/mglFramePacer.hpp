@@ -0,0 +1,62 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Frame Pacing
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_FRAME_PACER_HPP
+#define MGL_FRAME_PACER_HPP
+
+#include <GL/glew.h>
+#include <deque>
+
+namespace mgl {
+
+class FramePacer;
+
+///////////////////////////////////////////////////////////////////// FramePacer
+
+// Keeps the CPU at most a few frames ahead of the GPU by fencing every
+// submitted frame, and optionally limits the frame rate.
+class FramePacer {
+public:
+  FramePacer();
+  FramePacer(const FramePacer &) = delete;
+  FramePacer &operator=(const FramePacer &) = delete;
+
+  // 0 disables the cap.
+  void setMaxFramesInFlight(unsigned int frames);
+  // Frames per second, 0 disables the limiter.
+  void setTargetFrameRate(double fps);
+
+  // Blocks until the GPU has caught up and the limiter allows a new frame.
+  void wait();
+  // Fences the frame just submitted (call after swapping buffers).
+  void frameSubmitted();
+  void recordLatency(double latency);
+  // Deletes pending fences; requires the GL context to be current.
+  void release();
+
+  unsigned long long getFrames() const;
+  double getTotalFenceWait() const;
+  double getMaxFenceWait() const;
+  double getTotalLimiterWait() const;
+  unsigned long long getLatencySamples() const;
+  double getTotalLatency() const;
+  double getMaxLatency() const;
+
+private:
+  std::deque<GLsync> Fences;
+  unsigned int MaxFramesInFlight;
+  double TargetFramePeriod;
+  double LastFrameStart;
+  unsigned long long Frames;
+  double TotalFenceWait, MaxFenceWait, TotalLimiterWait;
+  unsigned long long LatencySamples;
+  double TotalLatency, MaxLatency;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_FRAME_PACER_HPP */
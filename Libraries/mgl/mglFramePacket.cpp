@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Frame Packets
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglFramePacket.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "./mglCamera.hpp"
+#include "./mglConventions.hpp"
+#include "./mglInstancing.hpp"
+#include "./mglMesh.hpp"
+#include "./mglShader.hpp"
+#include "./mglStreaming.hpp"
+
+namespace mgl {
+
+//////////////////////////////////////////////////////////////////// FramePacket
+
+void FramePacket::clear() {
+  FrameIndex = 0;
+  InputTime = 0.0;
+  Camera = nullptr;
+  Viewport = glm::ivec4(0);
+  Items.clear();
+  Instanced = InstancedDraw();
+  Streamed.clear();
+  Transforms = nullptr;
+  TransformUpdates.clear();
+  Statics = nullptr;
+  StaticUpdates.clear();
+  Stats.reset();
+}
+
+void FramePacket::sortItems() {
+  auto before = [](const DrawItem &a, const DrawItem &b) {
+    const std::uint64_t a_key = a.Shaders->getVariantKey();
+    const std::uint64_t b_key = b.Shaders->getVariantKey();
+    if (a_key != b_key)
+      return a_key < b_key;
+    return std::less<const mgl::Mesh *>()(a.Mesh, b.Mesh);
+  };
+  if (!std::is_sorted(Items.begin(), Items.end(), before)) {
+    std::stable_sort(Items.begin(), Items.end(), before);
+  }
+}
+
+static GLint uniformIndex(const ShaderProgram *shaders, const char *name) {
+  auto i = shaders->Uniforms.find(name);
+  return i == shaders->Uniforms.end() ? -1 : i->second.index;
+}
+
+void FramePacket::submit() const {
+  if (Viewport.z > 0) {
+    glViewport(Viewport.x, Viewport.y, Viewport.z, Viewport.w);
+  }
+  if (Camera) {
+    Camera->setViewMatrix(ViewMatrix);
+    Camera->setProjectionMatrix(ProjectionMatrix);
+  }
+
+  if (Transforms) {
+    Transforms->update(TransformUpdates);
+    Transforms->propagate();
+  }
+
+  // Consecutive items sharing a program are drawn without rebinding it
+  ShaderProgram *bound = nullptr;
+  GLint model_matrix_id = -1, color_id = -1, transform_index_id = -1;
+  FrameStats &stats = currentFrameStats();
+  for (const DrawItem &item : Items) {
+    if (item.Shaders != bound) {
+      bound = item.Shaders;
+      bound->bind();
+      model_matrix_id = uniformIndex(bound, MODEL_MATRIX);
+      color_id = uniformIndex(bound, COLOR_ATTRIBUTE);
+      transform_index_id = uniformIndex(bound, TRANSFORM_INDEX);
+    }
+    if (item.TransformIndex >= 0) {
+      glUniform1ui(transform_index_id, static_cast<GLuint>(item.TransformIndex));
+    } else {
+      glUniformMatrix4fv(model_matrix_id, 1, GL_FALSE,
+                         glm::value_ptr(item.ModelMatrix));
+    }
+    glUniform4fv(color_id, 1, glm::value_ptr(item.Color));
+    stats.UniformUploads += 2;
+    item.Mesh->draw();
+  }
+  if (bound) {
+    bound->unbind();
+  }
+  if (Statics) {
+    Statics->update(StaticUpdates);
+    Statics->draw();
+  }
+  if (Instanced.Animation) {
+    Instanced.Animation->draw(Instanced.Time, Instanced.ModelMatrix);
+  }
+  for (const StreamedDraw &draw : Streamed) {
+    // Streaming works in model space
+    const glm::mat4 model_view = ViewMatrix * draw.ModelMatrix;
+    const glm::vec3 viewpoint =
+        glm::vec3(glm::inverse(model_view) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    draw.Mesh->update(viewpoint, Frustum(ProjectionMatrix * model_view));
+    draw.Shaders->bind();
+    glUniformMatrix4fv(uniformIndex(draw.Shaders, MODEL_MATRIX), 1, GL_FALSE,
+                       glm::value_ptr(draw.ModelMatrix));
+    glUniform4fv(uniformIndex(draw.Shaders, COLOR_ATTRIBUTE), 1,
+                 glm::value_ptr(draw.Color));
+    stats.UniformUploads += 2;
+    draw.Mesh->draw();
+    draw.Shaders->unbind();
+  }
+}
+
+////////////////////////////////////////////////////////////// FramePacketBuffer
+
+FramePacketBuffer::FramePacketBuffer() : Produced(0), Consumed(0) {}
+
+FramePacket *FramePacketBuffer::beginWrite() {
+  const unsigned long long produced = Produced.load(std::memory_order_relaxed);
+  if (produced - Consumed.load(std::memory_order_acquire) >= 2)
+    return nullptr;
+  return &Packets[produced & 1];
+}
+
+void FramePacketBuffer::endWrite() {
+  Produced.fetch_add(1, std::memory_order_release);
+}
+
+const FramePacket *FramePacketBuffer::beginRead() {
+  const unsigned long long consumed = Consumed.load(std::memory_order_relaxed);
+  if (Produced.load(std::memory_order_acquire) == consumed)
+    return nullptr;
+  return &Packets[consumed & 1];
+}
+
+void FramePacketBuffer::endRead() {
+  Consumed.fetch_add(1, std::memory_order_release);
+}
+
+unsigned long long FramePacketBuffer::produced() const {
+  return Produced.load(std::memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Frame Packets
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_FRAME_PACKET_HPP
+#define MGL_FRAME_PACKET_HPP
+
+#include <GL/glew.h>
+#include <atomic>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "./mglStaticBatching.hpp"
+#include "./mglStats.hpp"
+#include "./mglTransformHierarchy.hpp"
+
+namespace mgl {
+
+class Camera;
+class InstancedAnimation;
+class Mesh;
+class ShaderProgram;
+class StreamedMesh;
+struct DrawItem;
+struct InstancedDraw;
+struct StreamedDraw;
+struct FramePacket;
+class FramePacketBuffer;
+
+/////////////////////////////////////////////////////////////////////// DrawItem
+
+struct DrawItem {
+  ShaderProgram *Shaders;
+  mgl::Mesh *Mesh;
+  glm::mat4 ModelMatrix;
+  glm::vec4 Color;
+  GLint TransformIndex = -1; // world computed on the GPU, instead of ModelMatrix
+};
+
+////////////////////////////////////////////////////////////////// InstancedDraw
+
+// Instances animated on the GPU, drawn after the packet's items.
+struct InstancedDraw {
+  const InstancedAnimation *Animation = nullptr;
+  glm::mat4 ModelMatrix = glm::mat4(1.0f);
+  float Time = 0.0f;
+};
+
+/////////////////////////////////////////////////////////////////// StreamedDraw
+
+// Out-of-core mesh, streamed for this frame's view just before it is drawn.
+struct StreamedDraw {
+  ShaderProgram *Shaders;
+  StreamedMesh *Mesh;
+  glm::mat4 ModelMatrix;
+  glm::vec4 Color;
+};
+
+//////////////////////////////////////////////////////////////////// FramePacket
+
+// Everything the GL thread needs to render one frame, built without GL calls.
+struct FramePacket {
+  unsigned long long FrameIndex = 0;
+  double InputTime = 0.0; // when the oldest input behind this frame arrived
+  mgl::Camera *Camera = nullptr;
+  glm::mat4 ViewMatrix = glm::mat4(1.0f);
+  glm::mat4 ProjectionMatrix = glm::mat4(1.0f);
+  glm::ivec4 Viewport = glm::ivec4(0); // ignored while width is 0
+  std::vector<DrawItem> Items;
+  InstancedDraw Instanced;
+  std::vector<StreamedDraw> Streamed;
+  TransformHierarchy *Transforms = nullptr; // propagated before the items
+  std::vector<TransformUpdate> TransformUpdates;
+  StaticBatches *Statics = nullptr; // drawn after the items
+  std::vector<StaticUpdate> StaticUpdates;
+  FrameStats Stats; // counted while the packet was built
+
+  void clear();
+  // Orders the items by program variant, then mesh, so each program is bound
+  // once; keeps the order if it already is.
+  void sortItems();
+  void submit() const;
+};
+
+////////////////////////////////////////////////////////////// FramePacketBuffer
+
+// Single-producer single-consumer double buffer: the producer fills one packet
+// while the consumer submits the other. Hand-over uses two atomic counters.
+class FramePacketBuffer {
+public:
+  FramePacketBuffer();
+  // Producer side; beginWrite returns nullptr while both packets are in use.
+  FramePacket *beginWrite();
+  void endWrite();
+  // Consumer side; beginRead returns nullptr until a new packet is published.
+  const FramePacket *beginRead();
+  void endRead();
+  // Index of the next packet the producer will write.
+  unsigned long long produced() const;
+
+private:
+  FramePacket Packets[2];
+  std::atomic<unsigned long long> Produced;
+  std::atomic<unsigned long long> Consumed;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_FRAME_PACKET_HPP */
@@ -0,0 +1,166 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Input Recording and Replay
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglInputLog.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+namespace mgl {
+
+// File layout: magic, version, then one record per event made of a type byte
+// followed only by the fields that event type uses.
+static const char INPUT_LOG_MAGIC[4] = {'M', 'G', 'L', 'I'};
+static const std::uint32_t INPUT_LOG_VERSION = 1;
+
+///////////////////////////////////////////////////////////////// InputLogWriter
+
+InputLogWriter::InputLogWriter(const std::string &filename)
+    : File(filename, std::ios::binary | std::ios::trunc) {
+  if (!File.is_open()) {
+    std::cerr << "[ERROR] Failed to open input log: " << filename << std::endl;
+    throw std::runtime_error("Failed to open input log.");
+  }
+  File.write(INPUT_LOG_MAGIC, sizeof(INPUT_LOG_MAGIC));
+  put(INPUT_LOG_VERSION);
+}
+
+template <typename T> void InputLogWriter::put(T value) {
+  File.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void InputLogWriter::write(const InputEvent &event) {
+  put(static_cast<std::uint8_t>(event.Type));
+  switch (event.Type) {
+  case InputEventType::Frame:
+    put(event.X);
+    break;
+  case InputEventType::Cursor:
+  case InputEventType::Scroll:
+    put(event.X);
+    put(event.Y);
+    break;
+  case InputEventType::Key:
+    put(static_cast<std::int32_t>(event.A));
+    put(static_cast<std::int32_t>(event.B));
+    put(static_cast<std::uint8_t>(event.C));
+    put(static_cast<std::uint8_t>(event.D));
+    break;
+  case InputEventType::MouseButton:
+    put(static_cast<std::uint8_t>(event.A));
+    put(static_cast<std::uint8_t>(event.C));
+    put(static_cast<std::uint8_t>(event.D));
+    put(event.X);
+    put(event.Y);
+    break;
+  case InputEventType::WindowSize:
+  case InputEventType::Joystick:
+    put(static_cast<std::int32_t>(event.A));
+    put(static_cast<std::int32_t>(event.B));
+    break;
+  }
+}
+
+///////////////////////////////////////////////////////////////// InputLogReader
+
+namespace {
+
+class ByteCursor {
+public:
+  ByteCursor(const std::vector<char> &bytes) : Bytes(bytes), Offset(0) {}
+
+  bool done() const { return Offset >= Bytes.size(); }
+
+  template <typename T> T get() {
+    if (Offset + sizeof(T) > Bytes.size()) {
+      throw std::runtime_error("Truncated input log.");
+    }
+    T value;
+    std::memcpy(&value, Bytes.data() + Offset, sizeof(T));
+    Offset += sizeof(T);
+    return value;
+  }
+
+private:
+  const std::vector<char> &Bytes;
+  std::size_t Offset;
+};
+
+} // namespace
+
+InputLogReader::InputLogReader(const std::string &filename) : Position(0) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "[ERROR] Failed to open input log: " << filename << std::endl;
+    throw std::runtime_error("Failed to open input log.");
+  }
+  const std::vector<char> bytes((std::istreambuf_iterator<char>(file)),
+                                std::istreambuf_iterator<char>());
+  ByteCursor in(bytes);
+  char magic[4];
+  for (char &c : magic)
+    c = in.get<char>();
+  if (std::memcmp(magic, INPUT_LOG_MAGIC, sizeof(magic)) != 0 ||
+      in.get<std::uint32_t>() != INPUT_LOG_VERSION) {
+    std::cerr << "[ERROR] Not an input log: " << filename << std::endl;
+    throw std::runtime_error("Unsupported input log.");
+  }
+
+  while (!in.done()) {
+    InputEvent event;
+    event.Type = static_cast<InputEventType>(in.get<std::uint8_t>());
+    switch (event.Type) {
+    case InputEventType::Frame:
+      event.X = in.get<double>();
+      break;
+    case InputEventType::Cursor:
+    case InputEventType::Scroll:
+      event.X = in.get<double>();
+      event.Y = in.get<double>();
+      break;
+    case InputEventType::Key:
+      event.A = in.get<std::int32_t>();
+      event.B = in.get<std::int32_t>();
+      event.C = in.get<std::uint8_t>();
+      event.D = in.get<std::uint8_t>();
+      break;
+    case InputEventType::MouseButton:
+      event.A = in.get<std::uint8_t>();
+      event.C = in.get<std::uint8_t>();
+      event.D = in.get<std::uint8_t>();
+      event.X = in.get<double>();
+      event.Y = in.get<double>();
+      break;
+    case InputEventType::WindowSize:
+    case InputEventType::Joystick:
+      event.A = in.get<std::int32_t>();
+      event.B = in.get<std::int32_t>();
+      break;
+    default:
+      throw std::runtime_error("Corrupt input log.");
+    }
+    Events.push_back(event);
+  }
+}
+
+bool InputLogReader::next(InputEvent &event) {
+  if (Position >= Events.size())
+    return false;
+  event = Events[Position++];
+  return true;
+}
+
+bool InputLogReader::peek(InputEventType &type) const {
+  if (Position >= Events.size())
+    return false;
+  type = Events[Position].Type;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
@@ -0,0 +1,70 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Input Recording and Replay
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_INPUT_LOG_HPP
+#define MGL_INPUT_LOG_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace mgl {
+
+struct InputEvent;
+class InputLogWriter;
+class InputLogReader;
+
+///////////////////////////////////////////////////////////////////// InputEvent
+
+enum class InputEventType : std::uint8_t {
+  Frame,       // X: elapsed time of the frame that follows
+  Cursor,      // X, Y: cursor position
+  Key,         // A: key, B: scancode, C: action, D: mods
+  MouseButton, // A: button, C: action, D: mods, X, Y: cursor position
+  Scroll,      // X, Y: offsets
+  WindowSize,  // A: width, B: height
+  Joystick     // A: jid, B: event
+};
+
+struct InputEvent {
+  InputEventType Type = InputEventType::Frame;
+  double X = 0.0, Y = 0.0;
+  int A = 0, B = 0, C = 0, D = 0;
+};
+
+///////////////////////////////////////////////////////////////// InputLogWriter
+
+class InputLogWriter {
+public:
+  explicit InputLogWriter(const std::string &filename);
+  void write(const InputEvent &event);
+
+private:
+  std::ofstream File;
+
+  template <typename T> void put(T value);
+};
+
+///////////////////////////////////////////////////////////////// InputLogReader
+
+class InputLogReader {
+public:
+  explicit InputLogReader(const std::string &filename);
+  // Returns false once the log is exhausted.
+  bool next(InputEvent &event);
+  // Returns the type of the next event without consuming it.
+  bool peek(InputEventType &type) const;
+
+private:
+  std::vector<InputEvent> Events;
+  std::size_t Position;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_INPUT_LOG_HPP */
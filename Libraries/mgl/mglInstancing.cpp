@@ -0,0 +1,141 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Instanced Animation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglInstancing.hpp"
+
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "./mglBuffers.hpp"
+#include "./mglConventions.hpp"
+#include "./mglMesh.hpp"
+#include "./mglShader.hpp"
+#include "./mglStats.hpp"
+
+namespace mgl {
+
+///////////////////////////////////////////////////////////// InstancedAnimation
+
+InstancedAnimation::InstancedAnimation()
+    : InstanceCount(0), Buffers{0, 0}, BufferBytes(0) {}
+
+InstancedAnimation::~InstancedAnimation() { destroyBuffers(); }
+
+void InstancedAnimation::addInstance(Mesh *mesh, ShaderProgram *shaders,
+                                     const glm::vec4 &color,
+                                     const glm::mat4 &base, float phase,
+                                     const std::vector<AnimationLayer> &layers) {
+  const std::string key(reinterpret_cast<const char *>(layers.data()),
+                        layers.size() * sizeof(AnimationLayer));
+  auto chain = Chains.find(key);
+  if (chain == Chains.end()) {
+    chain = Chains.insert({key, static_cast<GLuint>(Layers.size())}).first;
+    Layers.insert(Layers.end(), layers.begin(), layers.end());
+  }
+
+  Batch *batch = nullptr;
+  for (Batch &candidate : Batches) {
+    if (candidate.DrawMesh == mesh && candidate.Shaders == shaders &&
+        candidate.Color == color) {
+      batch = &candidate;
+      break;
+    }
+  }
+  if (!batch) {
+    Batches.push_back({mesh, shaders, color, {}, 0});
+    batch = &Batches.back();
+  }
+  batch->Instances.push_back({base, phase, chain->second,
+                              static_cast<GLuint>(layers.size()), 0});
+  InstanceCount++;
+}
+
+void InstancedAnimation::clear() {
+  Batches.clear();
+  Layers.clear();
+  Chains.clear();
+  InstanceCount = 0;
+  destroyBuffers();
+}
+
+void InstancedAnimation::upload() {
+  destroyBuffers();
+  std::vector<AnimatedInstance> instances;
+  instances.reserve(InstanceCount);
+  for (Batch &batch : Batches) {
+    batch.First = static_cast<GLuint>(instances.size());
+    instances.insert(instances.end(), batch.Instances.begin(),
+                     batch.Instances.end());
+  }
+  // Empty storage blocks are not allowed, so both buffers hold at least one
+  const AnimationLayer identity;
+  const std::size_t layer_bytes =
+      std::max<std::size_t>(Layers.size(), 1) * sizeof(AnimationLayer);
+  const std::size_t instance_bytes =
+      std::max<std::size_t>(instances.size(), 1) * sizeof(AnimatedInstance);
+
+  Buffers[0] = createBuffer(layer_bytes,
+                            Layers.empty() ? &identity : Layers.data(),
+                            BufferUsage::Static);
+  Buffers[1] = createBuffer(instance_bytes,
+                            instances.empty() ? nullptr : instances.data(),
+                            BufferUsage::Static);
+  BufferBytes = layer_bytes + instance_bytes;
+
+  FrameStats &stats = currentFrameStats();
+  if (!hasDirectStateAccess())
+    stats.BufferBinds += 2;
+  stats.BufferBytes += BufferBytes;
+}
+
+void InstancedAnimation::destroyBuffers() {
+  if (Buffers[0] != 0) {
+    glDeleteBuffers(2, Buffers);
+    Buffers[0] = Buffers[1] = 0;
+  }
+  BufferBytes = 0;
+}
+
+static GLint uniformIndex(const ShaderProgram *shaders, const char *name) {
+  auto i = shaders->Uniforms.find(name);
+  return i == shaders->Uniforms.end() ? -1 : i->second.index;
+}
+
+void InstancedAnimation::draw(float time,
+                              const glm::mat4 &model_matrix) const {
+  if (Buffers[0] == 0)
+    return;
+  FrameStats &stats = currentFrameStats();
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LAYER_BINDING, Buffers[0]);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, Buffers[1]);
+  stats.BufferBinds += 2;
+  for (const Batch &batch : Batches) {
+    batch.Shaders->bind();
+    glUniformMatrix4fv(uniformIndex(batch.Shaders, MODEL_MATRIX), 1, GL_FALSE,
+                       glm::value_ptr(model_matrix));
+    glUniform4fv(uniformIndex(batch.Shaders, COLOR_ATTRIBUTE), 1,
+                 glm::value_ptr(batch.Color));
+    glUniform1f(uniformIndex(batch.Shaders, ANIMATION_TIME), time);
+    glUniform1ui(uniformIndex(batch.Shaders, INSTANCE_OFFSET), batch.First);
+    stats.UniformUploads += 4;
+    batch.DrawMesh->drawInstanced(
+        static_cast<GLsizei>(batch.Instances.size()));
+    batch.Shaders->unbind();
+  }
+}
+
+std::size_t InstancedAnimation::getInstanceCount() const {
+  return InstanceCount;
+}
+
+std::size_t InstancedAnimation::getLayerCount() const { return Layers.size(); }
+
+std::size_t InstancedAnimation::getBatchCount() const { return Batches.size(); }
+
+std::size_t InstancedAnimation::getBufferBytes() const { return BufferBytes; }
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Instanced Animation
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_INSTANCING_HPP
+#define MGL_INSTANCING_HPP
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "./mglAnimation.hpp"
+
+namespace mgl {
+
+class Mesh;
+class ShaderProgram;
+struct AnimatedInstance;
+class InstancedAnimation;
+
+/////////////////////////////////////////////////////////////// AnimatedInstance
+
+// Matches the std430 layout of the instance block (80 bytes). The instance's
+// model matrix is Base * Layers[LayerFirst] * ... * Layers[LayerFirst +
+// LayerCount - 1], with every layer blended at the instance's own time.
+struct AnimatedInstance {
+  glm::mat4 Base;
+  float Phase;
+  GLuint LayerFirst;
+  GLuint LayerCount;
+  GLuint Padding;
+};
+
+///////////////////////////////////////////////////////////// InstancedAnimation
+
+// Pieces whose animation is evaluated in the vertex shader. Layers and
+// instances are uploaded once to shader storage buffers; each frame only
+// sets a time uniform and issues one instanced draw per mesh, shader and
+// colour, so the CPU cost does not grow with the number of instances.
+//
+// The shaders must declare the layer and instance blocks at LAYER_BINDING and
+// INSTANCE_BINDING, and read instance INSTANCE_OFFSET + gl_InstanceID.
+class InstancedAnimation {
+public:
+  static const GLuint LAYER_BINDING = 0;
+  static const GLuint INSTANCE_BINDING = 1;
+
+  InstancedAnimation();
+  ~InstancedAnimation();
+  InstancedAnimation(const InstancedAnimation &) = delete;
+  InstancedAnimation &operator=(const InstancedAnimation &) = delete;
+
+  // Instances with the same chain of layers share one copy of it.
+  void addInstance(Mesh *mesh, ShaderProgram *shaders, const glm::vec4 &color,
+                   const glm::mat4 &base, float phase,
+                   const std::vector<AnimationLayer> &layers);
+  void clear();
+  // Requires a GL context; call again after adding instances.
+  void upload();
+  // Draws every instance at time, under the model matrix of the whole group.
+  void draw(float time, const glm::mat4 &model_matrix) const;
+
+  std::size_t getInstanceCount() const;
+  std::size_t getLayerCount() const;
+  std::size_t getBatchCount() const;
+  std::size_t getBufferBytes() const;
+
+private:
+  struct Batch {
+    Mesh *DrawMesh;
+    ShaderProgram *Shaders;
+    glm::vec4 Color;
+    std::vector<AnimatedInstance> Instances;
+    GLuint First;
+  };
+  std::vector<Batch> Batches;
+  std::vector<AnimationLayer> Layers;
+  std::map<std::string, GLuint> Chains; // raw layer bytes -> LayerFirst
+  std::size_t InstanceCount;
+  GLuint Buffers[2];
+  std::size_t BufferBytes;
+
+  void destroyBuffers();
+};
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_INSTANCING_HPP */
@@ -0,0 +1,217 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Job System
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglJobs.hpp"
+
+#include <iostream>
+
+namespace mgl {
+
+// Set on worker threads only
+static thread_local JobSystem *WorkerSystem = nullptr;
+static thread_local unsigned int WorkerIndex = 0;
+
+///////////////////////////////////////////////////////////////////// JobCounter
+
+JobCounter::JobCounter() : Pending(0) {}
+
+bool JobCounter::isDone() const {
+  return Pending.load(std::memory_order_acquire) == 0;
+}
+
+////////////////////////////////////////////////////////////////////// JobSystem
+
+JobSystem::JobSystem()
+    : JobSystem(std::max(std::thread::hardware_concurrency(), 1u) - 1) {}
+
+JobSystem::JobSystem(unsigned int workers)
+    : MainThread(std::this_thread::get_id()), Queued(0), Stopping(false) {
+  for (unsigned int i = 0; i <= workers; i++)
+    Queues.emplace_back(new Queue());
+  for (unsigned int i = 0; i < workers; i++)
+    Workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(SleepMutex);
+    Stopping = true;
+  }
+  Wake.notify_all();
+  for (std::thread &worker : Workers)
+    worker.join();
+}
+
+JobSystem &JobSystem::getInstance() {
+  static JobSystem instance;
+  return instance;
+}
+
+unsigned int JobSystem::getThreadCount() const {
+  return static_cast<unsigned int>(Workers.size()) + 1;
+}
+
+JobSystem::Queue &JobSystem::localQueue() {
+  return WorkerSystem == this ? *Queues[WorkerIndex] : *Queues.back();
+}
+
+void JobSystem::push(Queue &queue, Job &&job, JobCounter *counter) {
+  // Counted first so that a thief never takes the count below zero
+  Queued.fetch_add(1, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(queue.Mutex);
+    queue.Jobs.emplace_back(std::move(job), counter);
+  }
+  // Taking the lock orders the notification after a sleeper's check
+  { std::lock_guard<std::mutex> lock(SleepMutex); }
+  Wake.notify_one();
+}
+
+void JobSystem::run(Job job, JobCounter *counter) {
+  if (counter)
+    counter->Pending.fetch_add(1, std::memory_order_relaxed);
+  push(localQueue(), std::move(job), counter);
+}
+
+void JobSystem::runAfter(JobCounter &dependency, Job job, JobCounter *counter) {
+  if (counter)
+    counter->Pending.fetch_add(1, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(dependency.Mutex);
+    if (dependency.Pending.load(std::memory_order_acquire) > 0) {
+      dependency.Continuations.emplace_back(std::move(job), counter);
+      return;
+    }
+  }
+  push(localQueue(), std::move(job), counter);
+}
+
+void JobSystem::execute(Job &job, JobCounter *counter) {
+  std::exception_ptr error;
+  try {
+    job();
+  } catch (...) {
+    error = std::current_exception();
+  }
+  if (!counter) {
+    if (error) {
+      try {
+        std::rethrow_exception(error);
+      } catch (const std::exception &e) {
+        std::cerr << "[ERROR] Job failed: " << e.what() << std::endl;
+      } catch (...) {
+        std::cerr << "[ERROR] Job failed" << std::endl;
+      }
+    }
+    return;
+  }
+  std::vector<std::pair<Job, JobCounter *>> ready;
+  {
+    std::lock_guard<std::mutex> lock(counter->Mutex);
+    if (error && !counter->Error)
+      counter->Error = error;
+    if (counter->Pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      ready.swap(counter->Continuations);
+  }
+  for (auto &next : ready)
+    push(localQueue(), std::move(next.first), next.second);
+}
+
+bool JobSystem::runOne() {
+  std::pair<Job, JobCounter *> job;
+  bool found = false;
+  Queue &own = localQueue();
+  {
+    std::lock_guard<std::mutex> lock(own.Mutex);
+    if (!own.Jobs.empty()) {
+      job = std::move(own.Jobs.back());
+      own.Jobs.pop_back();
+      found = true;
+    }
+  }
+  // Steal the oldest job of another queue, which tends to be the largest
+  const std::size_t count = Queues.size();
+  const std::size_t start = WorkerSystem == this ? WorkerIndex + 1 : 0;
+  for (std::size_t i = 0; !found && i < count; i++) {
+    Queue &victim = *Queues[(start + i) % count];
+    if (&victim == &own)
+      continue;
+    std::lock_guard<std::mutex> lock(victim.Mutex);
+    if (!victim.Jobs.empty()) {
+      job = std::move(victim.Jobs.front());
+      victim.Jobs.pop_front();
+      found = true;
+    }
+  }
+  if (!found)
+    return false;
+  Queued.fetch_sub(1, std::memory_order_relaxed);
+  execute(job.first, job.second);
+  return true;
+}
+
+void JobSystem::workerLoop(unsigned int index) {
+  WorkerSystem = this;
+  WorkerIndex = index;
+  while (!Stopping.load(std::memory_order_acquire)) {
+    if (runOne())
+      continue;
+    std::unique_lock<std::mutex> lock(SleepMutex);
+    Wake.wait(lock, [this]() {
+      return Stopping.load(std::memory_order_relaxed) ||
+             Queued.load(std::memory_order_acquire) > 0;
+    });
+  }
+}
+
+void JobSystem::wait(JobCounter &counter) {
+  const bool main = isMainThread();
+  while (!counter.isDone()) {
+    if (runOne())
+      continue;
+    // Jobs of the group may be waiting for the main thread
+    if (main)
+      runMainThreadJobs();
+    std::this_thread::yield();
+  }
+  // The last job may still hold the lock it released the counter with
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock(counter.Mutex);
+    error = counter.Error;
+    counter.Error = nullptr;
+  }
+  if (error)
+    std::rethrow_exception(error);
+}
+
+/////////////////////////////////////////////////////////////////// MAIN THREAD
+
+void JobSystem::bindMainThread() { MainThread = std::this_thread::get_id(); }
+
+bool JobSystem::isMainThread() const {
+  return std::this_thread::get_id() == MainThread;
+}
+
+void JobSystem::runOnMainThread(Job job, JobCounter *counter) {
+  if (counter)
+    counter->Pending.fetch_add(1, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(MainQueue.Mutex);
+  MainQueue.Jobs.emplace_back(std::move(job), counter);
+}
+
+void JobSystem::runMainThreadJobs() {
+  std::deque<std::pair<Job, JobCounter *>> jobs;
+  {
+    std::lock_guard<std::mutex> lock(MainQueue.Mutex);
+    jobs.swap(MainQueue.Jobs);
+  }
+  for (auto &job : jobs)
+    execute(job.first, job.second);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
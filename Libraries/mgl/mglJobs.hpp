@@ -0,0 +1,140 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Job System
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_JOBS_HPP
+#define MGL_JOBS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mgl {
+
+class JobCounter;
+class JobSystem;
+
+typedef std::function<void()> Job;
+
+///////////////////////////////////////////////////////////////////// JobCounter
+
+// Number of unfinished jobs of a group. Jobs scheduled with runAfter start
+// once the counter drops to zero. The first exception thrown by a job of the
+// group is rethrown by JobSystem::wait. A counter may be reused once done.
+class JobCounter {
+public:
+  JobCounter();
+  JobCounter(const JobCounter &) = delete;
+  JobCounter &operator=(const JobCounter &) = delete;
+
+  bool isDone() const;
+
+private:
+  friend class JobSystem;
+  std::atomic<unsigned int> Pending;
+  std::mutex Mutex;
+  std::vector<std::pair<Job, JobCounter *>> Continuations;
+  std::exception_ptr Error;
+};
+
+////////////////////////////////////////////////////////////////////// JobSystem
+
+// Work-stealing scheduler. Every worker owns a deque: it pushes and pops its
+// own jobs at the back, and idle workers steal from the front of the others.
+// Threads that are not workers share one extra deque. Waiting on a counter
+// runs other jobs meanwhile, so jobs may wait on jobs they spawn.
+//
+// Jobs that must run on the main (GL) thread are queued separately and run by
+// runMainThreadJobs, which the Engine calls once per frame.
+class JobSystem {
+public:
+  // One worker per hardware thread besides the caller.
+  JobSystem();
+  explicit JobSystem(unsigned int workers);
+  ~JobSystem();
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+  static JobSystem &getInstance();
+
+  // Workers plus the calling thread.
+  unsigned int getThreadCount() const;
+  void run(Job job, JobCounter *counter = nullptr);
+  void runAfter(JobCounter &dependency, Job job, JobCounter *counter = nullptr);
+  // Runs pending jobs until counter is done.
+  void wait(JobCounter &counter);
+
+  // Calls body(begin, end) over subranges of [first, last) of at least grain
+  // items (0 picks a grain from the thread count) and waits for all of them.
+  template <typename RangeBody>
+  void parallelFor(std::size_t first, std::size_t last, std::size_t grain,
+                   RangeBody body);
+
+  // The main thread is the one that created the system, unless rebound.
+  void bindMainThread();
+  bool isMainThread() const;
+  void runOnMainThread(Job job, JobCounter *counter = nullptr);
+  void runMainThreadJobs();
+
+private:
+  struct Queue {
+    std::mutex Mutex;
+    std::deque<std::pair<Job, JobCounter *>> Jobs;
+  };
+  std::vector<std::unique_ptr<Queue>> Queues; // workers, then external
+  std::vector<std::thread> Workers;
+  Queue MainQueue;
+  std::thread::id MainThread;
+  std::atomic<unsigned int> Queued;
+  std::atomic<bool> Stopping;
+  std::mutex SleepMutex;
+  std::condition_variable Wake;
+
+  void workerLoop(unsigned int index);
+  Queue &localQueue();
+  void push(Queue &queue, Job &&job, JobCounter *counter);
+  bool runOne();
+  void execute(Job &job, JobCounter *counter);
+};
+
+template <typename RangeBody>
+void JobSystem::parallelFor(std::size_t first, std::size_t last,
+                            std::size_t grain, RangeBody body) {
+  if (first >= last)
+    return;
+  const std::size_t count = last - first;
+  if (grain == 0)
+    grain = std::max<std::size_t>(1, count / (4 * getThreadCount()));
+  if (count <= grain || Workers.empty()) {
+    body(first, last);
+    return;
+  }
+  // The caller takes the first chunk itself and then helps with the rest
+  JobCounter counter;
+  for (std::size_t begin = first + grain; begin < last; begin += grain) {
+    const std::size_t end = std::min(last, begin + grain);
+    run([&body, begin, end]() { body(begin, end); }, &counter);
+  }
+  try {
+    body(first, first + grain);
+  } catch (...) {
+    // The other chunks still refer to body and counter
+    wait(counter);
+    throw;
+  }
+  wait(counter);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_JOBS_HPP */
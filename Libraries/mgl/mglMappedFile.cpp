@@ -0,0 +1,104 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Read-Only Memory-Mapped Files
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglMappedFile.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mgl {
+
+///////////////////////////////////////////////////////////////////// MappedFile
+
+MappedFile::~MappedFile() { release(); }
+
+void MappedFile::fail(const std::string &message) {
+  release();
+  std::cerr << "[ERROR] " << message << std::endl;
+  throw std::runtime_error(message);
+}
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &filename, bool sequential)
+    : Data(nullptr), Size(0), File(INVALID_HANDLE_VALUE), Mapping(nullptr) {
+  File = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                     OPEN_EXISTING,
+                     sequential ? FILE_FLAG_SEQUENTIAL_SCAN
+                                : FILE_FLAG_RANDOM_ACCESS,
+                     nullptr);
+  LARGE_INTEGER size;
+  if (File == INVALID_HANDLE_VALUE || !GetFileSizeEx(File, &size))
+    fail("Cannot open " + filename);
+  Size = static_cast<std::size_t>(size.QuadPart);
+  if (Size == 0)
+    return;
+  Mapping = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (Mapping)
+    Data = static_cast<const char *>(
+        MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0));
+  if (!Data)
+    fail("Cannot map " + filename);
+}
+
+void MappedFile::release() {
+  if (Data)
+    UnmapViewOfFile(Data);
+  if (Mapping)
+    CloseHandle(Mapping);
+  if (File != INVALID_HANDLE_VALUE)
+    CloseHandle(File);
+  Data = nullptr;
+  Mapping = nullptr;
+  File = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &filename, bool sequential)
+    : Data(nullptr), Size(0), File(-1) {
+  File = open(filename.c_str(), O_RDONLY);
+  struct stat info;
+  if (File < 0 || fstat(File, &info) != 0)
+    fail("Cannot open " + filename);
+  Size = static_cast<std::size_t>(info.st_size);
+  if (Size == 0)
+    return;
+  void *data = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, File, 0);
+  if (data == MAP_FAILED)
+    fail("Cannot map " + filename);
+  madvise(data, Size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+  Data = static_cast<const char *>(data);
+}
+
+void MappedFile::release() {
+  if (Data)
+    munmap(const_cast<char *>(Data), Size);
+  if (File >= 0)
+    close(File);
+  Data = nullptr;
+  File = -1;
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
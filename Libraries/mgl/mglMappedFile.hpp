@@ -0,0 +1,49 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Read-Only Memory-Mapped Files
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_MAPPED_FILE_HPP
+#define MGL_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+namespace mgl {
+
+class MappedFile;
+
+///////////////////////////////////////////////////////////////////// MappedFile
+
+// Maps a whole file read-only; pages are loaded by the OS on first access and
+// can be dropped under memory pressure. Sequential files are read ahead.
+// Empty files map to a null pointer.
+class MappedFile {
+public:
+  // Throws std::runtime_error if the file cannot be opened or mapped.
+  explicit MappedFile(const std::string &filename, bool sequential = false);
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *getData() const { return Data; }
+  std::size_t getSize() const { return Size; }
+
+private:
+  const char *Data;
+  std::size_t Size;
+#ifdef _WIN32
+  void *File, *Mapping; // HANDLEs, without pulling in windows.h
+#else
+  int File;
+#endif
+
+  void release();
+  void fail(const std::string &message);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_MAPPED_FILE_HPP */
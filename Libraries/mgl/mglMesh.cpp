@@ -8,21 +8,164 @@
 
 #include "./mglMesh.hpp"
 
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+#include "./mglBuffers.hpp"
+#include "./mglMappedFile.hpp"
+#include "./mglMeshProcessing.hpp"
+#include "./mglObjLoader.hpp"
+#include "./mglPak.hpp"
+#include "./mglStats.hpp"
+#include "./mglUploadQueue.hpp"
 
 namespace mgl {
 
-////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////// GeometryMemory
+
+GeometryMemory &GeometryMemory::operator+=(const GeometryMemory &other) {
+  CpuBytes += other.CpuBytes;
+  MappedBytes += other.MappedBytes;
+  GpuBytes += other.GpuBytes;
+  return *this;
+}
+
+GeometryMemory &GeometryMemory::operator-=(const GeometryMemory &other) {
+  CpuBytes -= other.CpuBytes;
+  MappedBytes -= other.MappedBytes;
+  GpuBytes -= other.GpuBytes;
+  return *this;
+}
+
+namespace {
+
+std::mutex TotalMemoryMutex;
+GeometryMemory TotalMemory;
+
+struct CacheHeader {
+  char Magic[4];
+  std::uint32_t Version;
+  std::uint64_t VertexCount;
+  std::uint64_t IndexCount;
+};
+
+const char CACHE_MAGIC[4] = {'M', 'G', 'L', 'G'};
+const std::uint32_t CACHE_VERSION = 1;
+
+std::mutex CacheDirectoryMutex;
+std::string CacheDirectory;
+
+std::string defaultCacheDirectory() {
+  for (const char *variable : {"TMPDIR", "TEMP", "TMP"}) {
+    const char *directory = std::getenv(variable);
+    if (directory != nullptr && *directory != '\0')
+      return directory;
+  }
+#ifdef _WIN32
+  return ".";
+#else
+  return "/tmp";
+#endif
+}
+
+// Named after the mesh file and a hash of its path, so that meshes of the
+// same name in different directories do not share a cache
+std::string defaultCacheFile(const std::string &filename) {
+  const std::size_t slash = filename.find_last_of("/\\");
+  std::ostringstream path;
+  path << Mesh::getCacheDirectory() << '/'
+       << (slash == std::string::npos ? filename : filename.substr(slash + 1))
+       << '-' << std::hex << std::hash<std::string>()(filename) << ".geom";
+  return path.str();
+}
+
+// Cooked meshes: the header, then each array at a pak-aligned offset
+struct CookedHeader {
+  char Magic[4];
+  std::uint32_t Version;
+  std::uint32_t Flags;
+  std::uint32_t Padding;
+  std::uint64_t VertexCount;
+  std::uint64_t IndexCount;
+};
+
+const char COOKED_MAGIC[4] = {'M', 'G', 'L', 'M'};
+const std::uint32_t COOKED_VERSION = 1;
+const std::uint32_t COOKED_NORMALS = 1;
+const std::uint32_t COOKED_TEXCOORDS = 2;
+const std::uint32_t COOKED_TANGENTS = 4;
+const std::uint32_t COOKED_BITANGENTS = 8;
+
+// Offsets of the arrays in a cooked mesh, 0 for those it does not have
+struct CookedLayout {
+  std::size_t Positions = 0, Normals = 0, Texcoords = 0, Tangents = 0,
+              Bitangents = 0, Indices = 0, Size = 0;
+};
+
+CookedLayout cookedLayout(const CookedHeader &header) {
+  const std::size_t vertices = static_cast<std::size_t>(header.VertexCount);
+  CookedLayout layout;
+  std::size_t offset = sizeof(CookedHeader);
+  auto place = [&](std::size_t &array, std::size_t bytes) {
+    array = alignPakOffset(offset);
+    offset = array + bytes;
+  };
+  place(layout.Positions, vertices * sizeof(glm::vec3));
+  if (header.Flags & COOKED_NORMALS)
+    place(layout.Normals, vertices * sizeof(glm::vec3));
+  if (header.Flags & COOKED_TEXCOORDS)
+    place(layout.Texcoords, vertices * sizeof(glm::vec2));
+  if (header.Flags & COOKED_TANGENTS)
+    place(layout.Tangents, vertices * sizeof(glm::vec3));
+  if (header.Flags & COOKED_BITANGENTS)
+    place(layout.Bitangents, vertices * sizeof(glm::vec3));
+  place(layout.Indices,
+        static_cast<std::size_t>(header.IndexCount) * sizeof(unsigned int));
+  layout.Size = offset;
+  return layout;
+}
+
+template <typename T> std::size_t arrayBytes(const std::vector<T> &array) {
+  return array.capacity() * sizeof(T);
+}
+
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////// Mesh
 
 Mesh::Mesh() {
   NormalsLoaded = false;
   TexcoordsLoaded = false;
   TangentsAndBitangentsLoaded = false;
   VaoId = -1;
+  Ready = false;
+  Uploading = false;
   AssimpFlags = aiProcess_Triangulate;
+  NativeObj = true;
+  NativeProcessing = true;
+  Residency = MeshResidency::Keep;
+  UploadedBytes = 0;
+  CookedBytes = 0;
 }
 
-Mesh::~Mesh() { destroyBufferObjects(); }
+Mesh::~Mesh() {
+  // The upload thread still refers to this mesh
+  if (Uploading)
+    UploadQueue::getInstance().finish();
+  destroyBufferObjects();
+  std::lock_guard<std::mutex> lock(TotalMemoryMutex);
+  TotalMemory -= Memory;
+}
 
 void Mesh::setAssimpFlags(unsigned int flags) { AssimpFlags = flags; }
 
@@ -44,12 +187,72 @@ void Mesh::calculateTangentSpace() {
 
 void Mesh::flipUVs() { AssimpFlags |= aiProcess_FlipUVs; }
 
+void Mesh::setNativeObj(bool native) { NativeObj = native; }
+
+void Mesh::setNativeProcessing(bool native) { NativeProcessing = native; }
+
+void Mesh::setResidency(MeshResidency residency) { Residency = residency; }
+
+void Mesh::setCacheFile(const std::string &filename) { CacheFile = filename; }
+
+void Mesh::setCacheDirectory(const std::string &directory) {
+  std::lock_guard<std::mutex> lock(CacheDirectoryMutex);
+  CacheDirectory = directory;
+}
+
+std::string Mesh::getCacheDirectory() {
+  std::lock_guard<std::mutex> lock(CacheDirectoryMutex);
+  if (CacheDirectory.empty())
+    CacheDirectory = defaultCacheDirectory();
+  return CacheDirectory;
+}
+
 bool Mesh::hasNormals() { return NormalsLoaded; }
 
 bool Mesh::hasTexcoords() { return TexcoordsLoaded; }
 
 bool Mesh::hasTangentsAndBitangents() { return TangentsAndBitangentsLoaded; }
 
+bool Mesh::isReady() const { return Ready; }
+
+MeshView Mesh::getView() const {
+  MeshView view;
+  if (Cache && Cache->getData()) {
+    CacheHeader header;
+    std::memcpy(&header, Cache->getData(), sizeof(header));
+    view.Positions =
+        reinterpret_cast<const glm::vec3 *>(Cache->getData() + sizeof(header));
+    view.Indices = reinterpret_cast<const unsigned int *>(
+        view.Positions + header.VertexCount);
+    view.VertexCount = static_cast<std::size_t>(header.VertexCount);
+    view.IndexCount = static_cast<std::size_t>(header.IndexCount);
+  } else {
+    const Arrays arrays = getArrays();
+    view.Positions = arrays.Positions;
+    view.Normals = arrays.Normals;
+    view.Texcoords = arrays.Texcoords;
+    view.Indices = arrays.Indices;
+    view.VertexCount = arrays.VertexCount;
+    view.IndexCount = arrays.IndexCount;
+  }
+  return view;
+}
+
+const GeometryMemory &Mesh::getMemory() const { return Memory; }
+
+GeometryMemory Mesh::getTotalMemory() {
+  std::lock_guard<std::mutex> lock(TotalMemoryMutex);
+  return TotalMemory;
+}
+
+const BoundingBox &Mesh::getBoundingBox() const { return Bounds; }
+
+const TriangleBVH &Mesh::getTriangleBVH() const { return Triangles; }
+
+bool Mesh::intersect(const Ray &ray, RayHit &hit) const {
+  return Triangles.intersect(ray, hit);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void Mesh::processMesh(const aiMesh *mesh) {
@@ -99,25 +302,40 @@ void Mesh::clear() {
 #endif
   Indices.clear();
   Meshes.clear();
+  Bounds = BoundingBox();
+  Triangles.clear();
+  Cache.reset();
+  Cooked = Arrays();
+  CookedBytes = 0;
 }
 
 void Mesh::processScene(const aiScene *scene) {
   Meshes.resize(scene->mNumMeshes);
-  unsigned int n_vertices = 0;
-  unsigned int n_indices = 0;
+  // Counted in 64 bits, as whole-mesh 32-bit indices must not wrap
+  std::uint64_t n_vertices = 0;
+  std::uint64_t n_indices = 0;
   for (unsigned int i = 0; i < Meshes.size(); i++) {
+    const std::uint64_t mesh_indices =
+        static_cast<std::uint64_t>(scene->mMeshes[i]->mNumFaces) * 3;
+    if (n_vertices + scene->mMeshes[i]->mNumVertices > UINT_MAX ||
+        n_indices + mesh_indices > UINT_MAX) {
+      std::cerr << "[ERROR] Mesh too large for 32-bit indices, stream it "
+                   "from a cluster file instead"
+                << std::endl;
+      throw std::runtime_error("Mesh too large for 32-bit indices.");
+    }
     // Assuming all mesh faces are triangles
-    Meshes[i].nIndices = scene->mMeshes[i]->mNumFaces * 3;
-    Meshes[i].baseVertex = n_vertices;
-    Meshes[i].baseIndex = n_indices;
+    Meshes[i].nIndices = static_cast<unsigned int>(mesh_indices);
+    Meshes[i].baseVertex = static_cast<unsigned int>(n_vertices);
+    Meshes[i].baseIndex = static_cast<unsigned int>(n_indices);
 
     n_vertices += scene->mMeshes[i]->mNumVertices;
-    n_indices += Meshes[i].nIndices;
+    n_indices += mesh_indices;
   }
-  Positions.reserve(n_vertices);
-  Normals.reserve(n_vertices);
-  Texcoords.reserve(n_vertices);
-  Indices.reserve(n_indices);
+  Positions.reserve(static_cast<std::size_t>(n_vertices));
+  Normals.reserve(static_cast<std::size_t>(n_vertices));
+  Texcoords.reserve(static_cast<std::size_t>(n_vertices));
+  Indices.reserve(static_cast<std::size_t>(n_indices));
 
   for (unsigned int i = 0; i < Meshes.size(); i++) {
     processMesh(scene->mMeshes[i]);
@@ -130,101 +348,510 @@ void Mesh::processScene(const aiScene *scene) {
 #endif
 }
 
-void Mesh::create(const std::string &filename) {
-  clear();
-  Assimp::Importer importer;
-  const aiScene *scene = importer.ReadFile(filename, AssimpFlags);
-  if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
-      !scene->mRootNode) {
-    std::cerr << "Error while loading:" << importer.GetErrorString()
-              << std::endl;
-    exit(EXIT_FAILURE);
+void Mesh::buildBounds() {
+  const Arrays arrays = getArrays();
+  for (std::size_t i = 0; i < arrays.VertexCount; i++) {
+    Bounds.extend(arrays.Positions[i]);
   }
+  Triangles.build(arrays.Positions, arrays.Indices, arrays.IndexCount);
+}
+
+unsigned int Mesh::nativeSteps() const {
+  return NativeProcessing ? aiProcess_JoinIdenticalVertices |
+                                aiProcess_GenSmoothNormals |
+                                aiProcess_CalcTangentSpace
+                          : 0;
+}
+
+bool Mesh::canLoadNatively(const std::string &filename,
+                           unsigned int flags) const {
+  const unsigned int native_flags =
+      aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs;
+  return NativeObj && (flags & ~native_flags) == 0 &&
+         ObjLoader::isObjFile(filename);
+}
+
+void Mesh::loadObj(const std::string &filename) {
+  ObjData data;
+  ObjLoader loader;
+  loader.setFlipUVs((AssimpFlags & aiProcess_FlipUVs) != 0);
+  loader.load(filename, data);
+
+  Positions.swap(data.Positions);
+  Normals.swap(data.Normals);
+  Texcoords.swap(data.Texcoords);
+  Indices.swap(data.Indices);
+  NormalsLoaded = !Normals.empty();
+  TexcoordsLoaded = !Texcoords.empty();
+  TangentsAndBitangentsLoaded = false;
+  MeshData mesh;
+  mesh.nIndices = static_cast<unsigned int>(Indices.size());
+  Meshes.push_back(mesh);
 
 #ifdef DEBUG
-  std::cout << "Processing [" << filename << "]" << std::endl;
+  std::cout << "Loaded [" << filename << "] natively [" << Positions.size()
+            << " vertices, " << Indices.size() / 3 << " triangles]"
+            << std::endl;
+#endif
+}
+
+void Mesh::loadCooked(const std::string &filename, const char *data,
+                      std::size_t size) {
+  CookedHeader header;
+  bool valid = size >= sizeof(header);
+  if (valid) {
+    std::memcpy(&header, data, sizeof(header));
+    valid = std::memcmp(header.Magic, COOKED_MAGIC, sizeof(header.Magic)) == 0 &&
+            header.Version == COOKED_VERSION &&
+            header.VertexCount <= size / sizeof(glm::vec3) &&
+            header.IndexCount <= size / sizeof(unsigned int) &&
+            header.IndexCount % 3 == 0 && cookedLayout(header).Size <= size;
+  }
+  const CookedLayout layout = valid ? cookedLayout(header) : CookedLayout();
+  Arrays arrays;
+  if (valid) {
+    arrays.VertexCount = static_cast<std::size_t>(header.VertexCount);
+    arrays.IndexCount = static_cast<std::size_t>(header.IndexCount);
+    arrays.Positions =
+        reinterpret_cast<const glm::vec3 *>(data + layout.Positions);
+    arrays.Indices =
+        reinterpret_cast<const unsigned int *>(data + layout.Indices);
+    valid = std::all_of(arrays.Indices, arrays.Indices + arrays.IndexCount,
+                        [&](unsigned int index) {
+                          return index < arrays.VertexCount;
+                        });
+  }
+  if (!valid) {
+    std::cerr << "[ERROR] Invalid cooked mesh: " << filename << std::endl;
+    throw std::runtime_error("Invalid cooked mesh.");
+  }
+  if (layout.Normals)
+    arrays.Normals = reinterpret_cast<const glm::vec3 *>(data + layout.Normals);
+  if (layout.Texcoords)
+    arrays.Texcoords =
+        reinterpret_cast<const glm::vec2 *>(data + layout.Texcoords);
+#ifdef CREATE_BITANGENT
+  const bool tangents = layout.Tangents && layout.Bitangents;
+#else
+  const bool tangents = layout.Tangents != 0;
 #endif
+  if (tangents) {
+    arrays.Tangents = reinterpret_cast<const glm::vec3 *>(data + layout.Tangents);
+    if (layout.Bitangents)
+      arrays.Bitangents =
+          reinterpret_cast<const glm::vec3 *>(data + layout.Bitangents);
+  }
+  Cooked = arrays;
+  CookedBytes = layout.Size;
+  NormalsLoaded = arrays.Normals != nullptr;
+  TexcoordsLoaded = arrays.Texcoords != nullptr;
+  TangentsAndBitangentsLoaded = tangents;
+  MeshData mesh;
+  mesh.nIndices = static_cast<unsigned int>(arrays.IndexCount);
+  Meshes.push_back(mesh);
 
-  processScene(scene);
-  createBufferObjects();
+#ifdef DEBUG
+  std::cout << "Loaded [" << filename << "] from the pak ["
+            << arrays.VertexCount << " vertices, " << arrays.IndexCount / 3
+            << " triangles]" << std::endl;
+#endif
 }
 
-void Mesh::createBufferObjects() {
-  GLuint boId[6];
+Mesh::Arrays Mesh::getArrays() const {
+  if (Cooked.Positions)
+    return Cooked;
+  Arrays arrays;
+  if (Positions.empty())
+    return arrays;
+  arrays.Positions = Positions.data();
+  arrays.Normals = Normals.empty() ? nullptr : Normals.data();
+  arrays.Texcoords = Texcoords.empty() ? nullptr : Texcoords.data();
+  arrays.Tangents = Tangents.empty() ? nullptr : Tangents.data();
+#ifdef CREATE_BITANGENT
+  arrays.Bitangents = Bitangents.empty() ? nullptr : Bitangents.data();
+#endif
+  arrays.Indices = Indices.data();
+  arrays.VertexCount = Positions.size();
+  arrays.IndexCount = Indices.size();
+  return arrays;
+}
 
-  glGenVertexArrays(1, &VaoId);
-  glBindVertexArray(VaoId);
-  {
-    glGenBuffers(6, boId);
+std::string Mesh::cook() const {
+  const Arrays arrays = getArrays();
+  if (!arrays.Positions) {
+    std::cerr << "[ERROR] No mesh arrays to cook" << std::endl;
+    throw std::runtime_error("No mesh arrays to cook.");
+  }
+  CookedHeader header;
+  std::memcpy(header.Magic, COOKED_MAGIC, sizeof(header.Magic));
+  header.Version = COOKED_VERSION;
+  header.Flags = (NormalsLoaded ? COOKED_NORMALS : 0) |
+                 (TexcoordsLoaded ? COOKED_TEXCOORDS : 0) |
+                 (TangentsAndBitangentsLoaded ? COOKED_TANGENTS : 0) |
+                 (TangentsAndBitangentsLoaded && arrays.Bitangents
+                      ? COOKED_BITANGENTS
+                      : 0);
+  header.Padding = 0;
+  header.VertexCount = arrays.VertexCount;
+  header.IndexCount = arrays.IndexCount;
+  const CookedLayout layout = cookedLayout(header);
+
+  std::string data(layout.Size, '\0');
+  auto put = [&](std::size_t offset, const void *array, std::size_t bytes) {
+    if (offset)
+      std::memcpy(&data[offset], array, bytes);
+  };
+  std::memcpy(&data[0], &header, sizeof(header));
+  put(layout.Positions, arrays.Positions, sizeof(glm::vec3) * arrays.VertexCount);
+  put(layout.Normals, arrays.Normals, sizeof(glm::vec3) * arrays.VertexCount);
+  put(layout.Texcoords, arrays.Texcoords, sizeof(glm::vec2) * arrays.VertexCount);
+  put(layout.Tangents, arrays.Tangents, sizeof(glm::vec3) * arrays.VertexCount);
+  put(layout.Bitangents, arrays.Bitangents,
+      sizeof(glm::vec3) * arrays.VertexCount);
+  put(layout.Indices, arrays.Indices, sizeof(unsigned int) * arrays.IndexCount);
+  return data;
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, boId[POSITION]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Positions[0]) * Positions.size(),
-                 &Positions[0], GL_STATIC_DRAW);
-    glEnableVertexAttribArray(POSITION);
-    glVertexAttribPointer(POSITION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+void Mesh::flattenMeshes() {
+  for (const MeshData &mesh : Meshes) {
+    for (unsigned int i = 0; i < mesh.nIndices; i++) {
+      Indices[mesh.baseIndex + i] += mesh.baseVertex;
+    }
+  }
+  MeshData mesh;
+  mesh.nIndices = static_cast<unsigned int>(Indices.size());
+  Meshes.assign(1, mesh);
+}
 
-    if (NormalsLoaded) {
-      glBindBuffer(GL_ARRAY_BUFFER, boId[NORMAL]);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(Normals[0]) * Normals.size(),
-                   &Normals[0], GL_STATIC_DRAW);
-      glEnableVertexAttribArray(NORMAL);
-      glVertexAttribPointer(NORMAL, 3, GL_FLOAT, GL_FALSE, 0, 0);
+void Mesh::processNatively(unsigned int steps) {
+  MeshProcessor processor;
+  if (steps & aiProcess_JoinIdenticalVertices) {
+    // Welding ignores imported tangents, so they are recomputed instead
+    if (TangentsAndBitangentsLoaded) {
+      Tangents.clear();
+#ifdef CREATE_BITANGENT
+      Bitangents.clear();
+#endif
+      TangentsAndBitangentsLoaded = false;
+      steps |= aiProcess_CalcTangentSpace;
     }
+    processor.weldVertices(Positions, Normals, Texcoords, Indices);
+  }
+  if ((steps & aiProcess_GenSmoothNormals) && !NormalsLoaded) {
+    processor.computeSmoothNormals(Positions, Indices, Normals);
+    NormalsLoaded = true;
+  }
+  if ((steps & aiProcess_CalcTangentSpace) && !TangentsAndBitangentsLoaded &&
+      NormalsLoaded && TexcoordsLoaded) {
+#ifdef CREATE_BITANGENT
+    processor.computeTangents(Positions, Normals, Texcoords, Indices, Tangents,
+                              Bitangents);
+#else
+    std::vector<glm::vec3> bitangents;
+    processor.computeTangents(Positions, Normals, Texcoords, Indices, Tangents,
+                              bitangents);
+#endif
+    TangentsAndBitangentsLoaded = true;
+  }
 
-    if (TexcoordsLoaded) {
-      glBindBuffer(GL_ARRAY_BUFFER, boId[TEXCOORD]);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(Texcoords[0]) * Texcoords.size(),
-                   &Texcoords[0], GL_STATIC_DRAW);
-      glEnableVertexAttribArray(TEXCOORD);
-      glVertexAttribPointer(TEXCOORD, 2, GL_FLOAT, GL_FALSE, 0, 0);
+#ifdef DEBUG
+  std::cout << "Processed natively [" << Positions.size() << " vertices, "
+            << Indices.size() / 3 << " triangles]" << std::endl;
+#endif
+}
+
+void Mesh::load(const std::string &filename) {
+  clear();
+  const PakView cooked = Pak::getInstance().find(filename, PakType::Mesh);
+  if (!cooked.isEmpty()) {
+    loadCooked(filename, cooked.Data, cooked.Size);
+    buildBounds();
+    return;
+  }
+  const unsigned int native_steps = AssimpFlags & nativeSteps();
+  const unsigned int import_flags = AssimpFlags & ~native_steps;
+  if (canLoadNatively(filename, import_flags)) {
+    loadObj(filename);
+  } else {
+    Assimp::Importer importer;
+    const aiScene *scene = importer.ReadFile(filename, import_flags);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
+        !scene->mRootNode) {
+      std::cerr << "Error while loading:" << importer.GetErrorString()
+                << std::endl;
+      exit(EXIT_FAILURE);
     }
 
-    if (TangentsAndBitangentsLoaded) {
-      glBindBuffer(GL_ARRAY_BUFFER, boId[TANGENT]);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(Tangents[0]) * Tangents.size(),
-                   &Tangents[0], GL_STATIC_DRAW);
-      glEnableVertexAttribArray(TANGENT);
-      glVertexAttribPointer(TANGENT, 3, GL_FLOAT, GL_FALSE, 0, 0);
+#ifdef DEBUG
+    std::cout << "Processing [" << filename << "]" << std::endl;
+#endif
 
+    processScene(scene);
+  }
+  // Picking, processing and the mesh view work on whole-mesh indices, and
+  // all submeshes draw alike
+  flattenMeshes();
+  if (native_steps) {
+    processNatively(native_steps);
+  }
+  buildBounds();
+}
+
+void Mesh::create(const std::string &filename) {
+  load(filename);
+  Ready = false;
+  Uploading = true;
+  UploadQueue::getInstance().submit(
+      [this]() {
+        uploadBuffers();
+        return UploadedBytes;
+      },
+      // The arrays are released on the render thread, which may be reading
+      // them through getView until the mesh is ready
+      [this, filename]() {
+        createVertexArray();
+        applyResidency(filename);
+        updateMemory();
+        Uploading = false;
+        Ready = true;
+      });
+}
+
+void Mesh::applyResidency(const std::string &filename) {
+  if (Cooked.Positions) {
+    // Already in the pak's mapping: nothing to free or to cache
+    if (Residency == MeshResidency::Release)
+      Cooked = Arrays();
+    return;
+  }
+  switch (Residency) {
+  case MeshResidency::Release:
+    releaseArrays();
+    break;
+  case MeshResidency::Keep:
+    break;
+  case MeshResidency::Mapped: {
+    const std::string cache =
+        CacheFile.empty() ? defaultCacheFile(filename) : CacheFile;
+    // A cache with the same contents, from an earlier run or another mesh of
+    // the same file, is mapped as it is
+    if (!mapCache(cache) || !cacheMatches()) {
+      Cache.reset();
+      if (!writeCache(cache) || !mapCache(cache)) {
+        Cache.reset();
+        std::cerr << "[WARNING] Cannot cache " << filename << " in " << cache
+                  << ", keeping its arrays" << std::endl;
+        break;
+      }
+    }
+    releaseArrays();
+    break;
+  }
+  }
+}
+
+// Written next to the cache and renamed over it, so that meshes still mapping
+// the old file keep their pages
+bool Mesh::writeCache(const std::string &filename) const {
+  std::ostringstream temporary;
+  temporary << filename << '.' << std::hex
+            << std::hash<const void *>()(this) << ".tmp";
+  std::ofstream file(temporary.str(), std::ios::binary | std::ios::trunc);
+  CacheHeader header;
+  std::memcpy(header.Magic, CACHE_MAGIC, sizeof(header.Magic));
+  header.Version = CACHE_VERSION;
+  header.VertexCount = Positions.size();
+  header.IndexCount = Indices.size();
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(Positions.data()),
+             sizeof(Positions[0]) * Positions.size());
+  file.write(reinterpret_cast<const char *>(Indices.data()),
+             sizeof(Indices[0]) * Indices.size());
+  file.close();
+  if (!file) {
+    std::remove(temporary.str().c_str());
+    return false;
+  }
+  // Windows does not rename over an existing file
+  if (std::rename(temporary.str().c_str(), filename.c_str()) != 0 &&
+      (std::remove(filename.c_str()) != 0 ||
+       std::rename(temporary.str().c_str(), filename.c_str()) != 0)) {
+    std::remove(temporary.str().c_str());
+    return false;
+  }
+  return true;
+}
+
+bool Mesh::mapCache(const std::string &filename) {
+  if (!std::ifstream(filename))
+    return false;
+  try {
+    Cache.reset(new MappedFile(filename));
+  } catch (const std::runtime_error &) {
+    return false;
+  }
+  CacheHeader header;
+  bool valid = Cache->getSize() >= sizeof(header);
+  if (valid) {
+    std::memcpy(&header, Cache->getData(), sizeof(header));
+    valid = std::memcmp(header.Magic, CACHE_MAGIC, sizeof(header.Magic)) == 0 &&
+            header.Version == CACHE_VERSION &&
+            Cache->getSize() == sizeof(header) +
+                                    header.VertexCount * sizeof(glm::vec3) +
+                                    header.IndexCount * sizeof(unsigned int);
+  }
+  if (!valid)
+    Cache.reset();
+  return valid;
+}
+
+bool Mesh::cacheMatches() const {
+  const char *data = Cache->getData() + sizeof(CacheHeader);
+  const std::size_t positions = sizeof(Positions[0]) * Positions.size();
+  return Cache->getSize() ==
+             sizeof(CacheHeader) + positions +
+                 sizeof(Indices[0]) * Indices.size() &&
+         std::memcmp(data, Positions.data(), positions) == 0 &&
+         std::memcmp(data + positions, Indices.data(),
+                     sizeof(Indices[0]) * Indices.size()) == 0;
+}
+
+void Mesh::releaseArrays() {
+  std::vector<glm::vec3>().swap(Positions);
+  std::vector<glm::vec3>().swap(Normals);
+  std::vector<glm::vec2>().swap(Texcoords);
+  std::vector<glm::vec3>().swap(Tangents);
 #ifdef CREATE_BITANGENT
-      glBindBuffer(GL_ARRAY_BUFFER, boId[BITANGENT]);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(Bitangents[0]) * Bitangents.size(),
-                   &Bitangents[0], GL_STATIC_DRAW);
-      glEnableVertexAttribArray(BITANGENT);
-      glVertexAttribPointer(BITANGENT, 3, GL_FLOAT, GL_FALSE, 0, 0);
+  std::vector<glm::vec3>().swap(Bitangents);
 #endif
-    }
+  std::vector<unsigned int>().swap(Indices);
+}
+
+void Mesh::updateMemory() {
+  GeometryMemory memory;
+  memory.CpuBytes = arrayBytes(Positions) + arrayBytes(Normals) +
+                    arrayBytes(Texcoords) + arrayBytes(Tangents) +
+#ifdef CREATE_BITANGENT
+                    arrayBytes(Bitangents) +
+#endif
+                    arrayBytes(Indices) + Triangles.getMemoryUsage();
+  memory.MappedBytes = (Cache ? Cache->getSize() : 0) +
+                       (Cooked.Positions ? CookedBytes : 0);
+  memory.GpuBytes = UploadedBytes;
+  std::lock_guard<std::mutex> lock(TotalMemoryMutex);
+  TotalMemory -= Memory;
+  TotalMemory += memory;
+  Memory = memory;
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boId[INDEX]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices[0]) * Indices.size(),
-                 &Indices[0], GL_STATIC_DRAW);
+void Mesh::uploadBuffers() {
+  const Arrays arrays = getArrays();
+  const std::size_t vertex_bytes = sizeof(glm::vec3) * arrays.VertexCount;
+  std::fill(BufferIds, BufferIds + 6, 0);
+  BufferIds[POSITION] =
+      createBuffer(vertex_bytes, arrays.Positions, BufferUsage::Static);
+  UploadedBytes = vertex_bytes;
+
+  if (NormalsLoaded) {
+    BufferIds[NORMAL] =
+        createBuffer(vertex_bytes, arrays.Normals, BufferUsage::Static);
+    UploadedBytes += vertex_bytes;
   }
-  glBindVertexArray(0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glDeleteBuffers(6, boId);
+
+  if (TexcoordsLoaded) {
+    const std::size_t texcoord_bytes = sizeof(glm::vec2) * arrays.VertexCount;
+    BufferIds[TEXCOORD] =
+        createBuffer(texcoord_bytes, arrays.Texcoords, BufferUsage::Static);
+    UploadedBytes += texcoord_bytes;
+  }
+
+  if (TangentsAndBitangentsLoaded) {
+    BufferIds[TANGENT] =
+        createBuffer(vertex_bytes, arrays.Tangents, BufferUsage::Static);
+    UploadedBytes += vertex_bytes;
+
+#ifdef CREATE_BITANGENT
+    BufferIds[BITANGENT] =
+        createBuffer(vertex_bytes, arrays.Bitangents, BufferUsage::Static);
+    UploadedBytes += vertex_bytes;
+#endif
+  }
+
+  // Not attached to a vertex array yet: those are not shared between contexts
+  const std::size_t index_bytes = sizeof(unsigned int) * arrays.IndexCount;
+  BufferIds[INDEX] =
+      createBuffer(index_bytes, arrays.Indices, BufferUsage::Static);
+  UploadedBytes += index_bytes;
 }
 
-void Mesh::destroyBufferObjects() {
-  glBindVertexArray(VaoId);
-  glDisableVertexAttribArray(POSITION);
-  glDisableVertexAttribArray(NORMAL);
-  glDisableVertexAttribArray(TEXCOORD);
-  glDisableVertexAttribArray(TANGENT);
+void Mesh::createVertexArray() {
+  VaoId = mgl::createVertexArray();
+  setVertexAttribute(VaoId, POSITION, 3, BufferIds[POSITION], 0,
+                     sizeof(glm::vec3));
+  if (NormalsLoaded) {
+    setVertexAttribute(VaoId, NORMAL, 3, BufferIds[NORMAL], 0,
+                       sizeof(glm::vec3));
+  }
+  if (TexcoordsLoaded) {
+    setVertexAttribute(VaoId, TEXCOORD, 2, BufferIds[TEXCOORD], 0,
+                       sizeof(glm::vec2));
+  }
+  if (TangentsAndBitangentsLoaded) {
+    setVertexAttribute(VaoId, TANGENT, 3, BufferIds[TANGENT], 0,
+                       sizeof(glm::vec3));
 #ifdef CREATE_BITANGENT
-  glDisableVertexAttribArray(BITANGENT);
+    setVertexAttribute(VaoId, BITANGENT, 3, BufferIds[BITANGENT], 0,
+                       sizeof(glm::vec3));
 #endif
+  }
+  setIndexBuffer(VaoId, BufferIds[INDEX]);
+  // The vertex array keeps the buffers alive
+  glDeleteBuffers(6, BufferIds);
+
+  // Meshes created mid-run show up in that frame's upload traffic
+  currentFrameStats().BufferBytes += UploadedBytes;
+}
+
+void Mesh::destroyBufferObjects() {
+  if (!Ready)
+    return;
   glDeleteVertexArrays(1, &VaoId);
-  glBindVertexArray(0);
+  UploadedBytes = 0;
 }
 
 void Mesh::draw() {
+  if (!Ready)
+    return;
+  FrameStats &stats = currentFrameStats();
   glBindVertexArray(VaoId);
+  stats.VaoBinds++;
   for (MeshData &mesh : Meshes) {
     glDrawElementsBaseVertex(
         GL_TRIANGLES, mesh.nIndices, GL_UNSIGNED_INT,
         reinterpret_cast<void *>((sizeof(unsigned int) * mesh.baseIndex)),
         mesh.baseVertex);
     // GLenum mode, GLsizei count, GLenum type, void *indices, GLint basevertex
+    stats.DrawCalls++;
+    stats.Triangles += mesh.nIndices / 3;
+    stats.Vertices += mesh.nIndices;
+  }
+  glBindVertexArray(0);
+}
+
+void Mesh::drawInstanced(GLsizei instances) {
+  if (!Ready)
+    return;
+  FrameStats &stats = currentFrameStats();
+  glBindVertexArray(VaoId);
+  stats.VaoBinds++;
+  for (MeshData &mesh : Meshes) {
+    glDrawElementsInstancedBaseVertex(
+        GL_TRIANGLES, mesh.nIndices, GL_UNSIGNED_INT,
+        reinterpret_cast<void *>((sizeof(unsigned int) * mesh.baseIndex)),
+        instances, mesh.baseVertex);
+    stats.DrawCalls++;
+    stats.Triangles += static_cast<unsigned long long>(mesh.nIndices / 3) * instances;
+    stats.Vertices += static_cast<unsigned long long>(mesh.nIndices) * instances;
   }
   glBindVertexArray(0);
 }
@@ -14,17 +14,62 @@
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 #include <glm/glm.hpp>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "./mglBVH.hpp"
+#include "./mglBounds.hpp"
 #include "./mglScenegraph.hpp"
 
 namespace mgl {
 
+enum class MeshResidency;
+struct MeshView;
+struct GeometryMemory;
+class MappedFile;
 class Mesh;
 
 #define CREATE_BITANGENT
 
+////////////////////////////////////////////////////////////////// MeshResidency
+
+// What stays in CPU memory once a mesh is on the GPU. Picking works in every
+// case, as the triangle BVH keeps its own copy. Meshes loaded from a Pak stay
+// in its mapping, so Mapped writes no cache for them. Mapped keeps the arrays
+// if the cache cannot be written.
+enum class MeshResidency {
+  Release, // free the vertex and index arrays after upload
+  Keep,    // keep every array, e.g. for physics or re-uploading
+  Mapped   // keep positions and indices in a memory-mapped cache file
+};
+
+/////////////////////////////////////////////////////////////////////// MeshView
+
+// Read-only positions and whole-mesh triangle indices; empty once released.
+// Normals and texture coordinates are only there while the arrays are kept.
+struct MeshView {
+  const glm::vec3 *Positions = nullptr;
+  const glm::vec3 *Normals = nullptr;
+  const glm::vec2 *Texcoords = nullptr;
+  const unsigned int *Indices = nullptr;
+  std::size_t VertexCount = 0;
+  std::size_t IndexCount = 0;
+
+  bool isEmpty() const { return Positions == nullptr; }
+};
+
+///////////////////////////////////////////////////////////////// GeometryMemory
+
+struct GeometryMemory {
+  std::size_t CpuBytes = 0;    // heap: vertex arrays and the triangle BVH
+  std::size_t MappedBytes = 0; // file-backed pages the OS can drop
+  std::size_t GpuBytes = 0;    // vertex and index buffers
+
+  GeometryMemory &operator+=(const GeometryMemory &other);
+  GeometryMemory &operator-=(const GeometryMemory &other);
+};
+
 /////////////////////////////////////////////////////////////////////////// Mesh
 
 class Mesh : public IDrawable {
@@ -54,18 +99,74 @@ public:
   void generateTexcoords();
   void calculateTangentSpace();
   void flipUVs();
-
+  // OBJ files skip Assimp unless a flag needs it, e.g. normal generation.
+  void setNativeObj(bool native);
+  // Welding, smooth normals and tangents run in mgl instead of Assimp.
+  void setNativeProcessing(bool native);
+  void setResidency(MeshResidency residency);
+  // Where MeshResidency::Mapped writes its cache; by default a file named
+  // after the mesh file in the cache directory.
+  void setCacheFile(const std::string &filename);
+  // Shared by all meshes; the temp directory (TMPDIR, TEMP or TMP) by default.
+  static void setCacheDirectory(const std::string &directory);
+  static std::string getCacheDirectory();
+
+  // Reads and processes the arrays, without GL calls. If the mounted Pak has
+  // the mesh cooked under filename, its arrays are used in place instead and
+  // the processing flags do not apply.
+  void load(const std::string &filename);
+  // Loads and uploads. While the UploadQueue runs, create makes no GL calls
+  // and the buffers are uploaded on its thread; the mesh is not drawn until
+  // isReady.
   void create(const std::string &filename);
+  // The loaded arrays as a PakType::Mesh entry. Call after load, or on a mesh
+  // that keeps its arrays.
+  std::string cook() const;
   void draw() override;
+  void drawInstanced(GLsizei instances);
 
   bool hasNormals();
   bool hasTexcoords();
   bool hasTangentsAndBitangents();
+  bool isReady() const;
+  // The view and memory are only complete once the mesh is ready.
+  MeshView getView() const;
+  const GeometryMemory &getMemory() const;
+  // Sum over all live meshes.
+  static GeometryMemory getTotalMemory();
+  const BoundingBox &getBoundingBox() const;
+  const TriangleBVH &getTriangleBVH() const;
+  // Closest triangle hit in model space, nearer than hit.Distance.
+  bool intersect(const Ray &ray, RayHit &hit) const;
 
 private:
   GLuint VaoId;
+  GLuint BufferIds[6];
+  bool Ready, Uploading;
   unsigned int AssimpFlags;
+  bool NativeObj, NativeProcessing;
+  MeshResidency Residency;
+  std::string CacheFile;
+  std::unique_ptr<MappedFile> Cache;
+  std::size_t UploadedBytes;
+  GeometryMemory Memory;
   bool NormalsLoaded, TexcoordsLoaded, TangentsAndBitangentsLoaded;
+  BoundingBox Bounds;
+  TriangleBVH Triangles;
+
+  // Arrays of the mesh: its own vectors, or those cooked into the pak
+  struct Arrays {
+    const glm::vec3 *Positions = nullptr;
+    const glm::vec3 *Normals = nullptr;
+    const glm::vec2 *Texcoords = nullptr;
+    const glm::vec3 *Tangents = nullptr;
+    const glm::vec3 *Bitangents = nullptr;
+    const unsigned int *Indices = nullptr;
+    std::size_t VertexCount = 0;
+    std::size_t IndexCount = 0;
+  };
+  Arrays Cooked;
+  std::size_t CookedBytes;
 
   struct MeshData {
     unsigned int nIndices = 0;
@@ -86,8 +187,24 @@ private:
   void clear();
   void processScene(const aiScene *scene);
   void processMesh(const aiMesh *mesh);
-  void createBufferObjects();
+  unsigned int nativeSteps() const;
+  bool canLoadNatively(const std::string &filename, unsigned int flags) const;
+  void loadObj(const std::string &filename);
+  void loadCooked(const std::string &filename, const char *data,
+                  std::size_t size);
+  Arrays getArrays() const;
+  void flattenMeshes();
+  void processNatively(unsigned int steps);
+  void buildBounds();
+  void uploadBuffers();
+  void createVertexArray();
   void destroyBufferObjects();
+  void applyResidency(const std::string &filename);
+  bool writeCache(const std::string &filename) const;
+  bool mapCache(const std::string &filename);
+  bool cacheMatches() const;
+  void releaseArrays();
+  void updateMemory();
 };
 
 ////////////////////////////////////////////////////////////////////////////////
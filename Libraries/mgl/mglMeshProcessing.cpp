@@ -0,0 +1,380 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Mesh Post-Processing
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglMeshProcessing.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "./mglJobs.hpp"
+
+namespace mgl {
+
+namespace {
+
+struct CellEntry {
+  std::uint64_t Key;
+  unsigned int Vertex;
+};
+
+std::uint64_t hashCell(std::uint64_t x, std::uint64_t y, std::uint64_t z) {
+  std::uint64_t h = x * 0x9E3779B97F4A7C15ull;
+  h ^= y * 0xC2B2AE3D27D4EB4Full + (h >> 31);
+  h ^= z * 0x165667B19E3779F9ull + (h >> 29);
+  return h ^ (h >> 32);
+}
+
+std::uint64_t exactKey(const glm::vec3 &position) {
+  std::uint32_t bits[3];
+  // Adding zero turns -0 into +0, which compares equal to it
+  const glm::vec3 p = position + glm::vec3(0.0f);
+  std::memcpy(bits, &p[0], sizeof(bits));
+  return hashCell(bits[0], bits[1], bits[2]);
+}
+
+glm::i64vec3 cellOf(const glm::vec3 &position, float cell) {
+  const glm::vec3 scaled = glm::clamp(position / cell, -1e15f, 1e15f);
+  return glm::i64vec3(glm::floor(scaled));
+}
+
+std::uint64_t cellKey(const glm::i64vec3 &cell) {
+  return hashCell(static_cast<std::uint64_t>(cell.x),
+                  static_cast<std::uint64_t>(cell.y),
+                  static_cast<std::uint64_t>(cell.z));
+}
+
+// Angles of a triangle at its three corners
+glm::vec3 cornerAngles(const glm::vec3 &p0, const glm::vec3 &p1,
+                       const glm::vec3 &p2) {
+  auto angle = [](const glm::vec3 &a, const glm::vec3 &b) {
+    return std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b));
+  };
+  return glm::vec3(angle(p1 - p0, p2 - p0), angle(p2 - p1, p0 - p1),
+                   angle(p0 - p2, p1 - p2));
+}
+
+// Lists the corners of every group in corner order, as offsets into corners
+void groupCorners(std::size_t groups, const std::vector<unsigned int> &keys,
+                  std::vector<unsigned int> &offsets,
+                  std::vector<unsigned int> &corners) {
+  offsets.assign(groups + 1, 0);
+  for (unsigned int key : keys)
+    offsets[key + 1]++;
+  for (std::size_t i = 0; i < groups; i++)
+    offsets[i + 1] += offsets[i];
+  std::vector<unsigned int> next(offsets.begin(), offsets.end() - 1);
+  corners.resize(keys.size());
+  for (std::size_t corner = 0; corner < keys.size(); corner++)
+    corners[next[keys[corner]]++] = static_cast<unsigned int>(corner);
+}
+
+glm::vec3 anyPerpendicular(const glm::vec3 &normal) {
+  const glm::vec3 axis = std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f)
+                                                  : glm::vec3(0.0f, 1.0f, 0.0f);
+  return glm::normalize(glm::cross(normal, axis));
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////// MeshProcessor
+
+MeshProcessor::MeshProcessor() : MeshProcessor(JobSystem::getInstance()) {}
+
+MeshProcessor::MeshProcessor(JobSystem &jobs)
+    : Jobs(jobs), Epsilon(0.0f), Weighting(NormalWeighting::Angle) {}
+
+void MeshProcessor::setEpsilon(float epsilon) {
+  Epsilon = std::max(epsilon, 0.0f);
+}
+
+void MeshProcessor::setNormalWeighting(NormalWeighting weighting) {
+  Weighting = weighting;
+}
+
+// The representative of a vertex is the lowest-indexed vertex it matches,
+// directly or through others
+template <typename Compatible>
+void MeshProcessor::findRepresentatives(
+    const std::vector<glm::vec3> &positions, Compatible compatible,
+    std::vector<unsigned int> &representatives) const {
+  const std::size_t n = positions.size();
+  const float epsilon = Epsilon, cell = 2.0f * Epsilon;
+  std::vector<std::uint64_t> keys(n);
+  Jobs.parallelFor(0, n, 0, [&](std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; i++) {
+      keys[i] = epsilon > 0.0f ? cellKey(cellOf(positions[i], cell))
+                               : exactKey(positions[i]);
+    }
+  });
+
+  // Counting sort into hash buckets; a bucket lists its vertices in order
+  std::size_t buckets = 16;
+  while (buckets < n)
+    buckets *= 2;
+  const std::size_t mask = buckets - 1;
+  std::vector<unsigned int> offsets(buckets + 1, 0);
+  for (std::uint64_t key : keys)
+    offsets[(key & mask) + 1]++;
+  for (std::size_t b = 0; b < buckets; b++)
+    offsets[b + 1] += offsets[b];
+  std::vector<CellEntry> entries(n);
+  {
+    std::vector<unsigned int> next(offsets.begin(), offsets.end() - 1);
+    for (std::size_t i = 0; i < n; i++)
+      entries[next[keys[i] & mask]++] = {keys[i], static_cast<unsigned int>(i)};
+  }
+
+  // Walking the vertices in bucket order keeps their own bucket in cache
+  representatives.resize(n);
+  Jobs.parallelFor(0, n, 0, [&](std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; i++) {
+      const unsigned int vertex = entries[i].Vertex;
+      const glm::vec3 &position = positions[vertex];
+      unsigned int best = vertex;
+      auto scan = [&](std::uint64_t key) {
+        // Stop at the best vertex so far, as the bucket is in vertex order
+        const unsigned int end = offsets[(key & mask) + 1];
+        for (unsigned int e = offsets[key & mask];
+             e < end && entries[e].Vertex < best; e++) {
+          const unsigned int other = entries[e].Vertex;
+          if (entries[e].Key != key)
+            continue;
+          const bool close =
+              epsilon > 0.0f
+                  ? glm::all(glm::lessThanEqual(
+                        glm::abs(positions[other] - position),
+                        glm::vec3(epsilon)))
+                  : positions[other] == position;
+          if (close && compatible(other, vertex))
+            best = other;
+        }
+      };
+      if (epsilon == 0.0f) {
+        scan(entries[i].Key);
+      } else {
+        // Cells are twice epsilon wide, so a match is in this cell or in the
+        // neighbour on the nearer side along each axis
+        const glm::i64vec3 home = cellOf(position, cell);
+        const glm::vec3 offset = position / cell - glm::vec3(home);
+        const glm::i64vec3 side(offset.x < 0.5f ? -1 : 1,
+                                offset.y < 0.5f ? -1 : 1,
+                                offset.z < 0.5f ? -1 : 1);
+        for (int corner = 0; corner < 8; corner++) {
+          const glm::i64vec3 neighbour(home.x + ((corner & 1) ? side.x : 0),
+                                       home.y + ((corner & 2) ? side.y : 0),
+                                       home.z + ((corner & 4) ? side.z : 0));
+          scan(cellKey(neighbour));
+        }
+      }
+      representatives[vertex] = best;
+    }
+  });
+  // Representatives have lower indices, so they are final by the time they
+  // are looked up
+  for (std::size_t i = 0; i < n; i++)
+    representatives[i] = representatives[representatives[i]];
+}
+
+std::size_t
+MeshProcessor::weldVertices(std::vector<glm::vec3> &positions,
+                            std::vector<glm::vec3> &normals,
+                            std::vector<glm::vec2> &texcoords,
+                            std::vector<unsigned int> &indices) const {
+  std::vector<unsigned int> representatives;
+  findRepresentatives(
+      positions,
+      [&](unsigned int a, unsigned int b) {
+        return (normals.empty() || normals[a] == normals[b]) &&
+               (texcoords.empty() || texcoords[a] == texcoords[b]);
+      },
+      representatives);
+
+  // Kept vertices move down in order, so the arrays compact in place
+  std::vector<unsigned int> remap(positions.size());
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < positions.size(); i++) {
+    if (representatives[i] != i) {
+      remap[i] = remap[representatives[i]];
+      continue;
+    }
+    remap[i] = static_cast<unsigned int>(kept);
+    positions[kept] = positions[i];
+    if (!normals.empty())
+      normals[kept] = normals[i];
+    if (!texcoords.empty())
+      texcoords[kept] = texcoords[i];
+    kept++;
+  }
+  positions.resize(kept);
+  if (!normals.empty())
+    normals.resize(kept);
+  if (!texcoords.empty())
+    texcoords.resize(kept);
+  Jobs.parallelFor(0, indices.size(), 0,
+                   [&](std::size_t first, std::size_t last) {
+                     for (std::size_t i = first; i < last; i++)
+                       indices[i] = remap[indices[i]];
+                   });
+  return kept;
+}
+
+void MeshProcessor::computeSmoothNormals(
+    const std::vector<glm::vec3> &positions,
+    const std::vector<unsigned int> &indices,
+    std::vector<glm::vec3> &normals) const {
+  std::vector<unsigned int> representatives;
+  findRepresentatives(
+      positions, [](unsigned int, unsigned int) { return true; },
+      representatives);
+
+  // What every corner adds to the normal of its position
+  const std::size_t triangles = indices.size() / 3;
+  std::vector<glm::vec3> contributions(triangles * 3);
+  std::vector<unsigned int> keys(triangles * 3);
+  Jobs.parallelFor(0, triangles, 0, [&](std::size_t first, std::size_t last) {
+    for (std::size_t t = first; t < last; t++) {
+      const glm::vec3 &p0 = positions[indices[3 * t]],
+                      &p1 = positions[indices[3 * t + 1]],
+                      &p2 = positions[indices[3 * t + 2]];
+      const glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+      const float length = glm::length(cross);
+      const glm::vec3 unit = length > 0.0f ? cross / length : glm::vec3(0.0f);
+      const glm::vec3 angles = cornerAngles(p0, p1, p2);
+      for (int k = 0; k < 3; k++) {
+        const std::size_t corner = 3 * t + k;
+        keys[corner] = representatives[indices[corner]];
+        switch (Weighting) {
+        case NormalWeighting::Angle:
+          contributions[corner] = angles[k] * unit;
+          break;
+        case NormalWeighting::Area:
+          contributions[corner] = 0.5f * cross;
+          break;
+        case NormalWeighting::AngleAndArea:
+          contributions[corner] = angles[k] * 0.5f * cross;
+          break;
+        }
+      }
+    }
+  });
+  std::vector<unsigned int> offsets, corners;
+  groupCorners(positions.size(), keys, offsets, corners);
+
+  normals.assign(positions.size(), glm::vec3(0.0f));
+  Jobs.parallelFor(0, positions.size(), 0,
+                   [&](std::size_t first, std::size_t last) {
+                     for (std::size_t v = first; v < last; v++) {
+                       glm::vec3 sum(0.0f);
+                       for (unsigned int i = offsets[v]; i < offsets[v + 1]; i++)
+                         sum += contributions[corners[i]];
+                       const float length = glm::length(sum);
+                       if (length > 0.0f)
+                         normals[v] = sum / length;
+                     }
+                   });
+  Jobs.parallelFor(0, positions.size(), 0,
+                   [&](std::size_t first, std::size_t last) {
+                     for (std::size_t v = first; v < last; v++)
+                       if (representatives[v] != v)
+                         normals[v] = normals[representatives[v]];
+                   });
+}
+
+void MeshProcessor::computeTangents(const std::vector<glm::vec3> &positions,
+                                    const std::vector<glm::vec3> &normals,
+                                    const std::vector<glm::vec2> &texcoords,
+                                    const std::vector<unsigned int> &indices,
+                                    std::vector<glm::vec3> &tangents,
+                                    std::vector<glm::vec3> &bitangents) const {
+  if (normals.size() != positions.size() ||
+      texcoords.size() != positions.size()) {
+    std::cerr << "[ERROR] Tangents need a normal and a texcoord per vertex"
+              << std::endl;
+    throw std::runtime_error("Tangent space without normals or texcoords.");
+  }
+
+  // Tangent and bitangent of every triangle in UV space, and corner angles
+  const std::size_t triangles = indices.size() / 3;
+  std::vector<glm::vec3> faceTangents(triangles), faceBitangents(triangles);
+  std::vector<float> angles(triangles * 3);
+  Jobs.parallelFor(0, triangles, 0, [&](std::size_t first, std::size_t last) {
+    for (std::size_t t = first; t < last; t++) {
+      const unsigned int i0 = indices[3 * t], i1 = indices[3 * t + 1],
+                         i2 = indices[3 * t + 2];
+      const glm::vec3 e1 = positions[i1] - positions[i0],
+                      e2 = positions[i2] - positions[i0];
+      const glm::vec2 d1 = texcoords[i1] - texcoords[i0],
+                      d2 = texcoords[i2] - texcoords[i0];
+      const float determinant = d1.x * d2.y - d2.x * d1.y;
+      if (std::abs(determinant) > 1e-20f) {
+        faceTangents[t] = (e1 * d2.y - e2 * d1.y) / determinant;
+        faceBitangents[t] = (e2 * d1.x - e1 * d2.x) / determinant;
+      } else {
+        faceTangents[t] = faceBitangents[t] = glm::vec3(0.0f);
+      }
+      const glm::vec3 corner_angles =
+          cornerAngles(positions[i0], positions[i1], positions[i2]);
+      for (int k = 0; k < 3; k++)
+        angles[3 * t + k] = corner_angles[k];
+    }
+  });
+  // Vertices that a weld would merge share one frame
+  std::vector<unsigned int> representatives;
+  findRepresentatives(
+      positions,
+      [&](unsigned int a, unsigned int b) {
+        return normals[a] == normals[b] && texcoords[a] == texcoords[b];
+      },
+      representatives);
+  std::vector<unsigned int> keys(indices.size());
+  for (std::size_t corner = 0; corner < indices.size(); corner++)
+    keys[corner] = representatives[indices[corner]];
+  std::vector<unsigned int> offsets, corners;
+  groupCorners(positions.size(), keys, offsets, corners);
+
+  tangents.resize(positions.size());
+  bitangents.resize(positions.size());
+  Jobs.parallelFor(0, positions.size(), 0, [&](std::size_t first,
+                                               std::size_t last) {
+    for (std::size_t v = first; v < last; v++) {
+      if (representatives[v] != v)
+        continue;
+      const glm::vec3 &normal = normals[v];
+      glm::vec3 tangent(0.0f), bitangent(0.0f);
+      for (unsigned int i = offsets[v]; i < offsets[v + 1]; i++) {
+        const unsigned int corner = corners[i];
+        const glm::vec3 &face = faceTangents[corner / 3];
+        const glm::vec3 projected = face - normal * glm::dot(normal, face);
+        const float length = glm::length(projected);
+        if (length > 0.0f)
+          tangent += angles[corner] * projected / length;
+        bitangent += angles[corner] * faceBitangents[corner / 3];
+      }
+      tangent -= normal * glm::dot(normal, tangent);
+      const float length = glm::length(tangent);
+      tangent = length > 1e-12f ? tangent / length : anyPerpendicular(normal);
+      const glm::vec3 across = glm::cross(normal, tangent);
+      tangents[v] = tangent;
+      bitangents[v] = glm::dot(across, bitangent) < 0.0f ? -across : across;
+    }
+  });
+  Jobs.parallelFor(0, positions.size(), 0,
+                   [&](std::size_t first, std::size_t last) {
+                     for (std::size_t v = first; v < last; v++) {
+                       if (representatives[v] != v) {
+                         tangents[v] = tangents[representatives[v]];
+                         bitangents[v] = bitangents[representatives[v]];
+                       }
+                     }
+                   });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
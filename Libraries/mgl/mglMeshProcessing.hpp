@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Mesh Post-Processing
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_MESH_PROCESSING_HPP
+#define MGL_MESH_PROCESSING_HPP
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace mgl {
+
+class JobSystem;
+enum class NormalWeighting;
+class MeshProcessor;
+
+//////////////////////////////////////////////////////////////// NormalWeighting
+
+// How much each triangle contributes to the smooth normal of its corners.
+enum class NormalWeighting {
+  Angle, // by the corner's angle, independent of tessellation
+  Area,  // by the triangle's area
+  AngleAndArea
+};
+
+////////////////////////////////////////////////////////////////// MeshProcessor
+
+// Native replacements for Assimp's JoinIdenticalVertices, GenSmoothNormals
+// and CalcTangentSpace steps, working on indexed triangle arrays. The heavy
+// loops run on the job system and the results do not depend on the number of
+// threads.
+//
+// Positions closer than the epsilon on every axis are treated as equal; they
+// are found with a hash grid of cells twice that size. Attribute arrays that
+// are empty are ignored.
+class MeshProcessor {
+public:
+  MeshProcessor();
+  explicit MeshProcessor(JobSystem &jobs);
+
+  void setEpsilon(float epsilon);
+  void setNormalWeighting(NormalWeighting weighting);
+
+  // Merges vertices with equal positions and identical other attributes, and
+  // returns how many vertices remain.
+  std::size_t weldVertices(std::vector<glm::vec3> &positions,
+                           std::vector<glm::vec3> &normals,
+                           std::vector<glm::vec2> &texcoords,
+                           std::vector<unsigned int> &indices) const;
+  // Vertices at the same position share their normal, as in Assimp.
+  void computeSmoothNormals(const std::vector<glm::vec3> &positions,
+                            const std::vector<unsigned int> &indices,
+                            std::vector<glm::vec3> &normals) const;
+  // Per-vertex tangent frames in the manner of MikkTSpace: triangle tangents
+  // are projected onto the vertex normal and averaged by corner angle, and
+  // the bitangent is cross(normal, tangent) with the handedness of the UVs.
+  // Vertices that only differ in position by less than the epsilon get the
+  // same frame, so unwelded meshes are smooth too.
+  void computeTangents(const std::vector<glm::vec3> &positions,
+                       const std::vector<glm::vec3> &normals,
+                       const std::vector<glm::vec2> &texcoords,
+                       const std::vector<unsigned int> &indices,
+                       std::vector<glm::vec3> &tangents,
+                       std::vector<glm::vec3> &bitangents) const;
+
+private:
+  JobSystem &Jobs;
+  float Epsilon;
+  NormalWeighting Weighting;
+
+  template <typename Compatible>
+  void findRepresentatives(const std::vector<glm::vec3> &positions,
+                           Compatible compatible,
+                           std::vector<unsigned int> &representatives) const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_MESH_PROCESSING_HPP */
@@ -0,0 +1,458 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Wavefront OBJ Loader
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglObjLoader.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "./mglJobs.hpp"
+#include "./mglMappedFile.hpp"
+
+namespace mgl {
+
+static void fail(const std::string &message) {
+  std::cerr << "[ERROR] " << message << std::endl;
+  throw std::runtime_error(message);
+}
+
+//////////////////////////////////////////////////////////////////////// ObjData
+
+void ObjData::clear() {
+  Positions.clear();
+  Normals.clear();
+  Texcoords.clear();
+  Indices.clear();
+}
+
+//////////////////////////////////////////////////////////////////////// PARSING
+
+namespace {
+
+const std::uint32_t NONE = ~0u;
+
+struct Corner {
+  std::uint32_t Position, Texcoord, Normal;
+};
+
+struct Chunk {
+  const char *Begin, *End;
+  // Counted by the first pass, then turned into the index of the chunk's first
+  std::size_t Positions = 0, Texcoords = 0, Normals = 0;
+  std::vector<Corner> Corners; // three per triangle
+};
+
+struct RawAttributes {
+  std::vector<glm::vec3> Positions, Normals;
+  std::vector<glm::vec2> Texcoords;
+};
+
+// Exact in double, so mantissa * 10^e is correctly rounded for |e| <= 22
+const double POWERS_OF_TEN[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                1e18, 1e19, 1e20, 1e21, 1e22};
+
+// The 29 low mantissa bits a double loses on the way to a normal float
+const std::uint64_t FLOAT_DROPPED_BITS = (1ull << 29) - 1;
+const std::uint64_t FLOAT_HALFWAY = 1ull << 28;
+
+inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+inline bool isSeparator(const char *p, const char *end) {
+  return p == end || isBlank(*p) || *p == '\n';
+}
+
+inline const char *skipBlanks(const char *p, const char *end) {
+  while (p < end && isBlank(*p))
+    p++;
+  return p;
+}
+
+// memchr is vectorised by every C library we build against
+inline const char *findLineEnd(const char *p, const char *end) {
+  const void *newline = std::memchr(p, '\n', end - p);
+  return newline ? static_cast<const char *>(newline) : end;
+}
+
+// Long mantissas, huge exponents, inf and nan
+const char *parseFloatSlow(const char *p, const char *end, float &value) {
+  char token[64];
+  std::size_t length = 0;
+  while (p + length < end && !isSeparator(p + length, end) &&
+         length < sizeof(token) - 1) {
+    token[length] = p[length];
+    length++;
+  }
+  token[length] = '\0';
+  char *parsed = nullptr;
+  const float result = std::strtof(token, &parsed);
+  if (parsed == token || static_cast<std::size_t>(parsed - token) != length)
+    return nullptr;
+  value = result;
+  return p + length;
+}
+
+const char *parseFloat(const char *p, const char *end, float &value) {
+  p = skipBlanks(p, end);
+  const char *start = p;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  std::uint64_t mantissa = 0;
+  int digits = 0, exponent = 0;
+  bool any = false;
+  for (; p < end && isDigit(*p); p++) {
+    any = true;
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      digits += mantissa != 0;
+    } else {
+      exponent++;
+    }
+  }
+  if (p < end && *p == '.') {
+    for (p++; p < end && isDigit(*p); p++) {
+      any = true;
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        digits += mantissa != 0;
+        exponent--;
+      }
+    }
+  }
+  if (!any)
+    return parseFloatSlow(start, end, value);
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char *q = p + 1;
+    bool negative_exponent = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+      negative_exponent = *q == '-';
+      q++;
+    }
+    if (q < end && isDigit(*q)) {
+      int e = 0;
+      for (; q < end && isDigit(*q); q++)
+        e = std::min(e * 10 + (*q - '0'), 100000);
+      exponent += negative_exponent ? -e : e;
+      p = q;
+    }
+  }
+  if (!isSeparator(p, end))
+    return nullptr;
+  if (mantissa >= (1ull << 53) || exponent < -22 || exponent > 22)
+    return parseFloatSlow(start, end, value);
+  const double magnitude =
+      exponent < 0 ? static_cast<double>(mantissa) / POWERS_OF_TEN[-exponent]
+                   : static_cast<double>(mantissa) * POWERS_OF_TEN[exponent];
+  // Rounding to double and then to float only differs from rounding straight
+  // to float when the double lands halfway between two floats. The magnitude
+  // is within the normal float range here, so that is a bit pattern check.
+  std::uint64_t bits;
+  std::memcpy(&bits, &magnitude, sizeof(bits));
+  if ((bits & FLOAT_DROPPED_BITS) == FLOAT_HALFWAY)
+    return parseFloatSlow(start, end, value);
+  value = static_cast<float>(negative ? -magnitude : magnitude);
+  return p;
+}
+
+// 1-based, or negative relative to the count so far; NONE if out of range
+const char *parseIndex(const char *p, const char *end, std::size_t count,
+                       std::size_t total, std::uint32_t &index) {
+  bool negative = false;
+  if (p < end && *p == '-') {
+    negative = true;
+    p++;
+  }
+  if (p == end || !isDigit(*p))
+    return nullptr;
+  std::size_t value = 0;
+  for (; p < end && isDigit(*p); p++)
+    value = std::min<std::size_t>(value * 10 + (*p - '0'), total + 1);
+  std::size_t resolved;
+  if (negative)
+    resolved = value >= 1 && value <= count ? count - value : total;
+  else
+    resolved = value - 1; // 0 wraps around and fails below
+  index = resolved < total ? static_cast<std::uint32_t>(resolved) : NONE;
+  return p;
+}
+
+inline bool isAttribute(const char *p, const char *end, char kind) {
+  return end - p > 2 && p[0] == 'v' && p[1] == kind && isBlank(p[2]);
+}
+
+void countChunk(Chunk &chunk) {
+  for (const char *line = chunk.Begin; line < chunk.End;) {
+    const char *end = findLineEnd(line, chunk.End);
+    const char *p = skipBlanks(line, end);
+    if (end - p > 1 && p[0] == 'v') {
+      if (isBlank(p[1]))
+        chunk.Positions++;
+      else if (isAttribute(p, end, 't'))
+        chunk.Texcoords++;
+      else if (isAttribute(p, end, 'n'))
+        chunk.Normals++;
+    }
+    line = end < chunk.End ? end + 1 : end;
+  }
+}
+
+void malformed(const char *line, const char *end) {
+  fail("Malformed OBJ line: " + std::string(line, end));
+}
+
+// Writes the chunk's attributes into raw, which is already sized for all
+void parseChunk(Chunk &chunk, bool flip_uvs, RawAttributes &raw) {
+  std::size_t positions = chunk.Positions, texcoords = chunk.Texcoords,
+              normals = chunk.Normals;
+  const std::size_t total_positions = raw.Positions.size(),
+                    total_texcoords = raw.Texcoords.size(),
+                    total_normals = raw.Normals.size();
+  std::vector<Corner> polygon;
+  for (const char *line = chunk.Begin; line < chunk.End;) {
+    const char *end = findLineEnd(line, chunk.End);
+    const char *p = skipBlanks(line, end);
+    if (end - p > 1 && p[0] == 'v' && isBlank(p[1])) {
+      glm::vec3 &position = raw.Positions[positions++];
+      if (!(p = parseFloat(p + 1, end, position.x)) ||
+          !(p = parseFloat(p, end, position.y)) ||
+          !(p = parseFloat(p, end, position.z)))
+        malformed(line, end);
+    } else if (isAttribute(p, end, 't')) {
+      glm::vec2 &texcoord = raw.Texcoords[texcoords++];
+      if (!(p = parseFloat(p + 2, end, texcoord.x)))
+        malformed(line, end);
+      // The second coordinate is optional
+      if (!parseFloat(p, end, texcoord.y))
+        texcoord.y = 0.0f;
+      if (flip_uvs)
+        texcoord.y = 1.0f - texcoord.y;
+    } else if (isAttribute(p, end, 'n')) {
+      glm::vec3 &normal = raw.Normals[normals++];
+      if (!(p = parseFloat(p + 2, end, normal.x)) ||
+          !(p = parseFloat(p, end, normal.y)) ||
+          !(p = parseFloat(p, end, normal.z)))
+        malformed(line, end);
+    } else if (end - p > 1 && p[0] == 'f' && isBlank(p[1])) {
+      polygon.clear();
+      for (p = skipBlanks(p + 1, end); p < end; p = skipBlanks(p, end)) {
+        Corner corner = {NONE, NONE, NONE};
+        if (!(p = parseIndex(p, end, positions, total_positions,
+                             corner.Position)) ||
+            corner.Position == NONE)
+          malformed(line, end);
+        if (p < end && *p == '/') {
+          p++;
+          if (p < end && *p != '/' &&
+              (!(p = parseIndex(p, end, texcoords, total_texcoords,
+                                corner.Texcoord)) ||
+               corner.Texcoord == NONE))
+            malformed(line, end);
+          if (p < end && *p == '/' &&
+              (!(p = parseIndex(p + 1, end, normals, total_normals,
+                                corner.Normal)) ||
+               corner.Normal == NONE))
+            malformed(line, end);
+        }
+        if (!isSeparator(p, end))
+          malformed(line, end);
+        polygon.push_back(corner);
+      }
+      if (polygon.size() < 3)
+        malformed(line, end);
+      for (std::size_t i = 1; i + 1 < polygon.size(); i++) {
+        chunk.Corners.push_back(polygon[0]);
+        chunk.Corners.push_back(polygon[i]);
+        chunk.Corners.push_back(polygon[i + 1]);
+      }
+    }
+    line = end < chunk.End ? end + 1 : end;
+  }
+}
+
+// Open addressing from (position, texcoord, normal) to the vertex index
+class VertexTable {
+public:
+  explicit VertexTable(std::size_t expected) : Count(0) {
+    std::size_t capacity = 16;
+    while (capacity < 2 * expected)
+      capacity *= 2;
+    Entries.assign(capacity, Entry());
+  }
+
+  // Returns the index of the vertex, or NONE after inserting it as `next`
+  std::uint32_t findOrInsert(const Corner &key, std::uint32_t next) {
+    if (2 * (Count + 1) > Entries.size())
+      grow();
+    Entry *entry = find(key);
+    if (entry->Vertex != NONE)
+      return entry->Vertex;
+    entry->Key = key;
+    entry->Vertex = next;
+    Count++;
+    return NONE;
+  }
+
+private:
+  struct Entry {
+    Corner Key = {NONE, NONE, NONE};
+    std::uint32_t Vertex = NONE;
+  };
+  std::vector<Entry> Entries;
+  std::size_t Count;
+
+  static std::size_t hash(const Corner &key) {
+    std::uint64_t h = key.Position * 0x9E3779B97F4A7C15ull;
+    h ^= key.Texcoord * 0xC2B2AE3D27D4EB4Full;
+    h ^= key.Normal * 0x165667B19E3779F9ull;
+    h ^= h >> 29;
+    return static_cast<std::size_t>(h);
+  }
+
+  Entry *find(const Corner &key) {
+    const std::size_t mask = Entries.size() - 1;
+    for (std::size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+      Entry &entry = Entries[i];
+      if (entry.Vertex == NONE ||
+          (entry.Key.Position == key.Position &&
+           entry.Key.Texcoord == key.Texcoord &&
+           entry.Key.Normal == key.Normal))
+        return &entry;
+    }
+  }
+
+  void grow() {
+    std::vector<Entry> old(Entries.size() * 2);
+    old.swap(Entries);
+    for (const Entry &entry : old)
+      if (entry.Vertex != NONE)
+        *find(entry.Key) = entry;
+  }
+};
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////// ObjLoader
+
+ObjLoader::ObjLoader() : ObjLoader(JobSystem::getInstance()) {}
+
+ObjLoader::ObjLoader(JobSystem &jobs)
+    : Jobs(jobs), FlipUVs(false), ChunkSize(DEFAULT_CHUNK_SIZE) {}
+
+bool ObjLoader::isObjFile(const std::string &filename) {
+  const std::size_t dot = filename.find_last_of('.');
+  if (dot == std::string::npos)
+    return false;
+  std::string extension = filename.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return extension == "obj";
+}
+
+void ObjLoader::setFlipUVs(bool flip) { FlipUVs = flip; }
+
+void ObjLoader::setChunkSize(std::size_t bytes) {
+  ChunkSize = std::max<std::size_t>(bytes, 1);
+}
+
+void ObjLoader::load(const std::string &filename, ObjData &data) const {
+  MappedFile file(filename, true);
+  parse(file.getData(), file.getSize(), data);
+}
+
+void ObjLoader::parse(const char *text, std::size_t size, ObjData &data) const {
+  data.clear();
+  const char *end = text + size;
+
+  // Chunks end after a newline, so no line is split between two of them
+  const std::size_t count = std::max<std::size_t>(
+      1, std::min<std::size_t>(size / ChunkSize, 4 * Jobs.getThreadCount()));
+  std::vector<Chunk> chunks(count);
+  const char *begin = text;
+  for (std::size_t i = 0; i < count; i++) {
+    const char *split = i + 1 == count ? end : text + size / count * (i + 1);
+    split = std::max(split, begin);
+    if (split < end) {
+      const char *newline = findLineEnd(split, end);
+      split = newline < end ? newline + 1 : end;
+    }
+    chunks[i].Begin = begin;
+    chunks[i].End = split;
+    begin = split;
+  }
+
+  // Counting first lets every chunk write its attributes in place and resolve
+  // relative indices on its own
+  Jobs.parallelFor(0, count, 1, [&](std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; i++)
+      countChunk(chunks[i]);
+  });
+  RawAttributes raw;
+  std::size_t positions = 0, texcoords = 0, normals = 0;
+  for (Chunk &chunk : chunks) {
+    std::swap(positions, chunk.Positions);
+    std::swap(texcoords, chunk.Texcoords);
+    std::swap(normals, chunk.Normals);
+    positions += chunk.Positions;
+    texcoords += chunk.Texcoords;
+    normals += chunk.Normals;
+  }
+  raw.Positions.resize(positions);
+  raw.Texcoords.resize(texcoords);
+  raw.Normals.resize(normals);
+  Jobs.parallelFor(0, count, 1, [&](std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; i++)
+      parseChunk(chunks[i], FlipUVs, raw);
+  });
+
+  // Joining vertices in file order keeps the result independent of chunking
+  std::size_t corners = 0;
+  bool has_texcoords = false, has_normals = false;
+  for (const Chunk &chunk : chunks) {
+    corners += chunk.Corners.size();
+    for (const Corner &corner : chunk.Corners) {
+      has_texcoords |= corner.Texcoord != NONE;
+      has_normals |= corner.Normal != NONE;
+    }
+  }
+  data.Indices.reserve(corners);
+  data.Positions.reserve(positions);
+  VertexTable vertices(positions);
+  for (Chunk &chunk : chunks) {
+    for (const Corner &corner : chunk.Corners) {
+      const std::uint32_t next = static_cast<std::uint32_t>(data.Positions.size());
+      const std::uint32_t vertex = vertices.findOrInsert(corner, next);
+      if (vertex != NONE) {
+        data.Indices.push_back(vertex);
+        continue;
+      }
+      data.Indices.push_back(next);
+      data.Positions.push_back(raw.Positions[corner.Position]);
+      if (has_texcoords)
+        data.Texcoords.push_back(corner.Texcoord != NONE
+                                     ? raw.Texcoords[corner.Texcoord]
+                                     : glm::vec2(0.0f));
+      if (has_normals)
+        data.Normals.push_back(corner.Normal != NONE
+                                   ? raw.Normals[corner.Normal]
+                                   : glm::vec3(0.0f));
+    }
+    std::vector<Corner>().swap(chunk.Corners);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
@@ -0,0 +1,69 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Wavefront OBJ Loader
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_OBJ_LOADER_HPP
+#define MGL_OBJ_LOADER_HPP
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace mgl {
+
+class JobSystem;
+struct ObjData;
+class ObjLoader;
+
+//////////////////////////////////////////////////////////////////////// ObjData
+
+// One indexed triangle mesh. Normals and Texcoords are empty unless some face
+// refers to them; corners that do not are zero.
+struct ObjData {
+  std::vector<glm::vec3> Positions;
+  std::vector<glm::vec3> Normals;
+  std::vector<glm::vec2> Texcoords;
+  std::vector<unsigned int> Indices;
+
+  void clear();
+};
+
+////////////////////////////////////////////////////////////////////// ObjLoader
+
+// Reads the geometry of an OBJ file without Assimp: v, vt, vn and f lines,
+// with negative (relative) indices and polygons split into triangle fans.
+// Corners with the same position, texcoord and normal indices share a
+// vertex. Objects, groups and materials are ignored, so everything ends up
+// in one mesh.
+//
+// The file is memory-mapped; files above the chunk size are parsed in
+// parallel chunks on the job system.
+class ObjLoader {
+public:
+  static const std::size_t DEFAULT_CHUNK_SIZE = 1 << 20;
+
+  ObjLoader();
+  explicit ObjLoader(JobSystem &jobs);
+
+  static bool isObjFile(const std::string &filename);
+  void setFlipUVs(bool flip);
+  // Smallest number of bytes worth a chunk of its own.
+  void setChunkSize(std::size_t bytes);
+
+  // Throws std::runtime_error if the file cannot be read or is malformed.
+  void load(const std::string &filename, ObjData &data) const;
+  void parse(const char *text, std::size_t size, ObjData &data) const;
+
+private:
+  JobSystem &Jobs;
+  bool FlipUVs;
+  std::size_t ChunkSize;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_OBJ_LOADER_HPP */
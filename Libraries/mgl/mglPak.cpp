@@ -0,0 +1,269 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Cooked Asset Paks
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglPak.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "./mglMappedFile.hpp"
+
+namespace mgl {
+
+namespace {
+
+const char FILE_MAGIC[4] = {'M', 'G', 'L', 'P'};
+const std::uint32_t FILE_VERSION = 1;
+
+struct FileHeader {
+  char Magic[4];
+  std::uint32_t Version;
+  std::uint32_t EntryCount;
+  std::uint32_t Padding;
+  std::uint64_t TableOffset;
+  std::uint64_t NamesOffset;
+  std::uint64_t NamesSize;
+  std::uint64_t FileSize;
+};
+
+void fail(const std::string &message) {
+  std::cerr << "[ERROR] " << message << std::endl;
+  throw std::runtime_error(message);
+}
+
+} // namespace
+
+std::size_t alignPakOffset(std::size_t offset) {
+  return (offset + PAK_ALIGNMENT - 1) / PAK_ALIGNMENT * PAK_ALIGNMENT;
+}
+
+//////////////////////////////////////////////////////////////////////////// Pak
+
+// Table of contents entry, as stored in the file
+struct Pak::Entry {
+  std::uint64_t Offset;
+  std::uint64_t Size;
+  std::uint32_t Type;
+  std::uint32_t NameOffset;
+  std::uint32_t NameLength;
+  std::uint32_t Padding;
+};
+
+Pak::Pak()
+    : Entries(nullptr), EntryCount(0), Names(nullptr), NamesSize(0) {}
+
+Pak::~Pak() {}
+
+Pak &Pak::getInstance() {
+  static Pak pak;
+  return pak;
+}
+
+void Pak::open(const std::string &filename) {
+  close();
+  std::unique_ptr<MappedFile> file(new MappedFile(filename));
+  const std::uint64_t size = file->getSize();
+  FileHeader header;
+  bool valid = size >= sizeof(header);
+  if (valid) {
+    std::memcpy(&header, file->getData(), sizeof(header));
+    valid = std::memcmp(header.Magic, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0 &&
+            header.Version == FILE_VERSION && header.FileSize == size &&
+            header.TableOffset % PAK_ALIGNMENT == 0 &&
+            header.TableOffset <= size &&
+            header.EntryCount <=
+                (size - header.TableOffset) / sizeof(Entry) &&
+            header.NamesOffset <= size &&
+            header.NamesSize <= size - header.NamesOffset;
+  }
+  if (!valid)
+    fail("Not a pak file of version " + std::to_string(FILE_VERSION) + ": " +
+         filename);
+
+  const Entry *entries =
+      reinterpret_cast<const Entry *>(file->getData() + header.TableOffset);
+  for (std::uint32_t i = 0; i < header.EntryCount; i++) {
+    const Entry &entry = entries[i];
+    if (entry.Offset > size || entry.Size > size - entry.Offset ||
+        entry.NameOffset > header.NamesSize ||
+        entry.NameLength > header.NamesSize - entry.NameOffset) {
+      fail("Corrupt pak table of contents: " + filename);
+    }
+  }
+
+  File = std::move(file);
+  Filename = filename;
+  Entries = entries;
+  EntryCount = header.EntryCount;
+  Names = File->getData() + header.NamesOffset;
+  NamesSize = static_cast<std::size_t>(header.NamesSize);
+}
+
+void Pak::close() {
+  File.reset();
+  Filename.clear();
+  Entries = nullptr;
+  EntryCount = 0;
+  Names = nullptr;
+  NamesSize = 0;
+}
+
+bool Pak::isOpen() const { return File != nullptr; }
+
+const std::string &Pak::getFilename() const { return Filename; }
+
+std::size_t Pak::getEntryCount() const { return EntryCount; }
+
+std::size_t Pak::getSize() const { return File ? File->getSize() : 0; }
+
+PakView Pak::find(const std::string &name, PakType type) const {
+  PakView view;
+  if (!File)
+    return view;
+  const std::string key = normalizeName(name);
+  const std::uint32_t key_type = static_cast<std::uint32_t>(type);
+  // Entries are sorted by name, then type
+  const Entry *last = Entries + EntryCount;
+  const Entry *entry = std::lower_bound(
+      Entries, last, key, [&](const Entry &e, const std::string &k) {
+        const int order = k.compare(0, std::string::npos, Names + e.NameOffset,
+                                    e.NameLength);
+        return order > 0 || (order == 0 && e.Type < key_type);
+      });
+  if (entry != last && entry->Type == key_type &&
+      key.compare(0, std::string::npos, Names + entry->NameOffset,
+                  entry->NameLength) == 0) {
+    view.Data = File->getData() + entry->Offset;
+    view.Size = static_cast<std::size_t>(entry->Size);
+  }
+  return view;
+}
+
+std::string Pak::normalizeName(const std::string &name) {
+  std::vector<std::string> segments;
+  std::string segment;
+  for (std::size_t i = 0; i <= name.size(); i++) {
+    const char c = i < name.size() ? name[i] : '/';
+    if (c != '/' && c != '\\') {
+      segment += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+      continue;
+    }
+    if (segment == ".." && !segments.empty() && segments.back() != "..") {
+      segments.pop_back();
+    } else if (!segment.empty() && segment != ".") {
+      segments.push_back(segment);
+    }
+    segment.clear();
+  }
+  std::string normalized;
+  for (const std::string &s : segments) {
+    if (!normalized.empty())
+      normalized += '/';
+    normalized += s;
+  }
+  return normalized;
+}
+
+////////////////////////////////////////////////////////////////////// PakWriter
+
+void PakWriter::add(const std::string &name, PakType type, std::string data) {
+  const std::string normalized = Pak::normalizeName(name);
+  for (Entry &entry : Entries) {
+    if (entry.Name == normalized && entry.Type == type) {
+      entry.Data = std::move(data);
+      return;
+    }
+  }
+  Entry entry;
+  entry.Name = normalized;
+  entry.Type = type;
+  entry.Data = std::move(data);
+  Entries.push_back(std::move(entry));
+}
+
+void PakWriter::addFile(const std::string &filename, PakType type) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file)
+    fail("Cannot read " + filename);
+  std::ostringstream data;
+  data << file.rdbuf();
+  add(filename, type, data.str());
+}
+
+void PakWriter::write(const std::string &filename) const {
+  std::vector<const Entry *> sorted;
+  for (const Entry &entry : Entries)
+    sorted.push_back(&entry);
+  std::sort(sorted.begin(), sorted.end(), [](const Entry *a, const Entry *b) {
+    return a->Name != b->Name ? a->Name < b->Name : a->Type < b->Type;
+  });
+
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  if (!file)
+    fail("Cannot write " + filename);
+  const char padding[PAK_ALIGNMENT] = {};
+  std::uint64_t offset = 0;
+  auto append = [&](const void *data, std::size_t bytes) {
+    file.write(static_cast<const char *>(data),
+               static_cast<std::streamsize>(bytes));
+    offset += bytes;
+  };
+  auto align = [&]() {
+    append(padding, alignPakOffset(static_cast<std::size_t>(offset)) -
+                        static_cast<std::size_t>(offset));
+  };
+
+  FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  append(&header, sizeof(header));
+
+  std::vector<Pak::Entry> table(sorted.size());
+  std::string names;
+  for (std::size_t i = 0; i < sorted.size(); i++) {
+    align();
+    table[i].Offset = offset;
+    table[i].Size = sorted[i]->Data.size();
+    table[i].Type = static_cast<std::uint32_t>(sorted[i]->Type);
+    table[i].NameOffset = static_cast<std::uint32_t>(names.size());
+    table[i].NameLength = static_cast<std::uint32_t>(sorted[i]->Name.size());
+    table[i].Padding = 0;
+    names += sorted[i]->Name;
+    append(sorted[i]->Data.data(), sorted[i]->Data.size());
+  }
+  align();
+  std::memcpy(header.Magic, FILE_MAGIC, sizeof(header.Magic));
+  header.Version = FILE_VERSION;
+  header.EntryCount = static_cast<std::uint32_t>(table.size());
+  header.TableOffset = offset;
+  append(table.data(), sizeof(Pak::Entry) * table.size());
+  header.NamesOffset = offset;
+  header.NamesSize = names.size();
+  append(names.data(), names.size());
+  header.FileSize = offset;
+
+  file.seekp(0);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  if (!file)
+    fail("Failed to write pak: " + filename);
+}
+
+std::size_t PakWriter::getEntryCount() const { return Entries.size(); }
+
+std::size_t PakWriter::getDataSize() const {
+  std::size_t bytes = 0;
+  for (const Entry &entry : Entries)
+    bytes += entry.Data.size();
+  return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
@@ -0,0 +1,117 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Cooked Asset Paks
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_PAK_HPP
+#define MGL_PAK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mgl {
+
+enum class PakType : std::uint32_t;
+struct PakView;
+class MappedFile;
+class Pak;
+class PakWriter;
+
+// Every entry starts at a multiple of this offset, and so does every array a
+// cooked entry lays out with alignPakOffset.
+const std::size_t PAK_ALIGNMENT = 64;
+
+std::size_t alignPakOffset(std::size_t offset);
+
+//////////////////////////////////////////////////////////////////////// PakType
+
+enum class PakType : std::uint32_t {
+  Mesh = 1,   // see Mesh::cook
+  Shader = 2, // source text, #include files too
+  Scene = 3   // application defined
+};
+
+//////////////////////////////////////////////////////////////////////// PakView
+
+// Bytes of an entry inside the mapped pak; empty if there is no such entry.
+struct PakView {
+  const char *Data = nullptr;
+  std::size_t Size = 0;
+
+  bool isEmpty() const { return Data == nullptr; }
+};
+
+//////////////////////////////////////////////////////////////////////////// Pak
+
+// Memory-maps a pak written by PakWriter: a header, the entries and a table of
+// contents sorted by name. Nothing is copied on open; finding an entry is a
+// binary search of the mapped table. Entries are named after the file they
+// were cooked from, see normalizeName, so loaders look up the path they would
+// otherwise open.
+class Pak {
+public:
+  Pak();
+  ~Pak();
+  Pak(const Pak &) = delete;
+  Pak &operator=(const Pak &) = delete;
+  // The pak Mesh, ShaderProgram and the application load from when mounted.
+  static Pak &getInstance();
+
+  // Throws std::runtime_error if the file is not a pak of this version.
+  void open(const std::string &filename);
+  // Views handed out so far dangle once the pak is closed.
+  void close();
+  bool isOpen() const;
+  const std::string &getFilename() const;
+  std::size_t getEntryCount() const;
+  std::size_t getSize() const;
+
+  PakView find(const std::string &name, PakType type) const;
+  // Drops "./" and empty segments, turns '\' into '/' and lowercases, as the
+  // paths in the code and the files on disk do not always agree on case.
+  static std::string normalizeName(const std::string &name);
+
+private:
+  friend class PakWriter;
+  struct Entry;
+  std::unique_ptr<MappedFile> File;
+  std::string Filename;
+  const Entry *Entries;
+  std::size_t EntryCount;
+  const char *Names;
+  std::size_t NamesSize;
+};
+
+////////////////////////////////////////////////////////////////////// PakWriter
+
+// Collects entries in memory and writes them out as one pak.
+class PakWriter {
+public:
+  // Replaces an entry of the same name and type.
+  void add(const std::string &name, PakType type, std::string data);
+  // Adds the contents of filename under its own name; throws
+  // std::runtime_error if it cannot be read.
+  void addFile(const std::string &filename, PakType type);
+  // Throws std::runtime_error if the pak cannot be written.
+  void write(const std::string &filename) const;
+  std::size_t getEntryCount() const;
+  // Entry data, without header, table or padding.
+  std::size_t getDataSize() const;
+
+private:
+  struct Entry {
+    std::string Name;
+    PakType Type;
+    std::string Data;
+  };
+  std::vector<Entry> Entries;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_PAK_HPP */
@@ -0,0 +1,176 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Object Pools and Generational Handles
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_POOL_HPP
+#define MGL_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace mgl {
+
+template <typename T> class Handle;
+template <typename T, std::size_t ChunkSize> class Pool;
+
+///////////////////////////////////////////////////////////////////////// Handle
+
+// 32-bit reference to a pooled object: a slot index and the generation of the
+// slot when the object was created. Once the object is destroyed the slot's
+// generation moves on, so stale handles resolve to nullptr instead of to
+// whatever reuses the slot. The default handle is null.
+template <typename T> class Handle {
+public:
+  static const unsigned int INDEX_BITS = 22;
+  static const std::uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+  static const std::uint32_t MAX_GENERATION = (1u << (32 - INDEX_BITS)) - 1;
+
+  Handle() : Value(0) {}
+  std::uint32_t getIndex() const { return Value & INDEX_MASK; }
+  std::uint32_t getGeneration() const { return Value >> INDEX_BITS; }
+  std::uint32_t getValue() const { return Value; }
+  bool isNull() const { return Value == 0; }
+  bool operator==(const Handle &other) const { return Value == other.Value; }
+  bool operator!=(const Handle &other) const { return Value != other.Value; }
+
+private:
+  template <typename, std::size_t> friend class Pool;
+  std::uint32_t Value;
+
+  Handle(std::uint32_t index, std::uint32_t generation)
+      : Value((generation << INDEX_BITS) | index) {}
+};
+
+/////////////////////////////////////////////////////////////////////////// Pool
+
+// Objects live in fixed-size chunks that never move, so pointers stay valid
+// until the object is destroyed and neighbours created together sit together
+// in memory. Freed slots are reused first. Create and destroy are O(1).
+// Not thread-safe.
+template <typename T, std::size_t ChunkSize = 256> class Pool {
+public:
+  Pool() : FreeHead(NONE), Capacity(0), Count(0) {}
+  ~Pool() { clear(); }
+  Pool(const Pool &) = delete;
+  Pool &operator=(const Pool &) = delete;
+
+  template <typename... Args> Handle<T> create(Args &&...args);
+  // Returns false if the handle was already stale.
+  bool destroy(Handle<T> handle);
+  void clear();
+  // nullptr if the object was destroyed.
+  T *get(Handle<T> handle) const;
+  bool isValid(Handle<T> handle) const { return get(handle) != nullptr; }
+
+  std::size_t size() const { return Count; }
+  std::size_t getCapacity() const { return Capacity; }
+  std::size_t getChunkCount() const { return Chunks.size(); }
+  std::size_t getMemoryUsage() const { return Capacity * sizeof(Slot); }
+
+private:
+  static const std::uint32_t NONE = ~0u;
+  struct Slot {
+    alignas(T) unsigned char Storage[sizeof(T)];
+    std::uint32_t Generation = 1;
+    std::uint32_t NextFree = NONE;
+    bool Alive = false;
+  };
+  std::vector<std::unique_ptr<Slot[]>> Chunks;
+  std::uint32_t FreeHead;
+  std::uint32_t Capacity;
+  std::size_t Count;
+
+  Slot &slot(std::uint32_t index) const {
+    return Chunks[index / ChunkSize][index % ChunkSize];
+  }
+  void grow();
+};
+
+template <typename T, std::size_t ChunkSize>
+void Pool<T, ChunkSize>::grow() {
+  if (Capacity + ChunkSize > Handle<T>::INDEX_MASK) {
+    std::cerr << "[ERROR] Pool is full at " << Capacity << " objects"
+              << std::endl;
+    throw std::runtime_error("Pool capacity exceeded.");
+  }
+  Chunks.emplace_back(new Slot[ChunkSize]);
+  // Thread the new slots so that lower indices are handed out first
+  for (std::size_t i = ChunkSize; i-- > 0;) {
+    Slot &s = Chunks.back()[i];
+    s.NextFree = FreeHead;
+    FreeHead = Capacity + static_cast<std::uint32_t>(i);
+  }
+  Capacity += ChunkSize;
+}
+
+template <typename T, std::size_t ChunkSize>
+template <typename... Args>
+Handle<T> Pool<T, ChunkSize>::create(Args &&...args) {
+  if (FreeHead == NONE)
+    grow();
+  const std::uint32_t index = FreeHead;
+  Slot &s = slot(index);
+  new (s.Storage) T(std::forward<Args>(args)...);
+  FreeHead = s.NextFree;
+  s.Alive = true;
+  Count++;
+  return Handle<T>(index, s.Generation);
+}
+
+template <typename T, std::size_t ChunkSize>
+bool Pool<T, ChunkSize>::destroy(Handle<T> handle) {
+  T *object = get(handle);
+  if (!object)
+    return false;
+  Slot &s = slot(handle.getIndex());
+  object->~T();
+  s.Alive = false;
+  // Generation 0 is never issued, so the null handle never resolves
+  s.Generation =
+      s.Generation == Handle<T>::MAX_GENERATION ? 1 : s.Generation + 1;
+  s.NextFree = FreeHead;
+  FreeHead = handle.getIndex();
+  Count--;
+  return true;
+}
+
+template <typename T, std::size_t ChunkSize> void Pool<T, ChunkSize>::clear() {
+  // Chunks are kept, and generations move on so that old handles stay stale
+  FreeHead = NONE;
+  for (std::uint32_t index = Capacity; index-- > 0;) {
+    Slot &s = slot(index);
+    if (s.Alive) {
+      reinterpret_cast<T *>(s.Storage)->~T();
+      s.Alive = false;
+      s.Generation =
+          s.Generation == Handle<T>::MAX_GENERATION ? 1 : s.Generation + 1;
+    }
+    s.NextFree = FreeHead;
+    FreeHead = index;
+  }
+  Count = 0;
+}
+
+template <typename T, std::size_t ChunkSize>
+T *Pool<T, ChunkSize>::get(Handle<T> handle) const {
+  const std::uint32_t index = handle.getIndex();
+  if (index >= Capacity)
+    return nullptr;
+  Slot &s = slot(index);
+  if (!s.Alive || s.Generation != handle.getGeneration())
+    return nullptr;
+  return reinterpret_cast<T *>(s.Storage);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_POOL_HPP */
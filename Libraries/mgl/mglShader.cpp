@@ -8,16 +8,106 @@
 
 #include "./mglShader.hpp"
 
+#include <algorithm>
+#include <cctype>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 
+#include "./mglPak.hpp"
+#include "./mglStats.hpp"
+
 namespace mgl {
 
+namespace {
+
+bool hasParallelCompile() {
+  return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+}
+
+// FNV-1a
+const std::uint64_t VARIANT_KEY_BASIS = 14695981039346656037ull;
+
+void hashBytes(std::uint64_t &hash, const void *data, std::size_t size) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  for (std::size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+}
+
+void hashString(std::uint64_t &hash, const std::string &string) {
+  hashBytes(hash, string.c_str(), string.size() + 1);
+}
+
+void hashShader(std::uint64_t &hash, GLenum shader_type,
+                const std::string &filename, const ShaderDefines &defines) {
+  hashBytes(hash, &shader_type, sizeof(shader_type));
+  hashString(hash, filename);
+  const std::size_t count = defines.size();
+  hashBytes(hash, &count, sizeof(count));
+  for (auto &i : defines) {
+    hashString(hash, i.first);
+    hashString(hash, i.second);
+  }
+}
+
+// Matches #include "name", with optional blanks around the #.
+bool parseInclude(const std::string &line, std::string &name) {
+  std::size_t i = 0;
+  auto skipBlanks = [&]() {
+    while (i < line.size() && std::isblank(static_cast<unsigned char>(line[i])))
+      i++;
+  };
+  skipBlanks();
+  if (i == line.size() || line[i] != '#')
+    return false;
+  i++;
+  skipBlanks();
+  if (line.compare(i, 7, "include") != 0)
+    return false;
+  i += 7;
+  skipBlanks();
+  const std::size_t end = line.find('"', i + 1);
+  if (i == line.size() || line[i] != '"' || end == std::string::npos)
+    return false;
+  name = line.substr(i + 1, end - i - 1);
+  return true;
+}
+
+// Defines go right after #version, which must come first.
+std::string insertDefines(const std::string &code,
+                          const ShaderDefines &defines) {
+  std::string result = code;
+  std::size_t at = 0, line = 1;
+  const std::size_t version = result.find("#version");
+  if (version != std::string::npos) {
+    std::size_t end = result.find('\n', version);
+    if (end == std::string::npos) {
+      end = result.size();
+      result += '\n';
+    }
+    at = end + 1;
+    line = std::count(result.begin(), result.begin() + at, '\n') + 1;
+  }
+  std::ostringstream block;
+  for (auto &i : defines) {
+    block << "#define " << i.first << " " << i.second << "\n";
+  }
+  block << "#line " << line << " 0\n";
+  return result.insert(at, block.str());
+}
+
+} // namespace
+
 ////////////////////////////////////////////////////////////////// ShaderProgram
 
 const std::string ShaderProgram::read(const std::string &filename) {
+  const PakView cooked = Pak::getInstance().find(filename, PakType::Shader);
+  if (!cooked.isEmpty())
+    return std::string(cooked.Data, cooked.Size);
   std::string line, shader_string;
   std::ifstream ifile(filename);
   if (!ifile.is_open()) {
@@ -56,24 +146,67 @@ void ShaderProgram::checkLinkage() {
   }
 }
 
-ShaderProgram::ShaderProgram() : ProgramId(glCreateProgram()) {}
+ShaderProgram::ShaderProgram()
+    : ProgramId(glCreateProgram()), VariantKey(VARIANT_KEY_BASIS),
+      LinkStarted(false) {}
 
 ShaderProgram::~ShaderProgram() {
   glUseProgram(0);
   glDeleteProgram(ProgramId);
 }
 
+const std::string
+ShaderProgram::preprocess(const std::string &filename,
+                          std::vector<std::string> &sources) {
+  // Source string numbers in compiler messages index sources
+  const std::size_t index = sources.size();
+  sources.push_back(filename);
+  const std::string directory =
+      filename.substr(0, filename.find_last_of("/\\") + 1);
+  std::istringstream input(read(filename));
+  std::ostringstream output;
+  std::string line, name;
+  for (int number = 1; std::getline(input, line); number++) {
+    if (!parseInclude(line, name)) {
+      output << line << "\n";
+      continue;
+    }
+    const std::string path = directory + name;
+    if (std::find(sources.begin(), sources.end(), path) == sources.end()) {
+      output << "#line 1 " << sources.size() << "\n";
+      output << preprocess(path, sources);
+    }
+    output << "#line " << number + 1 << " " << index << "\n";
+  }
+  return output.str();
+}
+
+void ShaderProgram::setDefines(const ShaderDefines &defines) {
+  Defines = defines;
+}
+
 void ShaderProgram::addShader(const GLenum shader_type,
                               const std::string &filename) {
+  std::vector<std::string> sources;
+  std::string scode = preprocess(filename, sources);
+  if (!Defines.empty()) {
+    scode = insertDefines(scode, Defines);
+  }
   const GLuint shader_id = glCreateShader(shader_type);
-  const std::string scode = read(filename);
   const GLchar *code = scode.c_str();
   glShaderSource(shader_id, 1, &code, nullptr);
+  // Asking for the status here would wait for the compiler
   glCompileShader(shader_id);
-  checkCompilation(shader_id, filename);
   glAttachShader(ProgramId, shader_id);
 
   Shaders[shader_type] = {shader_id};
+  std::string files = filename;
+  for (std::size_t i = 1; i < sources.size(); i++) {
+    files += (i == 1 ? ", included " : ", ") + std::to_string(i) + ": " +
+             sources[i];
+  }
+  ShaderFiles[shader_type] = files;
+  hashShader(VariantKey, shader_type, filename, Defines);
 }
 
 void ShaderProgram::addAttribute(const std::string &name, const GLuint index) {
@@ -113,13 +246,46 @@ bool ShaderProgram::isUniformBlock(const std::string &name) {
   return Ubos.find(name) != Ubos.end();
 }
 
-void ShaderProgram::create() {
+void ShaderProgram::link() {
   glLinkProgram(ProgramId);
+  LinkStarted = true;
+}
+
+bool ShaderProgram::isCompiling() const {
+  if (!hasParallelCompile())
+    return false;
+  for (auto &i : Shaders) {
+    GLint done;
+    glGetShaderiv(i.second, GL_COMPLETION_STATUS_KHR, &done);
+    if (done == GL_FALSE)
+      return true;
+  }
+  return false;
+}
+
+bool ShaderProgram::isLinking() const {
+  if (!hasParallelCompile())
+    return false;
+  GLint done;
+  glGetProgramiv(ProgramId, GL_COMPLETION_STATUS_KHR, &done);
+  return done == GL_FALSE;
+}
+
+void ShaderProgram::create() {
+  if (!LinkStarted)
+    link();
+  LinkStarted = false;
+  // A shader that failed to compile has the more useful log
+  for (auto &i : Shaders) {
+    checkCompilation(i.second, ShaderFiles[i.first]);
+  }
   checkLinkage();
   for (auto &i : Shaders) {
     glDetachShader(ProgramId, i.second);
     glDeleteShader(i.second);
   }
+  Shaders.clear();
+  ShaderFiles.clear();
 
   for (auto &i : Uniforms) {
     i.second.index = glGetUniformLocation(ProgramId, i.first.c_str());
@@ -134,9 +300,103 @@ void ShaderProgram::create() {
   }
 }
 
-void ShaderProgram::bind() { glUseProgram(ProgramId); }
+void ShaderProgram::bind() {
+  glUseProgram(ProgramId);
+  currentFrameStats().ProgramBinds++;
+}
 
 void ShaderProgram::unbind() { glUseProgram(0); }
 
+std::uint64_t ShaderProgram::getVariantKey() const { return VariantKey; }
+
+//////////////////////////////////////////////////////////////////// ShaderBatch
+
+ShaderBatch::ShaderBatch() : Created(0), Parallel(false) {
+  setParallel(true);
+}
+
+void ShaderBatch::setParallel(bool parallel) {
+  // 0xFFFFFFFF leaves the number of threads to the driver, 0 compiles inline
+  const GLuint threads = parallel ? 0xFFFFFFFF : 0;
+  if (GLEW_KHR_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsKHR(threads);
+  } else if (GLEW_ARB_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsARB(threads);
+  }
+  Parallel = parallel && hasParallelCompile();
+}
+
+bool ShaderBatch::isParallel() const { return Parallel; }
+
+void ShaderBatch::add(ShaderProgram *program) { Pending.push_back(program); }
+
+bool ShaderBatch::poll() {
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < Pending.size(); i++) {
+    ShaderProgram *program = Pending[i];
+    if (!program->LinkStarted && !program->isCompiling())
+      program->link();
+    if (program->LinkStarted && !program->isLinking()) {
+      try {
+        program->create();
+      } catch (...) {
+        Pending.erase(Pending.begin() + kept, Pending.begin() + i + 1);
+        throw;
+      }
+      Created++;
+    } else {
+      Pending[kept++] = program;
+    }
+  }
+  Pending.resize(kept);
+  return Pending.empty();
+}
+
+void ShaderBatch::wait() {
+  while (!poll()) {
+    std::this_thread::yield();
+  }
+}
+
+std::size_t ShaderBatch::getPendingCount() const { return Pending.size(); }
+
+std::size_t ShaderBatch::getCreatedCount() const { return Created; }
+
+//////////////////////////////////////////////////////////////////// ShaderCache
+
+ShaderCache::ShaderCache() {}
+
+ShaderProgram *ShaderCache::get(const ShaderSources &sources,
+                                const ShaderDefines &defines,
+                                const Setup &setup, ShaderBatch *batch) {
+  // The same key as the program built below
+  std::uint64_t key = VARIANT_KEY_BASIS;
+  for (auto &i : sources) {
+    hashShader(key, i.first, i.second, defines);
+  }
+  auto cached = Programs.find(key);
+  if (cached != Programs.end())
+    return cached->second.get();
+
+  std::unique_ptr<ShaderProgram> program(new ShaderProgram());
+  program->setDefines(defines);
+  for (auto &i : sources) {
+    program->addShader(i.first, i.second);
+  }
+  setup(*program);
+  if (batch) {
+    batch->add(program.get());
+  } else {
+    program->create();
+  }
+  ShaderProgram *result = program.get();
+  Programs[key] = std::move(program);
+  return result;
+}
+
+std::size_t ShaderCache::size() const { return Programs.size(); }
+
+void ShaderCache::clear() { Programs.clear(); }
+
 ////////////////////////////////////////////////////////////////////////////////
 } // namespace mgl
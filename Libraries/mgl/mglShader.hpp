@@ -11,15 +11,28 @@
 
 #include <GL/glew.h>
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace mgl {
 
 class ShaderProgram;
+class ShaderBatch;
+class ShaderCache;
+
+// Feature set of a shader variant, as #define NAME VALUE.
+typedef std::map<std::string, std::string> ShaderDefines;
+typedef std::map<GLenum, std::string> ShaderSources;
 
 ////////////////////////////////////////////////////////////////// ShaderProgram
 
+// Shader files may #include "other.glsl", relative to the including file;
+// each file is included at most once. Defines are inserted after #version.
 class ShaderProgram final {
 public:
   GLuint ProgramId;
@@ -53,6 +66,10 @@ public:
   ShaderProgram(ShaderProgram &&other) noexcept;
   ShaderProgram &operator=(ShaderProgram &&other) noexcept;
 
+  // Applies to the shaders added afterwards.
+  void setDefines(const ShaderDefines &defines);
+  // Compilation errors are reported by create. The file and its #includes are
+  // read from the mounted Pak when it has them.
   void addShader(const GLenum shader_type, const std::string &filename);
   void addAttribute(const std::string &name, const GLuint index);
   bool isAttribute(const std::string &name);
@@ -60,16 +77,90 @@ public:
   bool isUniform(const std::string &name);
   void addUniformBlock(const std::string &name, const GLuint binding_point);
   bool isUniformBlock(const std::string &name);
+  // Links, unless a ShaderBatch already did, checks the shaders and the
+  // program and looks up the uniforms and blocks.
   void create();
   void bind();
   void unbind();
+  // Same for programs built from the same files and defines, e.g. to sort
+  // draws so that each variant is bound once.
+  std::uint64_t getVariantKey() const;
 
 private:
+  friend class ShaderBatch;
+  std::map<GLenum, std::string> ShaderFiles;
+  ShaderDefines Defines;
+  std::uint64_t VariantKey;
+  bool LinkStarted;
+
+  void link();
+  bool isCompiling() const;
+  bool isLinking() const;
   const std::string read(const std::string &filename);
+  const std::string preprocess(const std::string &filename,
+                               std::vector<std::string> &sources);
   void checkCompilation(const GLuint shader_id, const std::string &filename);
   void checkLinkage();
 };
 
+//////////////////////////////////////////////////////////////////// ShaderBatch
+
+// Creates many programs at once. With GL_KHR_parallel_shader_compile or
+// GL_ARB_parallel_shader_compile the driver compiles and links on threads of
+// its own: each program is linked once its shaders are compiled and created
+// once linked, as reported by GL_COMPLETION_STATUS, so nothing waits on one
+// program while others could progress. Without either extension programs are
+// created one after another.
+class ShaderBatch {
+public:
+  ShaderBatch();
+  ShaderBatch(const ShaderBatch &) = delete;
+  ShaderBatch &operator=(const ShaderBatch &) = delete;
+
+  // Lets the driver use as many compiler threads as it wants, or none.
+  void setParallel(bool parallel);
+  bool isParallel() const;
+
+  // Add programs once their shaders, attributes, uniforms and blocks are in.
+  void add(ShaderProgram *program);
+  // Creates the programs that are ready without blocking, e.g. once per
+  // frame; returns true when none are left. Throws like ShaderProgram::create.
+  bool poll();
+  // Creates every program added so far.
+  void wait();
+  std::size_t getPendingCount() const;
+  std::size_t getCreatedCount() const;
+
+private:
+  std::vector<ShaderProgram *> Pending;
+  std::size_t Created;
+  bool Parallel;
+};
+
+//////////////////////////////////////////////////////////////////// ShaderCache
+
+// One program per variant: later requests for the same sources and defines
+// get the program built by the first. Everything that makes programs differ,
+// such as the attributes a mesh has, must therefore be in the defines.
+class ShaderCache {
+public:
+  // Adds the attributes, uniforms and blocks of a new variant.
+  typedef std::function<void(ShaderProgram &)> Setup;
+
+  ShaderCache();
+  ShaderCache(const ShaderCache &) = delete;
+  ShaderCache &operator=(const ShaderCache &) = delete;
+
+  // New variants are created right away, or added to batch if given.
+  ShaderProgram *get(const ShaderSources &sources, const ShaderDefines &defines,
+                     const Setup &setup, ShaderBatch *batch = nullptr);
+  std::size_t size() const;
+  void clear();
+
+private:
+  std::map<std::uint64_t, std::unique_ptr<ShaderProgram>> Programs;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 } // namespace mgl
 
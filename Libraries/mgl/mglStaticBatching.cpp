@@ -0,0 +1,220 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Static Geometry Batching
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglStaticBatching.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "./mglBuffers.hpp"
+#include "./mglConventions.hpp"
+#include "./mglMesh.hpp"
+#include "./mglShader.hpp"
+#include "./mglStats.hpp"
+
+namespace mgl {
+
+////////////////////////////////////////////////////////////////// StaticBatches
+
+StaticBatches::StaticBatches() : Rebuilds(0) {}
+
+StaticBatches::~StaticBatches() { clear(); }
+
+GLint StaticBatches::addMember(Mesh *mesh, ShaderProgram *shaders,
+                               const glm::vec4 &color,
+                               const glm::mat4 &world) {
+  // Residency is applied when the upload is published; until then the view
+  // may still change
+  if (!mesh->isReady())
+    return NONE;
+  const MeshView view = mesh->getView();
+  if (view.isEmpty() || (mesh->hasNormals() && !view.Normals) ||
+      (mesh->hasTexcoords() && !view.Texcoords))
+    return NONE;
+
+  std::size_t batch = 0;
+  while (batch < Batches.size() && !(Batches[batch].Shaders == shaders &&
+                                     Batches[batch].Color == color)) {
+    batch++;
+  }
+  if (batch == Batches.size()) {
+    Batch created;
+    created.Shaders = shaders;
+    created.Color = color;
+    created.HasNormals = mesh->hasNormals();
+    created.HasTexcoords = mesh->hasTexcoords();
+    created.VaoId = 0;
+    created.Buffers[0] = created.Buffers[1] = 0;
+    created.Buffers[2] = created.Buffers[3] = 0;
+    created.IndexCount = 0;
+    created.BufferBytes = 0;
+    created.Dirty = true;
+    Batches.push_back(created);
+  }
+  const GLuint index = static_cast<GLuint>(Members.size());
+  Members.push_back({mesh, world, true, batch});
+  Batches[batch].Members.push_back(index);
+  Batches[batch].Dirty = true;
+  return static_cast<GLint>(index);
+}
+
+void StaticBatches::clear() {
+  for (Batch &batch : Batches) {
+    destroyBuffers(batch);
+  }
+  Batches.clear();
+  Members.clear();
+  Rebuilds = 0;
+}
+
+void StaticBatches::upload() {
+  Rebuilds = 0;
+  for (Batch &batch : Batches) {
+    build(batch);
+  }
+}
+
+void StaticBatches::update(const std::vector<StaticUpdate> &updates) {
+  if (updates.empty())
+    return;
+  for (const StaticUpdate &update : updates) {
+    Member &member = Members[update.Member];
+    if (member.World == update.World && member.Visible == update.Visible)
+      continue;
+    member.World = update.World;
+    member.Visible = update.Visible;
+    Batches[member.Batch].Dirty = true;
+  }
+  for (Batch &batch : Batches) {
+    if (batch.Dirty)
+      build(batch);
+  }
+}
+
+void StaticBatches::build(Batch &batch) {
+  destroyBuffers(batch);
+  batch.Dirty = false;
+  Rebuilds++;
+
+  std::vector<glm::vec3> positions, normals;
+  std::vector<glm::vec2> texcoords;
+  std::vector<unsigned int> indices;
+  for (GLuint index : batch.Members) {
+    const Member &member = Members[index];
+    if (!member.Visible)
+      continue;
+    const MeshView view = member.Source->getView();
+    const unsigned int base = static_cast<unsigned int>(positions.size());
+    for (std::size_t v = 0; v < view.VertexCount; v++) {
+      positions.push_back(
+          glm::vec3(member.World * glm::vec4(view.Positions[v], 1.0f)));
+    }
+    if (batch.HasNormals) {
+      if (view.Normals) {
+        normals.insert(normals.end(), view.Normals,
+                       view.Normals + view.VertexCount);
+      } else {
+        normals.resize(positions.size(), glm::vec3(0.0f));
+      }
+    }
+    if (batch.HasTexcoords) {
+      if (view.Texcoords) {
+        texcoords.insert(texcoords.end(), view.Texcoords,
+                         view.Texcoords + view.VertexCount);
+      } else {
+        texcoords.resize(positions.size(), glm::vec2(0.0f));
+      }
+    }
+    for (std::size_t i = 0; i < view.IndexCount; i++) {
+      indices.push_back(base + view.Indices[i]);
+    }
+  }
+  if (indices.empty())
+    return;
+
+  batch.Buffers[0] = createBuffer(sizeof(positions[0]) * positions.size(),
+                                  positions.data(), BufferUsage::Static);
+  batch.Buffers[3] = createBuffer(sizeof(indices[0]) * indices.size(),
+                                  indices.data(), BufferUsage::Static);
+  batch.VaoId = createVertexArray();
+  setVertexAttribute(batch.VaoId, Mesh::POSITION, 3, batch.Buffers[0], 0,
+                     sizeof(glm::vec3));
+  if (batch.HasNormals) {
+    batch.Buffers[1] = createBuffer(sizeof(normals[0]) * normals.size(),
+                                    normals.data(), BufferUsage::Static);
+    setVertexAttribute(batch.VaoId, Mesh::NORMAL, 3, batch.Buffers[1], 0,
+                       sizeof(glm::vec3));
+  }
+  if (batch.HasTexcoords) {
+    batch.Buffers[2] = createBuffer(sizeof(texcoords[0]) * texcoords.size(),
+                                    texcoords.data(), BufferUsage::Static);
+    setVertexAttribute(batch.VaoId, Mesh::TEXCOORD, 2, batch.Buffers[2], 0,
+                       sizeof(glm::vec2));
+  }
+  setIndexBuffer(batch.VaoId, batch.Buffers[3]);
+  batch.IndexCount = static_cast<GLsizei>(indices.size());
+  batch.BufferBytes = sizeof(positions[0]) * positions.size() +
+                      sizeof(normals[0]) * normals.size() +
+                      sizeof(texcoords[0]) * texcoords.size() +
+                      sizeof(indices[0]) * indices.size();
+  currentFrameStats().BufferBytes += batch.BufferBytes;
+}
+
+void StaticBatches::destroyBuffers(Batch &batch) {
+  if (batch.VaoId != 0) {
+    glDeleteVertexArrays(1, &batch.VaoId);
+    glDeleteBuffers(4, batch.Buffers);
+    batch.VaoId = 0;
+    batch.Buffers[0] = batch.Buffers[1] = 0;
+    batch.Buffers[2] = batch.Buffers[3] = 0;
+  }
+  batch.IndexCount = 0;
+  batch.BufferBytes = 0;
+}
+
+static GLint uniformIndex(const ShaderProgram *shaders, const char *name) {
+  auto i = shaders->Uniforms.find(name);
+  return i == shaders->Uniforms.end() ? -1 : i->second.index;
+}
+
+void StaticBatches::draw() const {
+  FrameStats &stats = currentFrameStats();
+  const glm::mat4 identity(1.0f);
+  for (const Batch &batch : Batches) {
+    if (batch.IndexCount == 0)
+      continue;
+    batch.Shaders->bind();
+    glUniformMatrix4fv(uniformIndex(batch.Shaders, MODEL_MATRIX), 1, GL_FALSE,
+                       glm::value_ptr(identity));
+    glUniform4fv(uniformIndex(batch.Shaders, COLOR_ATTRIBUTE), 1,
+                 glm::value_ptr(batch.Color));
+    stats.UniformUploads += 2;
+    glBindVertexArray(batch.VaoId);
+    stats.VaoBinds++;
+    glDrawElements(GL_TRIANGLES, batch.IndexCount, GL_UNSIGNED_INT, nullptr);
+    stats.DrawCalls++;
+    stats.Triangles += batch.IndexCount / 3;
+    stats.Vertices += batch.IndexCount;
+    glBindVertexArray(0);
+    batch.Shaders->unbind();
+  }
+}
+
+std::size_t StaticBatches::getMemberCount() const { return Members.size(); }
+
+std::size_t StaticBatches::getBatchCount() const { return Batches.size(); }
+
+std::size_t StaticBatches::getBufferBytes() const {
+  std::size_t bytes = 0;
+  for (const Batch &batch : Batches) {
+    bytes += batch.BufferBytes;
+  }
+  return bytes;
+}
+
+unsigned long long StaticBatches::getRebuildCount() const { return Rebuilds; }
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Static Geometry Batching
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_STATIC_BATCHING_HPP
+#define MGL_STATIC_BATCHING_HPP
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace mgl {
+
+class Mesh;
+class ShaderProgram;
+struct StaticUpdate;
+class StaticBatches;
+
+/////////////////////////////////////////////////////////////////// StaticUpdate
+
+// New state of a member, e.g. because its node moved or is highlighted.
+struct StaticUpdate {
+  GLuint Member;
+  glm::mat4 World;
+  bool Visible;
+};
+
+////////////////////////////////////////////////////////////////// StaticBatches
+
+// Meshes that do not move, pre-transformed to world space and merged into one
+// vertex and index buffer per shader and colour, so each batch is one draw
+// with an identity model matrix. Normals and texture coordinates are copied
+// as they are, since the shaders light with model-space normals. Positions
+// reach the shaders in world space, so programs that read the model-space
+// position, e.g. to colour by it, must not be batched.
+//
+// Members are built from the mesh's CPU arrays, which must stay resident
+// (MeshResidency::Keep). A batch is only rebuilt when one of its members
+// changes through update().
+class StaticBatches {
+public:
+  static const GLint NONE = -1;
+
+  StaticBatches();
+  ~StaticBatches();
+  StaticBatches(const StaticBatches &) = delete;
+  StaticBatches &operator=(const StaticBatches &) = delete;
+
+  // Returns the member's index, or NONE if the mesh is not ready or its arrays
+  // are not resident.
+  GLint addMember(Mesh *mesh, ShaderProgram *shaders, const glm::vec4 &color,
+                  const glm::mat4 &world);
+  void clear();
+  // Requires a GL context; builds every batch.
+  void upload();
+  // Rebuilds the batches of the members that changed.
+  void update(const std::vector<StaticUpdate> &updates);
+  void draw() const;
+
+  std::size_t getMemberCount() const;
+  std::size_t getBatchCount() const;
+  std::size_t getBufferBytes() const;
+  // Batches built since the last upload, including by update.
+  unsigned long long getRebuildCount() const;
+
+private:
+  struct Member {
+    Mesh *Source;
+    glm::mat4 World;
+    bool Visible;
+    std::size_t Batch;
+  };
+  struct Batch {
+    ShaderProgram *Shaders;
+    glm::vec4 Color;
+    bool HasNormals, HasTexcoords;
+    std::vector<GLuint> Members;
+    GLuint VaoId;
+    GLuint Buffers[4];
+    GLsizei IndexCount;
+    std::size_t BufferBytes;
+    bool Dirty;
+  };
+  std::vector<Member> Members;
+  std::vector<Batch> Batches;
+  unsigned long long Rebuilds;
+
+  void build(Batch &batch);
+  void destroyBuffers(Batch &batch);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_STATIC_BATCHING_HPP */
@@ -0,0 +1,169 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Render Statistics
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglStats.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace mgl {
+
+//////////////////////////////////////////////////////////////////// StatCounter
+
+const char *statCounterName(StatCounter counter) {
+  static const char *names[] = {"frame_time",      "animation_time",
+                                "upload_time",     "draw_calls",
+                                "triangles",       "vertices",
+                                "program_binds",   "vao_binds",
+                                "buffer_binds",    "uniform_uploads",
+                                "buffer_bytes",    "nodes_traversed",
+                                "nodes_culled"};
+  return names[static_cast<int>(counter)];
+}
+
+///////////////////////////////////////////////////////////////////// FrameStats
+
+double FrameStats::get(StatCounter counter) const {
+  switch (counter) {
+  case StatCounter::FrameTime:
+    return FrameTime;
+  case StatCounter::AnimationTime:
+    return AnimationTime;
+  case StatCounter::UploadTime:
+    return UploadTime;
+  case StatCounter::DrawCalls:
+    return static_cast<double>(DrawCalls);
+  case StatCounter::Triangles:
+    return static_cast<double>(Triangles);
+  case StatCounter::Vertices:
+    return static_cast<double>(Vertices);
+  case StatCounter::ProgramBinds:
+    return static_cast<double>(ProgramBinds);
+  case StatCounter::VaoBinds:
+    return static_cast<double>(VaoBinds);
+  case StatCounter::BufferBinds:
+    return static_cast<double>(BufferBinds);
+  case StatCounter::UniformUploads:
+    return static_cast<double>(UniformUploads);
+  case StatCounter::BufferBytes:
+    return static_cast<double>(BufferBytes);
+  case StatCounter::NodesTraversed:
+    return static_cast<double>(NodesTraversed);
+  case StatCounter::NodesCulled:
+    return static_cast<double>(NodesCulled);
+  default:
+    return 0.0;
+  }
+}
+
+unsigned long long FrameStats::stateChanges() const {
+  return ProgramBinds + VaoBinds + BufferBinds;
+}
+
+void FrameStats::reset() { *this = FrameStats(); }
+
+FrameStats &FrameStats::operator+=(const FrameStats &other) {
+  FrameTime += other.FrameTime;
+  AnimationTime += other.AnimationTime;
+  UploadTime += other.UploadTime;
+  DrawCalls += other.DrawCalls;
+  Triangles += other.Triangles;
+  Vertices += other.Vertices;
+  ProgramBinds += other.ProgramBinds;
+  VaoBinds += other.VaoBinds;
+  BufferBinds += other.BufferBinds;
+  UniformUploads += other.UniformUploads;
+  BufferBytes += other.BufferBytes;
+  NodesTraversed += other.NodesTraversed;
+  NodesCulled += other.NodesCulled;
+  return *this;
+}
+
+FrameStats &currentFrameStats() {
+  // Per thread, so a simulation thread can count its own work
+  static thread_local FrameStats stats;
+  return stats;
+}
+
+/////////////////////////////////////////////////////////////////// StatsHistory
+
+StatsHistory::StatsHistory() : WindowSize(120), Next(0), KeepAll(false) {}
+
+void StatsHistory::setWindow(std::size_t frames) {
+  WindowSize = std::max<std::size_t>(frames, 1);
+  Window.clear();
+  Next = 0;
+}
+
+void StatsHistory::setKeepAll(bool keep_all) { KeepAll = keep_all; }
+
+void StatsHistory::push(const FrameStats &stats) {
+  if (Window.size() < WindowSize) {
+    Window.push_back(stats);
+  } else {
+    Window[Next] = stats;
+  }
+  Next = (Next + 1) % WindowSize;
+  if (KeepAll)
+    All.push_back(stats);
+}
+
+void StatsHistory::clear() {
+  Window.clear();
+  All.clear();
+  Next = 0;
+}
+
+std::size_t StatsHistory::size() const { return Window.size(); }
+
+StatRange StatsHistory::range(StatCounter counter) const {
+  StatRange range;
+  if (Window.empty())
+    return range;
+  range.Min = range.Max = Window.front().get(counter);
+  double sum = 0.0;
+  for (const FrameStats &stats : Window) {
+    const double value = stats.get(counter);
+    range.Min = std::min(range.Min, value);
+    range.Max = std::max(range.Max, value);
+    sum += value;
+  }
+  range.Avg = sum / Window.size();
+  return range;
+}
+
+void StatsHistory::writeCsv(const std::string &filename) const {
+  std::ofstream file(filename);
+  if (!file) {
+    std::cerr << "[ERROR] Failed to open stats file: " << filename << std::endl;
+    throw std::runtime_error("Failed to open stats file.");
+  }
+  const int count = static_cast<int>(StatCounter::Count);
+  file << "frame";
+  for (int i = 0; i < count; i++) {
+    file << "," << statCounterName(static_cast<StatCounter>(i));
+  }
+  file << "\n";
+
+  // The window is a ring: its oldest frame sits at Next once it is full
+  const bool full = Window.size() == WindowSize;
+  const std::size_t rows = KeepAll ? All.size() : Window.size();
+  for (std::size_t row = 0; row < rows; row++) {
+    const FrameStats &stats =
+        KeepAll ? All[row]
+                : Window[full ? (Next + row) % WindowSize : row];
+    file << row;
+    for (int i = 0; i < count; i++) {
+      file << "," << stats.get(static_cast<StatCounter>(i));
+    }
+    file << "\n";
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Render Statistics
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_STATS_HPP
+#define MGL_STATS_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace mgl {
+
+enum class StatCounter;
+struct FrameStats;
+struct StatRange;
+class StatsHistory;
+
+//////////////////////////////////////////////////////////////////// StatCounter
+
+enum class StatCounter {
+  FrameTime,
+  AnimationTime,
+  UploadTime,
+  DrawCalls,
+  Triangles,
+  Vertices,
+  ProgramBinds,
+  VaoBinds,
+  BufferBinds,
+  UniformUploads,
+  BufferBytes,
+  NodesTraversed,
+  NodesCulled,
+  Count
+};
+
+const char *statCounterName(StatCounter counter);
+
+///////////////////////////////////////////////////////////////////// FrameStats
+
+struct FrameStats {
+  double FrameTime = 0.0;
+  double AnimationTime = 0.0;
+  double UploadTime = 0.0;
+  unsigned long long DrawCalls = 0;
+  unsigned long long Triangles = 0;
+  unsigned long long Vertices = 0;
+  unsigned long long ProgramBinds = 0;
+  unsigned long long VaoBinds = 0;
+  unsigned long long BufferBinds = 0;
+  unsigned long long UniformUploads = 0;
+  unsigned long long BufferBytes = 0;
+  unsigned long long NodesTraversed = 0;
+  unsigned long long NodesCulled = 0;
+
+  double get(StatCounter counter) const;
+  unsigned long long stateChanges() const;
+  void reset();
+  FrameStats &operator+=(const FrameStats &other);
+};
+
+// Counters of the frame being built or rendered on the calling thread, reset
+// by the Engine at the start of each frame.
+FrameStats &currentFrameStats();
+
+////////////////////////////////////////////////////////////////////// StatRange
+
+struct StatRange {
+  double Min = 0.0;
+  double Avg = 0.0;
+  double Max = 0.0;
+};
+
+/////////////////////////////////////////////////////////////////// StatsHistory
+
+// Rolling window over the most recent frames, optionally keeping every frame
+// of the run for a CSV dump.
+class StatsHistory {
+public:
+  StatsHistory();
+  void setWindow(std::size_t frames);
+  void setKeepAll(bool keep_all);
+  void push(const FrameStats &stats);
+  void clear();
+
+  std::size_t size() const;
+  StatRange range(StatCounter counter) const;
+  // One row per frame kept, or per frame in the window without setKeepAll.
+  void writeCsv(const std::string &filename) const;
+
+private:
+  std::vector<FrameStats> Window;
+  std::size_t WindowSize;
+  std::size_t Next;
+  bool KeepAll;
+  std::vector<FrameStats> All;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_STATS_HPP */
@@ -0,0 +1,464 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Out-of-Core Mesh Streaming
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglStreaming.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+#include "./mglBuffers.hpp"
+#include "./mglJobs.hpp"
+#include "./mglObjLoader.hpp"
+#include "./mglStats.hpp"
+
+namespace mgl {
+
+namespace {
+
+const std::uint32_t NONE = ~0u;
+const char FILE_MAGIC[4] = {'M', 'G', 'L', 'C'};
+const std::uint32_t FILE_VERSION = 1;
+const std::uint32_t HAS_NORMALS = 1;
+const std::uint32_t HAS_TEXCOORDS = 2;
+const int MORTON_BITS = 10;
+const int TRIANGLE_BITS = 64 - 3 * MORTON_BITS;
+
+struct FileHeader {
+  char Magic[4];
+  std::uint32_t Version;
+  std::uint32_t Flags;
+  std::uint32_t MaxVertices;
+  std::uint32_t MaxIndices;
+  std::uint32_t Padding;
+  std::uint64_t ClusterCount;
+  std::uint64_t TableOffset;
+};
+
+struct FileCluster {
+  float Min[3];
+  std::uint32_t VertexCount;
+  float Max[3];
+  std::uint32_t IndexCount;
+  std::uint64_t DataOffset;
+};
+
+void fail(const std::string &message) {
+  std::cerr << "[ERROR] " << message << std::endl;
+  throw std::runtime_error(message);
+}
+
+std::uint64_t spreadBits(std::uint64_t x) {
+  x &= 0x3ff;
+  x = (x | (x << 16)) & 0x030000ff;
+  x = (x | (x << 8)) & 0x0300f00f;
+  x = (x | (x << 4)) & 0x030c30c3;
+  x = (x | (x << 2)) & 0x09249249;
+  return x;
+}
+
+std::uint64_t mortonCode(const glm::vec3 &unit) {
+  const float scale = static_cast<float>((1 << MORTON_BITS) - 1);
+  const glm::vec3 cell = glm::clamp(unit, 0.0f, 1.0f) * scale;
+  return spreadBits(static_cast<std::uint64_t>(cell.x)) |
+         (spreadBits(static_cast<std::uint64_t>(cell.y)) << 1) |
+         (spreadBits(static_cast<std::uint64_t>(cell.z)) << 2);
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////// ClusterInfo
+
+std::uint64_t ClusterInfo::getDataSize() const {
+  return static_cast<std::uint64_t>(VertexCount) * sizeof(ClusterVertex) +
+         static_cast<std::uint64_t>(IndexCount) * sizeof(std::uint16_t);
+}
+
+///////////////////////////////////////////////////////////////// ClusterBuilder
+
+ClusterBuilder::ClusterBuilder() : ClusterBuilder(JobSystem::getInstance()) {}
+
+ClusterBuilder::ClusterBuilder(JobSystem &jobs)
+    : Jobs(jobs), MaxVertices(DEFAULT_MAX_VERTICES),
+      MaxTriangles(DEFAULT_MAX_TRIANGLES) {}
+
+void ClusterBuilder::setClusterSize(std::uint32_t max_vertices,
+                                    std::uint32_t max_triangles) {
+  MaxVertices = std::min<std::uint32_t>(std::max<std::uint32_t>(max_vertices, 3),
+                                        65536);
+  MaxTriangles = std::max<std::uint32_t>(max_triangles, 1);
+}
+
+std::size_t ClusterBuilder::build(const ObjData &data,
+                                  const std::string &filename) const {
+  const std::size_t triangles = data.Indices.size() / 3;
+  if (static_cast<std::uint64_t>(triangles) >> TRIANGLE_BITS) {
+    fail("Too many triangles to cluster in " + filename);
+  }
+  BoundingBox bounds;
+  for (const glm::vec3 &position : data.Positions)
+    bounds.extend(position);
+  const glm::vec3 extent = glm::max(bounds.size(), glm::vec3(FLT_MIN));
+
+  // Morton code of the centroid in the high bits, triangle in the low bits
+  std::vector<std::uint64_t> order(triangles);
+  Jobs.parallelFor(0, triangles, 0, [&](std::size_t first, std::size_t last) {
+    for (std::size_t t = first; t < last; t++) {
+      const glm::vec3 centroid = (data.Positions[data.Indices[3 * t]] +
+                                  data.Positions[data.Indices[3 * t + 1]] +
+                                  data.Positions[data.Indices[3 * t + 2]]) /
+                                 3.0f;
+      order[t] = (mortonCode((centroid - bounds.Min) / extent)
+                  << TRIANGLE_BITS) |
+                 t;
+    }
+  });
+  std::sort(order.begin(), order.end());
+
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  if (!file)
+    fail("Cannot write " + filename);
+  FileHeader header;
+  std::memcpy(header.Magic, FILE_MAGIC, sizeof(header.Magic));
+  header.Version = FILE_VERSION;
+  header.Flags = (data.Normals.empty() ? 0 : HAS_NORMALS) |
+                 (data.Texcoords.empty() ? 0 : HAS_TEXCOORDS);
+  header.MaxVertices = MaxVertices;
+  header.MaxIndices = 3 * MaxTriangles;
+  header.Padding = 0;
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  // Local index of each mesh vertex, valid while its stamp is the cluster's
+  std::vector<std::uint32_t> stamps(data.Positions.size(), NONE);
+  std::vector<std::uint16_t> local(data.Positions.size());
+  std::vector<ClusterVertex> vertices;
+  std::vector<std::uint16_t> indices;
+  std::vector<FileCluster> table;
+  auto flush = [&]() {
+    FileCluster cluster;
+    BoundingBox box;
+    for (const ClusterVertex &vertex : vertices)
+      box.extend(vertex.Position);
+    for (int axis = 0; axis < 3; axis++) {
+      cluster.Min[axis] = box.Min[axis];
+      cluster.Max[axis] = box.Max[axis];
+    }
+    cluster.VertexCount = static_cast<std::uint32_t>(vertices.size());
+    cluster.IndexCount = static_cast<std::uint32_t>(indices.size());
+    cluster.DataOffset = static_cast<std::uint64_t>(file.tellp());
+    file.write(reinterpret_cast<const char *>(vertices.data()),
+               sizeof(ClusterVertex) * vertices.size());
+    file.write(reinterpret_cast<const char *>(indices.data()),
+               sizeof(std::uint16_t) * indices.size());
+    table.push_back(cluster);
+    vertices.clear();
+    indices.clear();
+  };
+
+  for (std::uint64_t key : order) {
+    const std::size_t t = static_cast<std::size_t>(
+        key & ((std::uint64_t(1) << TRIANGLE_BITS) - 1));
+    const std::uint32_t cluster = static_cast<std::uint32_t>(table.size());
+    std::uint32_t added = 0;
+    for (int k = 0; k < 3; k++)
+      added += stamps[data.Indices[3 * t + k]] != cluster;
+    if (vertices.size() + added > MaxVertices ||
+        indices.size() / 3 == MaxTriangles) {
+      flush();
+    }
+    for (int k = 0; k < 3; k++) {
+      const unsigned int index = data.Indices[3 * t + k];
+      if (stamps[index] != table.size()) {
+        stamps[index] = static_cast<std::uint32_t>(table.size());
+        local[index] = static_cast<std::uint16_t>(vertices.size());
+        ClusterVertex vertex;
+        vertex.Position = data.Positions[index];
+        vertex.Normal =
+            data.Normals.empty() ? glm::vec3(0.0f) : data.Normals[index];
+        vertex.Texcoord =
+            data.Texcoords.empty() ? glm::vec2(0.0f) : data.Texcoords[index];
+        vertices.push_back(vertex);
+      }
+      indices.push_back(local[index]);
+    }
+  }
+  if (!indices.empty())
+    flush();
+
+  header.ClusterCount = table.size();
+  header.TableOffset = static_cast<std::uint64_t>(file.tellp());
+  file.write(reinterpret_cast<const char *>(table.data()),
+             sizeof(FileCluster) * table.size());
+  file.seekp(0);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  if (!file)
+    fail("Cannot write " + filename);
+  return table.size();
+}
+
+/////////////////////////////////////////////////////////////////// StreamedMesh
+
+StreamedMesh::StreamedMesh()
+    : Flags(0), MaxVertices(0), MaxIndices(0),
+      MemoryBudget(DEFAULT_MEMORY_BUDGET), StagingSize(DEFAULT_STAGING_SIZE),
+      VaoId(0), Buffers{0, 0}, Updates(0), StreamedBytes(0) {}
+
+StreamedMesh::~StreamedMesh() { close(); }
+
+void StreamedMesh::setMemoryBudget(std::uint64_t bytes) {
+  MemoryBudget = bytes;
+}
+
+void StreamedMesh::setStagingSize(std::size_t bytes) { StagingSize = bytes; }
+
+bool StreamedMesh::hasNormals() const { return (Flags & HAS_NORMALS) != 0; }
+
+bool StreamedMesh::hasTexcoords() const {
+  return (Flags & HAS_TEXCOORDS) != 0;
+}
+
+const BoundingBox &StreamedMesh::getBoundingBox() const { return Bounds; }
+
+std::size_t StreamedMesh::getClusterCount() const { return Clusters.size(); }
+
+std::size_t StreamedMesh::getSlotCount() const { return ClusterInSlot.size(); }
+
+std::size_t StreamedMesh::getResidentCount() const {
+  return ClusterInSlot.size() -
+         std::count(ClusterInSlot.begin(), ClusterInSlot.end(), NONE);
+}
+
+std::size_t StreamedMesh::getDrawnCount() const { return DrawCounts.size(); }
+
+std::uint64_t StreamedMesh::getGpuBytes() const {
+  return static_cast<std::uint64_t>(ClusterInSlot.size()) *
+         (static_cast<std::uint64_t>(MaxVertices) * sizeof(ClusterVertex) +
+          static_cast<std::uint64_t>(MaxIndices) * sizeof(std::uint16_t));
+}
+
+std::uint64_t StreamedMesh::getStreamedBytes() const { return StreamedBytes; }
+
+void StreamedMesh::close() {
+  if (VaoId) {
+    glDeleteVertexArrays(1, &VaoId);
+    glDeleteBuffers(2, Buffers);
+    VaoId = Buffers[0] = Buffers[1] = 0;
+  }
+  File.close();
+  File.clear();
+  Clusters.clear();
+  Bounds = BoundingBox();
+  std::vector<char>().swap(Staging);
+  SlotOfCluster.clear();
+  ClusterInSlot.clear();
+  SlotLastWanted.clear();
+  DrawCounts.clear();
+  DrawOffsets.clear();
+  DrawBaseVertices.clear();
+  Updates = 0;
+  StreamedBytes = 0;
+}
+
+void StreamedMesh::open(const std::string &filename) {
+  close();
+  Filename = filename;
+  File.open(filename, std::ios::binary | std::ios::ate);
+  if (!File)
+    fail("Cannot open " + filename);
+  const std::uint64_t file_size = static_cast<std::uint64_t>(File.tellg());
+  FileHeader header;
+  File.seekg(0);
+  File.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (!File || std::memcmp(header.Magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 ||
+      header.Version != FILE_VERSION || header.MaxVertices == 0 ||
+      header.MaxVertices > 65536 || header.TableOffset > file_size ||
+      header.ClusterCount >
+          (file_size - header.TableOffset) / sizeof(FileCluster)) {
+    fail("Not a cluster file: " + filename);
+  }
+  Flags = header.Flags;
+  MaxVertices = header.MaxVertices;
+  MaxIndices = header.MaxIndices;
+
+  std::vector<FileCluster> table(static_cast<std::size_t>(header.ClusterCount));
+  File.seekg(static_cast<std::streamoff>(header.TableOffset));
+  File.read(reinterpret_cast<char *>(table.data()),
+            sizeof(FileCluster) * table.size());
+  if (!File)
+    fail("Cannot read the cluster table of " + filename);
+  Clusters.resize(table.size());
+  std::uint64_t largest = 0;
+  for (std::size_t i = 0; i < table.size(); i++) {
+    ClusterInfo &cluster = Clusters[i];
+    cluster.Bounds.Min = glm::vec3(table[i].Min[0], table[i].Min[1], table[i].Min[2]);
+    cluster.Bounds.Max = glm::vec3(table[i].Max[0], table[i].Max[1], table[i].Max[2]);
+    cluster.VertexCount = table[i].VertexCount;
+    cluster.IndexCount = table[i].IndexCount;
+    cluster.DataOffset = table[i].DataOffset;
+    if (cluster.VertexCount > MaxVertices || cluster.IndexCount > MaxIndices ||
+        cluster.DataOffset + cluster.getDataSize() > header.TableOffset) {
+      fail("Corrupt cluster table in " + filename);
+    }
+    Bounds.extend(cluster.Bounds);
+    largest = std::max(largest, cluster.getDataSize());
+  }
+
+  // Slot offsets become base vertices, which are GLints
+  const std::uint64_t vertex_slot =
+      static_cast<std::uint64_t>(MaxVertices) * sizeof(ClusterVertex);
+  const std::uint64_t index_slot =
+      static_cast<std::uint64_t>(MaxIndices) * sizeof(std::uint16_t);
+  std::uint64_t slots = MemoryBudget / (vertex_slot + index_slot);
+  slots = std::min<std::uint64_t>(slots, Clusters.size());
+  slots = std::min<std::uint64_t>(slots, INT_MAX / MaxVertices);
+  slots = std::max<std::uint64_t>(slots, 1);
+  SlotOfCluster.assign(Clusters.size(), NONE);
+  ClusterInSlot.assign(static_cast<std::size_t>(slots), NONE);
+  SlotLastWanted.assign(static_cast<std::size_t>(slots), 0);
+  Staging.resize(static_cast<std::size_t>(
+      std::max<std::uint64_t>(StagingSize, largest)));
+
+  Buffers[0] = createBuffer(static_cast<GLsizeiptr>(slots * vertex_slot),
+                            nullptr, BufferUsage::Dynamic);
+  Buffers[1] = createBuffer(static_cast<GLsizeiptr>(slots * index_slot),
+                            nullptr, BufferUsage::Dynamic);
+  VaoId = createVertexArray();
+  const GLsizei stride = sizeof(ClusterVertex);
+  setVertexAttribute(VaoId, POSITION, 3, Buffers[0],
+                     offsetof(ClusterVertex, Position), stride);
+  if (hasNormals()) {
+    setVertexAttribute(VaoId, NORMAL, 3, Buffers[0],
+                       offsetof(ClusterVertex, Normal), stride);
+  }
+  if (hasTexcoords()) {
+    setVertexAttribute(VaoId, TEXCOORD, 2, Buffers[0],
+                       offsetof(ClusterVertex, Texcoord), stride);
+  }
+  setIndexBuffer(VaoId, Buffers[1]);
+
+#ifdef DEBUG
+  std::cout << "Opened [" << filename << "] with " << Clusters.size()
+            << " clusters, " << slots << " resident at most" << std::endl;
+#endif
+}
+
+std::uint32_t StreamedMesh::findSlot() const {
+  // A free slot, or else the one wanted longest ago but not in this update
+  std::uint32_t best = NONE;
+  for (std::uint32_t slot = 0; slot < ClusterInSlot.size(); slot++) {
+    if (ClusterInSlot[slot] == NONE)
+      return slot;
+    if (SlotLastWanted[slot] < Updates &&
+        (best == NONE || SlotLastWanted[slot] < SlotLastWanted[best])) {
+      best = slot;
+    }
+  }
+  return best;
+}
+
+void StreamedMesh::upload(std::uint32_t cluster, std::uint32_t slot,
+                          char *staging) {
+  const ClusterInfo &info = Clusters[cluster];
+  const std::uint64_t size = info.getDataSize();
+  File.seekg(static_cast<std::streamoff>(info.DataOffset));
+  File.read(staging, static_cast<std::streamsize>(size));
+  if (!File)
+    fail("Cannot read a cluster of " + Filename);
+
+  const std::uint64_t vertex_bytes =
+      static_cast<std::uint64_t>(info.VertexCount) * sizeof(ClusterVertex);
+  updateBuffer(Buffers[0],
+               static_cast<GLintptr>(static_cast<std::uint64_t>(slot) *
+                                     MaxVertices * sizeof(ClusterVertex)),
+               static_cast<GLsizeiptr>(vertex_bytes), staging);
+  updateBuffer(Buffers[1],
+               static_cast<GLintptr>(static_cast<std::uint64_t>(slot) *
+                                     MaxIndices * sizeof(std::uint16_t)),
+               static_cast<GLsizeiptr>(size - vertex_bytes),
+               staging + vertex_bytes);
+
+  if (ClusterInSlot[slot] != NONE)
+    SlotOfCluster[ClusterInSlot[slot]] = NONE;
+  ClusterInSlot[slot] = cluster;
+  SlotOfCluster[cluster] = slot;
+  StreamedBytes += size;
+  currentFrameStats().BufferBytes += size;
+}
+
+void StreamedMesh::update(const glm::vec3 &viewpoint, const Frustum &frustum) {
+  Updates++;
+  // Clusters in the frustum, nearest first, as many as there are slots
+  std::vector<std::pair<float, std::uint32_t>> wanted;
+  for (std::uint32_t i = 0; i < Clusters.size(); i++) {
+    const BoundingBox &box = Clusters[i].Bounds;
+    if (!frustum.intersects(box))
+      continue;
+    const glm::vec3 offset = glm::clamp(viewpoint, box.Min, box.Max) - viewpoint;
+    wanted.push_back(std::make_pair(glm::dot(offset, offset), i));
+  }
+  const std::size_t count = std::min(wanted.size(), ClusterInSlot.size());
+  std::partial_sort(wanted.begin(), wanted.begin() + count, wanted.end());
+  wanted.resize(count);
+  for (const auto &cluster : wanted) {
+    if (SlotOfCluster[cluster.second] != NONE)
+      SlotLastWanted[SlotOfCluster[cluster.second]] = Updates;
+  }
+
+  // Stream in what is missing until the staging buffer is full
+  std::size_t staged = 0;
+  for (const auto &cluster : wanted) {
+    if (SlotOfCluster[cluster.second] != NONE)
+      continue;
+    const std::size_t size =
+        static_cast<std::size_t>(Clusters[cluster.second].getDataSize());
+    if (staged + size > Staging.size())
+      break;
+    const std::uint32_t slot = findSlot();
+    if (slot == NONE)
+      break;
+    upload(cluster.second, slot, Staging.data() + staged);
+    SlotLastWanted[slot] = Updates;
+    staged += size;
+  }
+
+  DrawCounts.clear();
+  DrawOffsets.clear();
+  DrawBaseVertices.clear();
+  for (const auto &cluster : wanted) {
+    const std::uint32_t slot = SlotOfCluster[cluster.second];
+    if (slot == NONE)
+      continue;
+    DrawCounts.push_back(static_cast<GLsizei>(Clusters[cluster.second].IndexCount));
+    DrawOffsets.push_back(reinterpret_cast<void *>(
+        static_cast<std::uintptr_t>(slot) * MaxIndices * sizeof(std::uint16_t)));
+    DrawBaseVertices.push_back(static_cast<GLint>(slot * MaxVertices));
+  }
+}
+
+void StreamedMesh::draw() {
+  if (DrawCounts.empty())
+    return;
+  FrameStats &stats = currentFrameStats();
+  glBindVertexArray(VaoId);
+  stats.VaoBinds++;
+  glMultiDrawElementsBaseVertex(GL_TRIANGLES, DrawCounts.data(),
+                                GL_UNSIGNED_SHORT, DrawOffsets.data(),
+                                static_cast<GLsizei>(DrawCounts.size()),
+                                DrawBaseVertices.data());
+  stats.DrawCalls++;
+  for (GLsizei count : DrawCounts) {
+    stats.Triangles += count / 3;
+    stats.Vertices += count;
+  }
+  glBindVertexArray(0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
@@ -0,0 +1,152 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Out-of-Core Mesh Streaming
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_STREAMING_HPP
+#define MGL_STREAMING_HPP
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "./mglBounds.hpp"
+#include "./mglScenegraph.hpp"
+
+namespace mgl {
+
+class JobSystem;
+struct ObjData;
+struct ClusterVertex;
+struct ClusterInfo;
+class ClusterBuilder;
+class StreamedMesh;
+
+////////////////////////////////////////////////////////////////// ClusterVertex
+
+// Interleaved vertex of a cluster file; absent attributes are zero.
+struct ClusterVertex {
+  glm::vec3 Position;
+  glm::vec3 Normal;
+  glm::vec2 Texcoord;
+};
+
+//////////////////////////////////////////////////////////////////// ClusterInfo
+
+// Cluster data sits at DataOffset: VertexCount vertices, then IndexCount
+// 16-bit indices local to the cluster.
+struct ClusterInfo {
+  BoundingBox Bounds;
+  std::uint32_t VertexCount = 0;
+  std::uint32_t IndexCount = 0;
+  std::uint64_t DataOffset = 0;
+
+  std::uint64_t getDataSize() const;
+};
+
+///////////////////////////////////////////////////////////////// ClusterBuilder
+
+// Preprocesses a mesh into a cluster file for StreamedMesh. Triangles are
+// ordered along a Morton curve over their centroids and cut into clusters of
+// bounded size, so each cluster covers a compact region. Clusters are written
+// as they fill up and the cluster table goes at the end of the file.
+class ClusterBuilder {
+public:
+  static const std::uint32_t DEFAULT_MAX_VERTICES = 16384;
+  static const std::uint32_t DEFAULT_MAX_TRIANGLES = 32768;
+
+  ClusterBuilder();
+  explicit ClusterBuilder(JobSystem &jobs);
+
+  // At most 65536 vertices, as cluster indices are 16-bit.
+  void setClusterSize(std::uint32_t max_vertices, std::uint32_t max_triangles);
+
+  // Returns the number of clusters written. Throws std::runtime_error if the
+  // file cannot be written.
+  std::size_t build(const ObjData &data, const std::string &filename) const;
+
+private:
+  JobSystem &Jobs;
+  std::uint32_t MaxVertices;
+  std::uint32_t MaxTriangles;
+};
+
+/////////////////////////////////////////////////////////////////// StreamedMesh
+
+// Draws a cluster file of any size within a fixed GPU memory budget. The
+// budget is split into slots that hold one cluster each. Every update picks
+// the clusters in the frustum nearest the viewpoint, evicts the least recently
+// needed ones and reads missing clusters from the file through a staging
+// buffer, which also caps the bytes uploaded per update. Only resident
+// clusters in the frustum are drawn, with a single multi-draw call.
+class StreamedMesh : public IDrawable {
+public:
+  static const GLuint POSITION = 1;
+  static const GLuint NORMAL = 2;
+  static const GLuint TEXCOORD = 3;
+  static const std::uint64_t DEFAULT_MEMORY_BUDGET = 256ull << 20;
+  static const std::size_t DEFAULT_STAGING_SIZE = 8 << 20;
+
+  StreamedMesh();
+  ~StreamedMesh();
+  StreamedMesh(const StreamedMesh &) = delete;
+  StreamedMesh &operator=(const StreamedMesh &) = delete;
+
+  // Both take effect on the next open.
+  void setMemoryBudget(std::uint64_t bytes);
+  void setStagingSize(std::size_t bytes);
+
+  // Reads the cluster table and allocates the GPU slots. Throws
+  // std::runtime_error if the file cannot be read or is not a cluster file.
+  void open(const std::string &filename);
+  // Viewpoint and frustum in model space.
+  void update(const glm::vec3 &viewpoint, const Frustum &frustum);
+  void draw() override;
+
+  bool hasNormals() const;
+  bool hasTexcoords() const;
+  const BoundingBox &getBoundingBox() const;
+  std::size_t getClusterCount() const;
+  std::size_t getSlotCount() const;
+  std::size_t getResidentCount() const;
+  std::size_t getDrawnCount() const;
+  std::uint64_t getGpuBytes() const;
+  std::uint64_t getStreamedBytes() const;
+
+private:
+  std::string Filename;
+  std::ifstream File;
+  std::uint32_t Flags;
+  std::uint32_t MaxVertices, MaxIndices;
+  std::vector<ClusterInfo> Clusters;
+  BoundingBox Bounds;
+
+  std::uint64_t MemoryBudget;
+  std::size_t StagingSize;
+  std::vector<char> Staging;
+
+  GLuint VaoId, Buffers[2];
+  std::vector<std::uint32_t> SlotOfCluster;
+  std::vector<std::uint32_t> ClusterInSlot;
+  std::vector<unsigned long long> SlotLastWanted;
+  unsigned long long Updates;
+  std::uint64_t StreamedBytes;
+
+  std::vector<GLsizei> DrawCounts;
+  std::vector<void *> DrawOffsets;
+  std::vector<GLint> DrawBaseVertices;
+
+  void close();
+  std::uint32_t findSlot() const;
+  void upload(std::uint32_t cluster, std::uint32_t slot, char *staging);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_STREAMING_HPP */
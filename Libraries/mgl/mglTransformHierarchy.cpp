@@ -0,0 +1,161 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Transform Hierarchy
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglTransformHierarchy.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include "./mglBuffers.hpp"
+#include "./mglConventions.hpp"
+#include "./mglShader.hpp"
+#include "./mglStats.hpp"
+
+namespace mgl {
+
+///////////////////////////////////////////////////////////// TransformHierarchy
+
+TransformHierarchy::TransformHierarchy()
+    : LevelFirstId(-1), LevelCountId(-1), Buffers{0, 0, 0}, BufferBytes(0) {}
+
+TransformHierarchy::~TransformHierarchy() { destroyBuffers(); }
+
+GLuint TransformHierarchy::addNode(GLint parent, const glm::mat4 &local) {
+  const GLuint depth = parent < 0 ? 0 : Depths.at(parent) + 1;
+  if (!Depths.empty() && depth < Depths.back()) {
+    std::cerr << "[ERROR] Transform hierarchy nodes must be added breadth first"
+              << std::endl;
+    throw std::runtime_error("Transform hierarchy out of order.");
+  }
+  const GLuint index = static_cast<GLuint>(Locals.size());
+  if (Depths.empty() || depth != Depths.back()) {
+    Levels.push_back(index);
+  }
+  Locals.push_back(local);
+  Parents.push_back(parent);
+  Depths.push_back(depth);
+  return index;
+}
+
+void TransformHierarchy::clear() {
+  Locals.clear();
+  Parents.clear();
+  Depths.clear();
+  Levels.clear();
+  destroyBuffers();
+}
+
+void TransformHierarchy::create(const std::string &compute_shader) {
+  destroyBuffers();
+  Propagate.reset(new ShaderProgram());
+  Propagate->addShader(GL_COMPUTE_SHADER, compute_shader);
+  Propagate->addUniform(LEVEL_FIRST);
+  Propagate->addUniform(LEVEL_COUNT);
+  Propagate->create();
+  LevelFirstId = Propagate->Uniforms[LEVEL_FIRST].index;
+  LevelCountId = Propagate->Uniforms[LEVEL_COUNT].index;
+
+  // Empty storage blocks are not allowed, so every buffer holds at least one
+  const std::size_t count = std::max<std::size_t>(Locals.size(), 1);
+  const glm::mat4 identity(1.0f);
+  const GLint root = -1;
+  Buffers[0] = createBuffer(count * sizeof(glm::mat4),
+                            Locals.empty() ? &identity : Locals.data(),
+                            BufferUsage::Dynamic);
+  Buffers[1] = createBuffer(count * sizeof(GLint),
+                            Parents.empty() ? &root : Parents.data(),
+                            BufferUsage::Static);
+  Buffers[2] = createBuffer(count * sizeof(glm::mat4), nullptr,
+                            BufferUsage::Gpu);
+  BufferBytes = count * (2 * sizeof(glm::mat4) + sizeof(GLint));
+
+  FrameStats &stats = currentFrameStats();
+  if (!hasDirectStateAccess())
+    stats.BufferBinds += 3;
+  stats.BufferBytes += BufferBytes;
+}
+
+void TransformHierarchy::destroyBuffers() {
+  if (Buffers[0] != 0) {
+    glDeleteBuffers(3, Buffers);
+    Buffers[0] = Buffers[1] = Buffers[2] = 0;
+  }
+  BufferBytes = 0;
+}
+
+void TransformHierarchy::update(const std::vector<TransformUpdate> &updates) {
+  if (updates.empty() || Buffers[0] == 0)
+    return;
+  Dirty.clear();
+  for (const TransformUpdate &update : updates) {
+    if (update.Index >= Locals.size()) {
+      std::cerr << "[ERROR] Transform update for node " << update.Index
+                << " of a hierarchy with " << Locals.size() << " nodes"
+                << std::endl;
+      throw std::runtime_error("Transform update out of range.");
+    }
+    Locals[update.Index] = update.Local;
+    Dirty.push_back(update.Index);
+  }
+  std::sort(Dirty.begin(), Dirty.end());
+
+  // Locals mirrors the buffer, so short gaps are cheaper to resend than to skip
+  FrameStats &stats = currentFrameStats();
+  if (!hasDirectStateAccess())
+    stats.BufferBinds++;
+  std::size_t first = 0;
+  for (std::size_t i = 0; i < Dirty.size(); i++) {
+    if (i + 1 < Dirty.size() && Dirty[i + 1] <= Dirty[i] + MAX_GAP + 1)
+      continue;
+    const GLuint index = Dirty[first];
+    const std::size_t bytes = (Dirty[i] + 1 - index) * sizeof(glm::mat4);
+    updateBuffer(Buffers[0], index * sizeof(glm::mat4), bytes, &Locals[index]);
+    stats.BufferBytes += bytes;
+    first = i + 1;
+  }
+}
+
+void TransformHierarchy::propagate() {
+  if (Buffers[0] == 0 || Locals.empty())
+    return;
+  FrameStats &stats = currentFrameStats();
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LOCAL_BINDING, Buffers[0]);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARENT_BINDING, Buffers[1]);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, WORLD_BINDING, Buffers[2]);
+  stats.BufferBinds += 3;
+  Propagate->bind();
+  for (std::size_t level = 0; level < Levels.size(); level++) {
+    const GLuint first = Levels[level];
+    const GLuint last = level + 1 < Levels.size()
+                            ? Levels[level + 1]
+                            : static_cast<GLuint>(Locals.size());
+    glUniform1ui(LevelFirstId, first);
+    glUniform1ui(LevelCountId, last - first);
+    stats.UniformUploads += 2;
+    glDispatchCompute((last - first + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+    // The next level, and the draws after the last one, read these worlds
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  }
+  Propagate->unbind();
+}
+
+void TransformHierarchy::readWorlds(std::vector<glm::mat4> &worlds) const {
+  worlds.resize(Locals.size());
+  if (Buffers[2] == 0 || Locals.empty())
+    return;
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  readBuffer(Buffers[2], 0, worlds.size() * sizeof(glm::mat4), worlds.data());
+}
+
+std::size_t TransformHierarchy::getNodeCount() const { return Locals.size(); }
+
+std::size_t TransformHierarchy::getLevelCount() const { return Levels.size(); }
+
+std::size_t TransformHierarchy::getBufferBytes() const { return BufferBytes; }
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
@@ -0,0 +1,86 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Transform Hierarchy
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_TRANSFORM_HIERARCHY_HPP
+#define MGL_TRANSFORM_HIERARCHY_HPP
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mgl {
+
+class ShaderProgram;
+struct TransformUpdate;
+class TransformHierarchy;
+
+//////////////////////////////////////////////////////////////// TransformUpdate
+
+struct TransformUpdate {
+  GLuint Index;
+  glm::mat4 Local;
+};
+
+///////////////////////////////////////////////////////////// TransformHierarchy
+
+// World transforms computed by a compute shader. Local transforms and parent
+// indices live in shader storage buffers; propagate() runs one dispatch per
+// depth level, each reading the worlds the previous one wrote, and leaves the
+// world buffer bound at WORLD_BINDING for the draw shaders to read.
+//
+// Nodes are added breadth first, so a node's parent always sits in an earlier
+// level and every level is a contiguous range of indices.
+class TransformHierarchy {
+public:
+  static const GLuint LOCAL_BINDING = 2;
+  static const GLuint PARENT_BINDING = 3;
+  static const GLuint WORLD_BINDING = 4;
+  static const GLuint GROUP_SIZE = 64; // local_size_x of the compute shader
+
+  TransformHierarchy();
+  ~TransformHierarchy();
+  TransformHierarchy(const TransformHierarchy &) = delete;
+  TransformHierarchy &operator=(const TransformHierarchy &) = delete;
+
+  // parent is -1 for roots; returns the index of the node.
+  GLuint addNode(GLint parent, const glm::mat4 &local);
+  void clear();
+  // Requires a GL 4.3 context; compiles the compute shader and uploads all.
+  void create(const std::string &compute_shader);
+  // Re-uploads the given local transforms, in any order, one call per run.
+  // Throws std::runtime_error for an index past the last node.
+  void update(const std::vector<TransformUpdate> &updates);
+  void propagate();
+  // Reads the world transforms back, e.g. to compare with the CPU.
+  void readWorlds(std::vector<glm::mat4> &worlds) const;
+
+  std::size_t getNodeCount() const;
+  std::size_t getLevelCount() const;
+  std::size_t getBufferBytes() const;
+
+private:
+  std::vector<glm::mat4> Locals;
+  std::vector<GLint> Parents;
+  std::vector<GLuint> Depths;
+  std::vector<GLuint> Levels; // first index of every level
+  std::vector<GLuint> Dirty;
+  std::unique_ptr<ShaderProgram> Propagate;
+  GLint LevelFirstId, LevelCountId;
+  GLuint Buffers[3];
+  std::size_t BufferBytes;
+
+  static const GLuint MAX_GAP = 4;
+
+  void destroyBuffers();
+};
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_TRANSFORM_HIERARCHY_HPP */
@@ -0,0 +1,218 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Asynchronous GPU Uploads
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglUploadQueue.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+#include "./mglStats.hpp"
+
+namespace mgl {
+
+//////////////////////////////////////////////////////////////////// UploadQueue
+
+UploadQueue::UploadQueue()
+    : Context(nullptr), Running(false), Stopping(false), Busy(false),
+      UploadCount(0), UploadedBytes(0), UploadTime(0.0), TotalStall(0.0),
+      MaxStall(0.0) {}
+
+UploadQueue::~UploadQueue() {
+  // Without a render context left, pending uploads are dropped
+  if (Thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(Mutex);
+      Stopping = true;
+    }
+    Wake.notify_all();
+    Thread.join();
+  }
+}
+
+UploadQueue &UploadQueue::getInstance() {
+  static UploadQueue queue;
+  return queue;
+}
+
+void UploadQueue::start(GLFWwindow *context) {
+  if (Running)
+    return;
+  Context = context;
+  Stopping = false;
+  Running = true;
+  Thread = std::thread(&UploadQueue::uploadLoop, this);
+}
+
+void UploadQueue::stop() {
+  if (!Running)
+    return;
+  finish();
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    Stopping = true;
+  }
+  Wake.notify_all();
+  Thread.join();
+  Running = false;
+  Context = nullptr;
+}
+
+bool UploadQueue::isRunning() const { return Running; }
+
+void UploadQueue::setNotify(std::function<void()> notify) {
+  Notify = std::move(notify);
+}
+
+void UploadQueue::submit(UploadJob upload, PublishJob publish_step) {
+  if (Running) {
+    {
+      std::lock_guard<std::mutex> lock(Mutex);
+      Pending pending;
+      pending.Upload = std::move(upload);
+      pending.Publish = std::move(publish_step);
+      Queue.push_back(std::move(pending));
+    }
+    Wake.notify_one();
+    return;
+  }
+  const double start = glfwGetTime();
+  const std::size_t bytes = upload();
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    UploadCount++;
+    UploadedBytes += bytes;
+    UploadTime += glfwGetTime() - start;
+  }
+  publish_step();
+  recordStall(glfwGetTime() - start);
+}
+
+void UploadQueue::publish() {
+  {
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (Done.empty())
+      return;
+  }
+  const double start = glfwGetTime();
+  publishCompleted(false);
+  recordStall(glfwGetTime() - start);
+}
+
+void UploadQueue::finish() {
+  const double start = glfwGetTime();
+  if (Running) {
+    std::unique_lock<std::mutex> lock(Mutex);
+    Idle.wait(lock, [this]() { return Queue.empty() && !Busy; });
+  }
+  publishCompleted(true);
+  recordStall(glfwGetTime() - start);
+}
+
+void UploadQueue::publishCompleted(bool wait) {
+  for (;;) {
+    GLsync fence;
+    {
+      std::lock_guard<std::mutex> lock(Mutex);
+      if (Done.empty())
+        return;
+      fence = Done.front().Fence;
+    }
+    const GLuint64 timeout = wait ? 1000000000 : 0;
+    GLenum status;
+    do {
+      status = glClientWaitSync(fence, 0, timeout);
+    } while (wait && status == GL_TIMEOUT_EXPIRED);
+    if (status == GL_TIMEOUT_EXPIRED)
+      return;
+    if (status == GL_WAIT_FAILED) {
+      std::cerr << "[ERROR] Failed to wait for an upload fence." << std::endl;
+      throw std::runtime_error("Failed to wait for an upload fence.");
+    }
+
+    Completed completed;
+    {
+      std::lock_guard<std::mutex> lock(Mutex);
+      completed = std::move(Done.front());
+      Done.pop_front();
+    }
+    glDeleteSync(completed.Fence);
+    if (completed.Error)
+      std::rethrow_exception(completed.Error);
+    completed.Publish();
+  }
+}
+
+void UploadQueue::recordStall(double stall) {
+  TotalStall += stall;
+  MaxStall = std::max(MaxStall, stall);
+  currentFrameStats().UploadTime += stall;
+}
+
+void UploadQueue::uploadLoop() {
+  glfwMakeContextCurrent(Context);
+  for (;;) {
+    Pending pending;
+    {
+      std::unique_lock<std::mutex> lock(Mutex);
+      Wake.wait(lock, [this]() { return Stopping || !Queue.empty(); });
+      if (Queue.empty())
+        break;
+      pending = std::move(Queue.front());
+      Queue.pop_front();
+      Busy = true;
+    }
+
+    const double start = glfwGetTime();
+    Completed completed;
+    std::size_t bytes = 0;
+    try {
+      bytes = pending.Upload();
+    } catch (...) {
+      completed.Error = std::current_exception();
+    }
+    // The render thread sees the upload once this fence has signalled
+    completed.Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    completed.Publish = std::move(pending.Publish);
+
+    {
+      std::lock_guard<std::mutex> lock(Mutex);
+      Done.push_back(std::move(completed));
+      UploadCount++;
+      UploadedBytes += bytes;
+      UploadTime += glfwGetTime() - start;
+      Busy = false;
+    }
+    Idle.notify_all();
+    if (Notify)
+      Notify();
+  }
+  glfwMakeContextCurrent(nullptr);
+}
+
+unsigned long long UploadQueue::getUploadCount() const {
+  std::lock_guard<std::mutex> lock(Mutex);
+  return UploadCount;
+}
+
+std::uint64_t UploadQueue::getUploadedBytes() const {
+  std::lock_guard<std::mutex> lock(Mutex);
+  return UploadedBytes;
+}
+
+double UploadQueue::getUploadTime() const {
+  std::lock_guard<std::mutex> lock(Mutex);
+  return UploadTime;
+}
+
+double UploadQueue::getTotalStall() const { return TotalStall; }
+
+double UploadQueue::getMaxStall() const { return MaxStall; }
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
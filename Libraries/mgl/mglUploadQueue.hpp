@@ -0,0 +1,110 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Asynchronous GPU Uploads
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_UPLOAD_QUEUE_HPP
+#define MGL_UPLOAD_QUEUE_HPP
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace mgl {
+
+class UploadQueue;
+
+typedef std::function<std::size_t()> UploadJob; // returns the bytes uploaded
+typedef std::function<void()> PublishJob;
+
+//////////////////////////////////////////////////////////////////// UploadQueue
+
+// Runs buffer and texture uploads on a dedicated thread that owns a second GL
+// context, shared with the render context (see Engine::setAsyncUploads). Each
+// upload is fenced; once its fence has signalled, its publish step runs on the
+// render thread from publish(), which the Engine calls at the start of every
+// frame. Buffers and textures are shared between the contexts but vertex
+// arrays and framebuffers are not, so those belong in the publish step.
+//
+// While the queue is stopped, submit runs both steps right away on the calling
+// thread, which must then own the GL context.
+class UploadQueue {
+public:
+  UploadQueue();
+  ~UploadQueue();
+  UploadQueue(const UploadQueue &) = delete;
+  UploadQueue &operator=(const UploadQueue &) = delete;
+  static UploadQueue &getInstance();
+
+  // The upload thread makes context current; it must share objects with the
+  // render context and must not be current on any other thread.
+  void start(GLFWwindow *context);
+  // Publishes everything submitted so far and joins the upload thread. Call
+  // on the render thread.
+  void stop();
+  bool isRunning() const;
+  // Called on the upload thread whenever an upload is ready to publish, e.g.
+  // to wake an idle render loop.
+  void setNotify(std::function<void()> notify);
+
+  // Thread-safe while the queue is running. An exception thrown by the upload
+  // is rethrown by publish() in place of the publish step.
+  void submit(UploadJob upload, PublishJob publish_step);
+  // Publishes the uploads that have completed on the GPU, in order, without
+  // waiting for the others.
+  void publish();
+  // Waits for every upload submitted so far and publishes it.
+  void finish();
+
+  unsigned long long getUploadCount() const;
+  std::uint64_t getUploadedBytes() const;
+  // Time spent issuing uploads, on the upload thread or inline.
+  double getUploadTime() const;
+  // Time the render thread spent on uploads: polling fences and publishing,
+  // or uploading inline while the queue is stopped.
+  double getTotalStall() const;
+  double getMaxStall() const;
+
+private:
+  struct Pending {
+    UploadJob Upload;
+    PublishJob Publish;
+  };
+  struct Completed {
+    GLsync Fence;
+    PublishJob Publish;
+    std::exception_ptr Error;
+  };
+  GLFWwindow *Context;
+  std::thread Thread;
+  std::atomic<bool> Running;
+  bool Stopping, Busy;
+  mutable std::mutex Mutex;
+  std::condition_variable Wake, Idle;
+  std::deque<Pending> Queue;
+  std::deque<Completed> Done;
+  std::function<void()> Notify;
+
+  unsigned long long UploadCount;
+  std::uint64_t UploadedBytes;
+  double UploadTime;
+  double TotalStall, MaxStall;
+
+  void uploadLoop();
+  void publishCompleted(bool wait);
+  void recordStall(double stall);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+} // namespace mgl
+
+#endif /* MGL_UPLOAD_QUEUE_HPP */
@@ -15,12 +15,18 @@
 // 
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <memory>
 #include <unordered_map>
 #include <iostream>
+#include <string>
 
 #include "../mgl/mgl.hpp"
 #include "ScenegraphNode.h"
+#include "ScenePicker.h"
+#include "StressScene.h"
 
 ////////////////////////////////////////////////////////////////////////// MYAPP
 
@@ -29,6 +35,7 @@ typedef struct CameraData {
     glm::mat4 PerspectiveMatrix;
     glm::mat4 OrthoProjectionMatrix;
     bool isPerspective = true;
+    glm::quat previousRot;
     glm::quat currentRot;
     glm::quat targetRot;
     float orbitRadius = 35.0f;
@@ -36,22 +43,42 @@ typedef struct CameraData {
 
 class MyApp : public mgl::App {
 public:
+    explicit MyApp(const StressSceneConfig& stress);
     void initCallback(GLFWwindow* win) override;
     void displayCallback(GLFWwindow* win, double elapsed) override;
+    void simulateCallback(GLFWwindow* win, double elapsed, mgl::FramePacket& packet) override;
+    void fixedUpdateCallback(GLFWwindow* win, double dt) override;
     void windowSizeCallback(GLFWwindow* win, int width, int height) override;
     void keyCallback(GLFWwindow* win, int key, int scancode, int action, int mods) override;
     void mouseButtonCallback(GLFWwindow* win, int button, int action, int mods) override;
     void cursorCallback(GLFWwindow* win, double xpos, double ypos) override;
     void scrollCallback(GLFWwindow* win, double xoffset, double yoffset) override;
+    void reportAnimation() const;
+    void reportStreaming() const;
+    void cookPak(const std::string& filename);
 
 private:
     const GLuint UBO_BP = 0, COLOR = 5;
-    mgl::ShaderProgram* Shaders = nullptr;
+    mgl::ShaderCache ShaderVariants;
     mgl::Camera* Camera = nullptr;
     std::vector<CameraData> Cameras;
-    GLint ModelMatrixId, ColorId;
+    glm::ivec4 Viewport = glm::ivec4(0);
+    mgl::FramePacket Packet;
+    mgl::InstancedAnimation Instances;
+    bool gpuAnimation = false;
+    mgl::TransformHierarchy Hierarchy;
+    bool gpuTransforms = false;
+    mgl::StaticBatches Statics;
+    bool staticBatching = false;
+    std::unique_ptr<mgl::StreamedMesh> Streamed;
+    mgl::ShaderProgram* StreamedShaders = nullptr;
+    glm::mat4 StreamedModel = glm::mat4(1.0f);
+    std::unique_ptr<mgl::ShaderBatch> PendingShaders;
     std::unordered_map<std::string, std::shared_ptr<mgl::Mesh>> Meshes;
-    ScenegraphNode* Root = nullptr;
+    NodeHandle Root;
+    NodeHandle Board;
+    ScenePicker Picker;
+    NodeHandle pickedNode;
 	std::unordered_map<std::string, TransformTRS> Transforms;
 
     int currentCamera = 1;
@@ -68,73 +95,151 @@ private:
     float pitchSpeed = 1.0f;
 
     float animationT = 0.0f;
+    float previousAnimationT = 0.0f;
+    float renderedAnimationT = 0.0f;
     float animationSpeed = 0.75f;
     int animationDirection = 0; // -1 backward, +1 forward
 
+    const StressSceneConfig& Stress;
+    double stressTime = 0.0;
+
     void createMeshes();
-    mgl::ShaderProgram* createShaderPrograms(mgl::Mesh* Mesh);
+    enum class ModelSource { Uniform, Instance, Hierarchy };
+    mgl::ShaderProgram* createShaderPrograms(mgl::Mesh* Mesh, ModelSource source = ModelSource::Uniform);
+    void setupGpuAnimation();
+    void setupGpuTransforms();
+    float validateGpuTransforms(float t);
+    void setupStaticBatching();
+    void setupStreaming();
     void createCamera();
-    void drawScene();
-    void updateCamera();
+    void collectScene(mgl::FramePacket& packet);
+    void updateCamera(CameraData& camera, double dt);
+    void updateViewMatrix(CameraData& camera, float alpha);
     void createScenegraph();
+    ScenegraphNode* createBoard();
+    ScenegraphNode* createPickagram();
     void transformations();
+    bool loadTransforms();
+    std::string cookTransforms() const;
     void processInput();
+    void pickPiece(double xpos, double ypos);
+};
+
+MyApp::MyApp(const StressSceneConfig& stress) : Stress(stress) {}
+
+/** @brief Directory of the mesh files, as `createMeshes()` and the pak name them. */
+const std::string MESH_DIR = "./shapes/";
+
+/** @brief Meshes of the scene, loaded by `createMeshes()`. */
+const std::vector<std::string> MESH_FILES = {
+    "BigTriangle.obj", "Parallelogram.obj", "TallSmallTriangle.obj",
+    "Square.obj", "ShortSmallTriangle.obj", "MediumTriangle.obj", "Cube.obj"
+};
+
+/** @brief Every shader source of the scene, including the `#include`d ones. */
+const std::vector<std::string> SHADER_FILES = {
+    "cube-vs.glsl", "cube-instanced-vs.glsl", "cube-hierarchy-vs.glsl",
+    "cube-common-vs.glsl", "cube-fs.glsl", "colors.glsl", "hierarchy-cs.glsl"
 };
 
+/** @brief Pak entry holding the named transforms of `transformations()`. */
+const std::string SCENE_ENTRY = "pickagram.scene";
+
+/** @brief A named transform as stored in the scene entry of the pak. */
+typedef struct CookedTransform {
+    char name[48];
+    float position[3];
+    float rotation[4]; // w, x, y, z
+    float scale[3];
+} CookedTransform;
+
 ////////////////////////////////////////////////////////////////// VAO, VBO, EBO
 
 /**
  * @brief Loads mesh files from the `./shapes/` directory and registers them.
  *
- * For each OBJ listed in `mesh_files`, creates an `mgl::Mesh`, joins identical
+ * For each OBJ listed in `MESH_FILES`, creates an `mgl::Mesh`, joins identical
  * vertices for efficiency, loads the mesh data, and stores it in `Meshes`
- * keyed by the filename without extension (e.g., "Square", "Cube").
+ * keyed by the filename without extension (e.g., "Square", "Cube"). CPU-side
+ * copies are kept or released after upload as `--mesh-residency` says, except
+ * that the cube keeps them for `--static-batching`, which merges the boards.
+ * With a pak mounted (`--pak`), the meshes come ready to upload from there.
  *
  * Postconditions:
  *  - `Meshes` contains all required shapes used by `createScenegraph()`.
  */
 void MyApp::createMeshes() {
-    std::string mesh_dir = "./shapes/";
-    std::vector<std::string> mesh_files = {
-        "BigTriangle.obj", "Parallelogram.obj", "TallSmallTriangle.obj",
-		"Square.obj", "ShortSmallTriangle.obj", "MediumTriangle.obj", "Cube.obj"
-    };
-
-    for (const auto& file : mesh_files) {
+    for (const auto& file : MESH_FILES) {
         std::shared_ptr<mgl::Mesh> mesh = std::make_shared<mgl::Mesh>();
 		mesh->joinIdenticalVertices();
-        mesh->create(mesh_dir + file);
+        mesh->setResidency(Stress.staticBatching && file == "Cube.obj"
+            ? mgl::MeshResidency::Keep : Stress.meshResidency);
+        mesh->create(MESH_DIR + file);
 		Meshes.insert({ file.substr(0, file.find_last_of('.')), mesh });
 	}
 }
 
 ///////////////////////////////////////////////////////////////////////// SHADER
 
-mgl::ShaderProgram* MyApp::createShaderPrograms(mgl::Mesh* Mesh) {
-    Shaders = new mgl::ShaderProgram();
-    Shaders->addShader(GL_VERTEX_SHADER, "cube-vs.glsl");
-    Shaders->addShader(GL_FRAGMENT_SHADER, "cube-fs.glsl");
-
-    Shaders->addAttribute(mgl::POSITION_ATTRIBUTE, mgl::Mesh::POSITION);
+/**
+ * @brief Returns the shader program used to draw `Mesh`, creating it on first use.
+ *
+ * Programs are cached per variant: the shader files plus the defines for the
+ * colouring chosen with `--color` and for the attributes the mesh has. Pieces
+ * (and stress scene copies) with the same variant share one program instead
+ * of compiling and linking their own.
+ * `source` selects where the vertex shader takes the model matrix from: the
+ * model matrix uniform, the instance animated on the GPU (see
+ * `setupGpuAnimation()`) or the GPU transform hierarchy (see
+ * `setupGpuTransforms()`).
+ *
+ * During `initCallback()` new programs join `PendingShaders` instead of being
+ * created right away, so the driver can compile them all in parallel.
+ */
+mgl::ShaderProgram* MyApp::createShaderPrograms(mgl::Mesh* Mesh, ModelSource source) {
+    const mgl::ShaderSources sources = {
+        { GL_VERTEX_SHADER,
+            source == ModelSource::Instance ? "cube-instanced-vs.glsl"
+            : source == ModelSource::Hierarchy ? "cube-hierarchy-vs.glsl"
+            : "cube-vs.glsl" },
+        { GL_FRAGMENT_SHADER, "cube-fs.glsl" }
+    };
+    mgl::ShaderDefines defines = { { Stress.colorDefine, "" } };
     if (Mesh->hasNormals()) {
-        Shaders->addAttribute(mgl::NORMAL_ATTRIBUTE, mgl::Mesh::NORMAL);
+        defines["HAS_NORMALS"] = "";
     }
     if (Mesh->hasTexcoords()) {
-        Shaders->addAttribute(mgl::TEXCOORD_ATTRIBUTE, mgl::Mesh::TEXCOORD);
+        defines["HAS_TEXCOORDS"] = "";
     }
     if (Mesh->hasTangentsAndBitangents()) {
-        Shaders->addAttribute(mgl::TANGENT_ATTRIBUTE, mgl::Mesh::TANGENT);
+        defines["HAS_TANGENTS"] = "";
     }
 
-    Shaders->addUniform(mgl::MODEL_MATRIX);
-    Shaders->addUniform(mgl::COLOR_ATTRIBUTE);
-    Shaders->addUniformBlock(mgl::CAMERA_BLOCK, UBO_BP);
-    Shaders->create();
-
-    ModelMatrixId = Shaders->Uniforms[mgl::MODEL_MATRIX].index;
-    ColorId = Shaders->Uniforms[mgl::COLOR_ATTRIBUTE].index;
+    return ShaderVariants.get(sources, defines, [&](mgl::ShaderProgram& program) {
+        program.addAttribute(mgl::POSITION_ATTRIBUTE, mgl::Mesh::POSITION);
+        if (Mesh->hasNormals()) {
+            program.addAttribute(mgl::NORMAL_ATTRIBUTE, mgl::Mesh::NORMAL);
+        }
+        if (Mesh->hasTexcoords()) {
+            program.addAttribute(mgl::TEXCOORD_ATTRIBUTE, mgl::Mesh::TEXCOORD);
+        }
+        if (Mesh->hasTangentsAndBitangents()) {
+            program.addAttribute(mgl::TANGENT_ATTRIBUTE, mgl::Mesh::TANGENT);
+        }
 
-    return Shaders;
+        if (source == ModelSource::Hierarchy) {
+            program.addUniform(mgl::TRANSFORM_INDEX);
+        }
+        else {
+            program.addUniform(mgl::MODEL_MATRIX);
+        }
+        program.addUniform(mgl::COLOR_ATTRIBUTE);
+        if (source == ModelSource::Instance) {
+            program.addUniform(mgl::ANIMATION_TIME);
+            program.addUniform(mgl::INSTANCE_OFFSET);
+        }
+        program.addUniformBlock(mgl::CAMERA_BLOCK, UBO_BP);
+    }, PendingShaders.get());
 }
 
 ///////////////////////////////////////////////////////////////////////// SCENEGRAPH
@@ -267,23 +372,71 @@ void MyApp::transformations() {
                                                                    * glm::angleAxis(glm::radians(10.0f), glm::vec3(0.0f, 1.0f, 0.0f))) });
 
 }
+
+/**
+ * @brief Reads the named transforms from the scene entry of the mounted pak.
+ *
+ * The records are read in place from the mapped pak. Returns false, leaving
+ * `Transforms` to `transformations()`, if no pak has the entry or it is not
+ * a whole number of `CookedTransform` records.
+ */
+bool MyApp::loadTransforms() {
+    const mgl::PakView scene = mgl::Pak::getInstance().find(SCENE_ENTRY, mgl::PakType::Scene);
+    if (scene.isEmpty()) {
+        return false;
+    }
+    if (scene.Size % sizeof(CookedTransform) != 0) {
+        std::cerr << "[ERROR] Invalid scene in the pak, using the built-in transforms" << std::endl;
+        return false;
+    }
+    const CookedTransform* cooked = reinterpret_cast<const CookedTransform*>(scene.Data);
+    for (size_t i = 0; i < scene.Size / sizeof(CookedTransform); i++) {
+        const CookedTransform& t = cooked[i];
+        const std::string name(t.name, std::find(t.name, t.name + sizeof(t.name), '\0'));
+        Transforms[name] = TransformTRS(
+            glm::vec3(t.position[0], t.position[1], t.position[2]),
+            glm::quat(t.rotation[0], t.rotation[1], t.rotation[2], t.rotation[3]),
+            glm::vec3(t.scale[0], t.scale[1], t.scale[2]));
+    }
+    return true;
+}
+
+/**
+ * @brief Serialises `Transforms` as `CookedTransform` records for the pak.
+ */
+std::string MyApp::cookTransforms() const {
+    std::string data(Transforms.size() * sizeof(CookedTransform), '\0');
+    CookedTransform* cooked = reinterpret_cast<CookedTransform*>(&data[0]);
+    for (const auto& entry : Transforms) {
+        if (entry.first.size() >= sizeof(cooked->name)) {
+            std::cerr << "[ERROR] Transform name too long to cook: " << entry.first << std::endl;
+            throw std::runtime_error("Transform name too long to cook.");
+        }
+        CookedTransform& t = *cooked++;
+        std::copy(entry.first.begin(), entry.first.end(), t.name);
+        const TransformTRS& trs = entry.second;
+        for (int k = 0; k < 3; k++) {
+            t.position[k] = trs.position[k];
+            t.scale[k] = trs.scale[k];
+        }
+        t.rotation[0] = trs.rotation.w;
+        t.rotation[1] = trs.rotation.x;
+        t.rotation[2] = trs.rotation.y;
+        t.rotation[3] = trs.rotation.z;
+    }
+    return data;
+}
+
 /**
  * @brief Builds the complete scenegraph for the application.
  *
  * This function creates a hierarchical scenegraph consisting of:
  *  - A static board
- *  - A Pickagram root with global animation
- *  - Individual geometric shapes (square, triangles, parallelogram)
- *
- * Each shape uses a two-node pattern:
- *  - Translation node: handles positional animation
- *  - Rotation/render node: handles rotation and mesh rendering
+ *  - The Pickagram subtree built by `createPickagram()`
  *
- * This separation allows clean hierarchical animation and reuse of transforms.
- * 
- * Sub-shapes are nested as children of their parent translation nodes to maintain relative positioning and not be affected by their parent's rotation.
- * 
- * All shapes are colored distinctly for visual clarity, and use normal shading to distinguish faces.
+ * When a stress run is configured, the Pickagram subtree is instead
+ * instantiated many times by `StressSceneGenerator`, each copy with a board of
+ * its own if `--boards` was given.
  */
 void MyApp::createScenegraph() {
 
@@ -291,22 +444,66 @@ void MyApp::createScenegraph() {
      * Root node of the entire scenegraph.
      * All objects in the scene are attached (directly or indirectly) to this node.
      */
-    Root = new ScenegraphNode();
+    ScenegraphNode* root = ScenegraphNode::create();
+    Root = root->getHandle();
+    ScenegraphNode::setParallelThreshold(Stress.updateThreshold);
+
+    if (Stress.enabled) {
+        StressSceneGenerator generator(Stress);
+        generator.build(root, [this]() {
+            if (!Stress.boards) {
+                return createPickagram();
+            }
+            ScenegraphNode* copy = ScenegraphNode::create();
+            copy->addChild(createBoard());
+            copy->addChild(createPickagram());
+            return copy;
+        });
+        return;
+    }
 
-    // -------------------------------------------------------------------------
-    // Board (static base)
-    // -------------------------------------------------------------------------
-    /**
-     * Represents the wooden board on which the Pickagram pieces are placed.
-     * This node is static and does not animate.
-     */
-    ScenegraphNode* boardNode = new ScenegraphNode(
+    ScenegraphNode* boardNode = createBoard();
+    root->addChild(boardNode);
+    Board = boardNode->getHandle();
+
+    root->addChild(createPickagram());
+}
+
+/**
+ * @brief Creates the wooden board on which the Pickagram pieces are placed.
+ *
+ * The board never moves, so it is flagged static and can be merged into a
+ * static batch (see `setupStaticBatching()`).
+ */
+ScenegraphNode* MyApp::createBoard() {
+    ScenegraphNode* boardNode = ScenegraphNode::create(
         Meshes.at("Cube").get(),
         createShaderPrograms(Meshes.at("Cube").get()),
         Transforms.at("Board_Start"),
         glm::vec4(0.36f, 0.22f, 0.08f, 1.0f) // Brown color
     );
-    Root->addChild(boardNode);
+    boardNode->setStatic(true);
+    return boardNode;
+}
+
+/**
+ * @brief Builds the animated Pickagram subtree and returns its root.
+ *
+ * The subtree consists of:
+ *  - A Pickagram root with global animation
+ *  - Individual geometric shapes (square, triangles, parallelogram)
+ *
+ * Each shape uses a two-node pattern:
+ *  - Translation node: handles positional animation
+ *  - Rotation/render node: handles rotation and mesh rendering
+ *
+ * This separation allows clean hierarchical animation and reuse of transforms.
+ * 
+ * Sub-shapes are nested as children of their parent translation nodes to maintain relative positioning and not be affected by their parent's rotation.
+ * 
+ * All shapes are colored distinctly for visual clarity, and use normal shading to distinguish faces.
+ */
+ScenegraphNode* MyApp::createPickagram() {
 
     // -------------------------------------------------------------------------
     // Pickagram Root (global translation + rotation)
@@ -315,8 +512,7 @@ void MyApp::createScenegraph() {
      * Translation root for the entire Pickagram.
      * Moves the whole puzzle as a single unit.
      */
-    ScenegraphNode* pickagramRoot_translate = new ScenegraphNode();
-    Root->addChild(pickagramRoot_translate);
+    ScenegraphNode* pickagramRoot_translate = ScenegraphNode::create();
     pickagramRoot_translate->setAnimation(
         TransformTRS(),
         Transforms.at("PickagramRoot_Translation_End")
@@ -326,7 +522,7 @@ void MyApp::createScenegraph() {
      * Rotation root for the entire Pickagram.
      * Allows rotating all child shapes together.
      */
-    ScenegraphNode* pickagramRoot_rotate = new ScenegraphNode();
+    ScenegraphNode* pickagramRoot_rotate = ScenegraphNode::create();
     pickagramRoot_rotate->setAnimation(
         TransformTRS(),
         Transforms.at("PickagramRoot_Rotation_End")
@@ -339,7 +535,7 @@ void MyApp::createScenegraph() {
     /**
      * Translation node.
      */
-    ScenegraphNode* square_translate = new ScenegraphNode();
+    ScenegraphNode* square_translate = ScenegraphNode::create();
     square_translate->setAnimation(
         Transforms.at("Square_Translation_Start"),
         Transforms.at("Square_Translation_End")
@@ -349,7 +545,7 @@ void MyApp::createScenegraph() {
     /**
      * Rotation and render node.
      */
-    ScenegraphNode* square_rotate = new ScenegraphNode(
+    ScenegraphNode* square_rotate = ScenegraphNode::create(
         Meshes.at("Square").get(),
         createShaderPrograms(Meshes.at("Square").get()),
         TransformTRS(),
@@ -367,7 +563,7 @@ void MyApp::createScenegraph() {
     /**
      * Translation node.
      */
-    ScenegraphNode* largeTriangle1_translate = new ScenegraphNode();
+    ScenegraphNode* largeTriangle1_translate = ScenegraphNode::create();
     largeTriangle1_translate->setAnimation(
         Transforms.at("BigTriangle1_Translation_Start"),
         Transforms.at("BigTriangle1_Translation_End")
@@ -377,7 +573,7 @@ void MyApp::createScenegraph() {
     /**
      * Rotation and render node.
      */
-    ScenegraphNode* largeTriangle1_rotate = new ScenegraphNode(
+    ScenegraphNode* largeTriangle1_rotate = ScenegraphNode::create(
         Meshes.at("BigTriangle").get(),
         createShaderPrograms(Meshes.at("BigTriangle").get()),
         TransformTRS(),
@@ -395,7 +591,7 @@ void MyApp::createScenegraph() {
     /**
      * Translation node.
      */
-    ScenegraphNode* tallSmallTriangle_translate = new ScenegraphNode();
+    ScenegraphNode* tallSmallTriangle_translate = ScenegraphNode::create();
     tallSmallTriangle_translate->setAnimation(
         Transforms.at("TallSmallTriangle_Translation_Start"),
         Transforms.at("TallSmallTriangle_Translation_End")
@@ -405,7 +601,7 @@ void MyApp::createScenegraph() {
     /**
      * Rotation and render node.
      */
-    ScenegraphNode* tallSmallTriangle_rotate = new ScenegraphNode(
+    ScenegraphNode* tallSmallTriangle_rotate = ScenegraphNode::create(
         Meshes.at("TallSmallTriangle").get(),
         createShaderPrograms(Meshes.at("TallSmallTriangle").get()),
         TransformTRS(),
@@ -423,7 +619,7 @@ void MyApp::createScenegraph() {
     /**
      * Translation node.
      */
-    ScenegraphNode* largeTriangle2_translate = new ScenegraphNode();
+    ScenegraphNode* largeTriangle2_translate = ScenegraphNode::create();
     largeTriangle2_translate->setAnimation(
         Transforms.at("BigTriangle2_Translation_Start"),
         Transforms.at("BigTriangle2_Translation_End")
@@ -433,7 +629,7 @@ void MyApp::createScenegraph() {
     /**
      * Rotation and render node.
      */
-    ScenegraphNode* largeTriangle2_rotate = new ScenegraphNode(
+    ScenegraphNode* largeTriangle2_rotate = ScenegraphNode::create(
         Meshes.at("BigTriangle").get(),
         createShaderPrograms(Meshes.at("BigTriangle").get()),
         Transforms.at("BigTriangle2_Rotation_Start"),
@@ -451,7 +647,7 @@ void MyApp::createScenegraph() {
     /**
      * Translation node.
      */
-    ScenegraphNode* mediumTriangle_translate = new ScenegraphNode();
+    ScenegraphNode* mediumTriangle_translate = ScenegraphNode::create();
     mediumTriangle_translate->setAnimation(
         Transforms.at("MediumTriangle_Translation_Start"),
         Transforms.at("MediumTriangle_Translation_End")
@@ -461,7 +657,7 @@ void MyApp::createScenegraph() {
     /**
      * Rotation and render node.
      */
-    ScenegraphNode* mediumTriangle_rotate = new ScenegraphNode(
+    ScenegraphNode* mediumTriangle_rotate = ScenegraphNode::create(
         Meshes.at("MediumTriangle").get(),
         createShaderPrograms(Meshes.at("MediumTriangle").get()),
         TransformTRS(),
@@ -479,7 +675,7 @@ void MyApp::createScenegraph() {
     /**
      * Translation node.
      */
-    ScenegraphNode* shortSmallTriangle_translate = new ScenegraphNode();
+    ScenegraphNode* shortSmallTriangle_translate = ScenegraphNode::create();
     shortSmallTriangle_translate->setAnimation(
         Transforms.at("ShortSmallTriangle_Translation_Start"),
         Transforms.at("ShortSmallTriangle_Translation_End")
@@ -489,7 +685,7 @@ void MyApp::createScenegraph() {
     /**
      * Rotation and render node.
      */
-    ScenegraphNode* shortSmallTriangle_rotate = new ScenegraphNode(
+    ScenegraphNode* shortSmallTriangle_rotate = ScenegraphNode::create(
         Meshes.at("ShortSmallTriangle").get(),
         createShaderPrograms(Meshes.at("ShortSmallTriangle").get()),
         TransformTRS(),
@@ -507,7 +703,7 @@ void MyApp::createScenegraph() {
     /**
      * Translation node.
      */
-    ScenegraphNode* parallelogram_translate = new ScenegraphNode();
+    ScenegraphNode* parallelogram_translate = ScenegraphNode::create();
     parallelogram_translate->setAnimation(
         Transforms.at("Parallelogram_Translation_Start"),
         Transforms.at("Parallelogram_Translation_End")
@@ -517,7 +713,7 @@ void MyApp::createScenegraph() {
     /**
      * Rotation and render node.
      */
-    ScenegraphNode* parallelogram_rotate = new ScenegraphNode(
+    ScenegraphNode* parallelogram_rotate = ScenegraphNode::create(
         Meshes.at("Parallelogram").get(),
         createShaderPrograms(Meshes.at("Parallelogram").get()),
         TransformTRS(),
@@ -528,13 +724,200 @@ void MyApp::createScenegraph() {
         Transforms.at("Parallelogram_Rotation_End")
     );
     parallelogram_translate->addChild(parallelogram_rotate);
+
+    return pickagramRoot_translate;
 }
 
 
 ////////////////////////////////////////////////////////////////////////// SCENE
 
-void MyApp::drawScene() {
-    Root->draw();
+/**
+ * @brief Describes the current frame (camera, viewport and visible nodes) in `packet`.
+ *
+ * Issues no GL calls; the packet is submitted by `displayCallback()` or, in
+ * threaded mode, by the engine on the GL thread.
+ */
+void MyApp::collectScene(mgl::FramePacket& packet) {
+    const CameraData& camera = Cameras[currentCamera];
+    packet.Camera = Camera;
+    packet.ViewMatrix = camera.ViewMatrix;
+    packet.ProjectionMatrix = camera.isPerspective ? camera.PerspectiveMatrix : camera.OrthoProjectionMatrix;
+    packet.Viewport = Viewport;
+    ScenegraphNode* root = ScenegraphNode::get(Root);
+    if (gpuTransforms) {
+        root->collectTransforms(packet);
+        packet.Transforms = &Hierarchy;
+    }
+    else {
+        root->collect(packet, mgl::Frustum(packet.ProjectionMatrix * packet.ViewMatrix));
+    }
+    packet.sortItems();
+    if (staticBatching) {
+        packet.Statics = &Statics;
+    }
+    if (Streamed) {
+        packet.Streamed.push_back({ StreamedShaders, Streamed.get(), StreamedModel, glm::vec4(0.7f, 0.7f, 0.7f, 1.0f) });
+    }
+    if (gpuAnimation) {
+        packet.Instanced.Animation = &Instances;
+        packet.Instanced.ModelMatrix = root->getLocalTransform();
+        packet.Instanced.Time = renderedAnimationT;
+    }
+}
+
+/**
+ * @brief Moves the animated pieces to the GPU, if `--gpu-animation` was given.
+ *
+ * Every piece below the root becomes an instance whose start/end TRS layers and
+ * phase are uploaded once; the CPU nodes are then destroyed, so per-frame work
+ * and uploads no longer depend on the number of pieces. Picking and frustum
+ * culling do not apply to instances. Scenes that cannot be expressed as
+ * instances keep animating on the CPU.
+ */
+void MyApp::setupGpuAnimation() {
+    ScenegraphNode* root = ScenegraphNode::get(Root);
+    const bool exported = root->exportInstances(Instances,
+        [this](mgl::Mesh* mesh) { return createShaderPrograms(mesh, ModelSource::Instance); });
+    if (!exported) {
+        std::cerr << "[ERROR] Scene cannot be animated on the GPU, animating on the CPU" << std::endl;
+        Instances.clear();
+        return;
+    }
+    Instances.upload();
+    root->destroyChildren();
+    gpuAnimation = true;
+    std::cout << "GPU animation: " << Instances.getInstanceCount() << " instances in "
+        << Instances.getBatchCount() << " batches, " << Instances.getLayerCount() << " layers, "
+        << Instances.getBufferBytes() << " bytes" << std::endl;
+}
+
+/**
+ * @brief Computes world matrices with a compute shader, if `--gpu-transforms` was given.
+ *
+ * The scenegraph is flattened into a `mgl::TransformHierarchy` and mesh nodes
+ * switch to programs that read their world matrix from it, so a frame uploads
+ * only the local transforms that changed. The result is checked against the
+ * CPU at a few animation times first; on a mismatch the CPU path is kept.
+ * Frustum culling does not apply while the GPU computes the transforms.
+ */
+void MyApp::setupGpuTransforms() {
+    ScenegraphNode* root = ScenegraphNode::get(Root);
+    root->buildTransformHierarchy(Hierarchy,
+        [this](mgl::Mesh* mesh) { return createShaderPrograms(mesh, ModelSource::Hierarchy); });
+    Hierarchy.create("hierarchy-cs.glsl");
+
+    float error = 0.0f;
+    for (float t : { 0.0f, 0.37f, 1.0f }) {
+        error = glm::max(error, validateGpuTransforms(t));
+    }
+    root->updateAnimation(renderedAnimationT);
+    std::cout << "GPU transforms: " << Hierarchy.getNodeCount() << " nodes in "
+        << Hierarchy.getLevelCount() << " levels, " << Hierarchy.getBufferBytes()
+        << " bytes, max error vs CPU " << error << std::endl;
+    if (error > 1e-4f) {
+        std::cerr << "[ERROR] GPU transforms do not match the CPU, computing them on the CPU" << std::endl;
+        // Rebuilding swaps the regular programs back in, and has to start from an empty hierarchy
+        Hierarchy.clear();
+        root->buildTransformHierarchy(Hierarchy,
+            [this](mgl::Mesh* mesh) { return createShaderPrograms(mesh); });
+        Hierarchy.clear();
+        return;
+    }
+    gpuTransforms = true;
+}
+
+/**
+ * @brief Animates the scene to `t` on both paths and returns the largest relative difference of a world matrix.
+ */
+float MyApp::validateGpuTransforms(float t) {
+    ScenegraphNode* root = ScenegraphNode::get(Root);
+    root->updateAnimation(t);
+    mgl::FramePacket packet;
+    root->collectTransforms(packet);
+    Hierarchy.update(packet.TransformUpdates);
+    Hierarchy.propagate();
+    std::vector<glm::mat4> worlds;
+    Hierarchy.readWorlds(worlds);
+
+    float error = 0.0f;
+    root->forEachMesh([&](ScenegraphNode& node, mgl::Mesh&, const glm::mat4& world) {
+        const glm::mat4& gpu = worlds[node.getTransformIndex()];
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                const float expected = world[column][row];
+                error = glm::max(error, glm::abs(gpu[column][row] - expected) / glm::max(1.0f, glm::abs(expected)));
+            }
+        }
+    });
+    return error;
+}
+
+/**
+ * @brief Merges the static nodes into one draw per shader and colour, if `--static-batching` was given.
+ *
+ * Static nodes are pre-transformed to world space; a batch is only rebuilt
+ * when one of its nodes moves or is highlighted. Batching relies on the CPU
+ * transforms, so it is skipped when the GPU animates or transforms the scene.
+ * It is also skipped for `--color position`, which colours by the model-space
+ * position that batching replaces with the world-space one.
+ */
+void MyApp::setupStaticBatching() {
+    if (gpuAnimation || gpuTransforms) {
+        std::cerr << "[ERROR] Static batching needs the CPU transforms, drawing static nodes one by one" << std::endl;
+        return;
+    }
+    if (Stress.colorDefine == "COLOR_POSITION") {
+        std::cerr << "[ERROR] Static batching loses the model-space positions --color position reads, drawing static nodes one by one" << std::endl;
+        return;
+    }
+    // Batching reads the mesh arrays, which only settle once their uploads are published
+    mgl::UploadQueue::getInstance().finish();
+    ScenegraphNode::get(Root)->buildStaticBatches(Statics);
+    Statics.upload();
+    staticBatching = true;
+    std::cout << "Static batching: " << Statics.getMemberCount() << " nodes in "
+        << Statics.getBatchCount() << " batches, " << Statics.getBufferBytes() << " bytes" << std::endl;
+}
+
+/**
+ * @brief Opens the cluster file given with `--stream` and fits it over the board.
+ *
+ * The model is streamed within `--stream-budget` of GPU memory as the camera moves.
+ */
+void MyApp::setupStreaming() {
+    Streamed.reset(new mgl::StreamedMesh());
+    Streamed->setMemoryBudget(Stress.streamBudget);
+    Streamed->open(Stress.streamFile);
+
+    mgl::ShaderDefines defines = { { Stress.colorDefine, "" } };
+    if (Streamed->hasNormals()) {
+        defines["HAS_NORMALS"] = "";
+    }
+    if (Streamed->hasTexcoords()) {
+        defines["HAS_TEXCOORDS"] = "";
+    }
+    const mgl::ShaderSources sources = {
+        { GL_VERTEX_SHADER, "cube-vs.glsl" }, { GL_FRAGMENT_SHADER, "cube-fs.glsl" } };
+    StreamedShaders = ShaderVariants.get(sources, defines, [this](mgl::ShaderProgram& program) {
+        program.addAttribute(mgl::POSITION_ATTRIBUTE, mgl::StreamedMesh::POSITION);
+        if (Streamed->hasNormals()) {
+            program.addAttribute(mgl::NORMAL_ATTRIBUTE, mgl::StreamedMesh::NORMAL);
+        }
+        if (Streamed->hasTexcoords()) {
+            program.addAttribute(mgl::TEXCOORD_ATTRIBUTE, mgl::StreamedMesh::TEXCOORD);
+        }
+        program.addUniform(mgl::MODEL_MATRIX);
+        program.addUniform(mgl::COLOR_ATTRIBUTE);
+        program.addUniformBlock(mgl::CAMERA_BLOCK, UBO_BP);
+    }, PendingShaders.get());
+
+    const mgl::BoundingBox& bounds = Streamed->getBoundingBox();
+    const glm::vec3 size = bounds.size();
+    const float extent = glm::max(glm::max(size.x, size.y), glm::max(size.z, 1e-6f));
+    StreamedModel = glm::scale(glm::mat4(1.0f), glm::vec3(20.0f / extent))
+        * glm::translate(glm::mat4(1.0f), -bounds.center());
+    std::cout << "Streaming " << Stress.streamFile << ": " << Streamed->getClusterCount() << " clusters, "
+        << Streamed->getSlotCount() << " resident at most, " << Streamed->getGpuBytes() << " GPU bytes" << std::endl;
 }
 
 ////////////////////////////////////////////////////////////////////// CAMERA
@@ -564,12 +947,14 @@ void MyApp::createCamera() {
     camera.ViewMatrix = ViewMatrix1;
     camera.PerspectiveMatrix = ProjectionMatrix2;
     camera.OrthoProjectionMatrix = OrthoMatrix;
+    camera.previousRot = glm::quat(1, 0, 0, 0);
     camera.currentRot = glm::quat(1, 0, 0, 0);
     camera.targetRot = glm::quat(1, 0, 0, 0);
     camera.orbitRadius = 70.0f;
     Cameras.push_back(camera);
 
     camera.ViewMatrix = ViewMatrix2;
+    camera.previousRot = glm::angleAxis(glm::radians(-90.0f), glm::vec3(1, 0, 0));
     camera.currentRot = glm::angleAxis(glm::radians(-90.0f), glm::vec3(1, 0, 0));
     camera.targetRot = glm::angleAxis(glm::radians(-90.0f), glm::vec3(1, 0, 0));
     camera.orbitRadius = 35.0f;
@@ -580,56 +965,138 @@ void MyApp::createCamera() {
     Camera->setProjectionMatrix(Cameras[currentCamera].PerspectiveMatrix);
 }
 
-void MyApp::updateCamera() {
-    // Projection matrix update
-    if (Cameras[currentCamera].isPerspective) {
-        Camera->setProjectionMatrix(Cameras[currentCamera].PerspectiveMatrix);
+/**
+ * @brief Advances `camera` towards its target orientation by one simulation step.
+ *
+ * Closes 10% of the remaining angle per 1/60 s regardless of the step size, so
+ * the camera feels the same at any simulation rate. The rotation snaps to the
+ * target once close enough, so a settled camera stops requesting redraws.
+ */
+void MyApp::updateCamera(CameraData& camera, double dt) {
+    camera.previousRot = camera.currentRot;
+    if (glm::abs(glm::dot(camera.currentRot, camera.targetRot)) > 0.999999f) {
+        camera.currentRot = camera.targetRot;
     }
     else {
-        Camera->setProjectionMatrix(Cameras[currentCamera].OrthoProjectionMatrix);
+        const float factor = 1.0f - static_cast<float>(std::pow(0.9, dt * 60.0));
+        camera.currentRot = glm::slerp(camera.currentRot, camera.targetRot, factor);
     }
+}
 
-    // View matrix update
-    Cameras[currentCamera].currentRot = glm::slerp(Cameras[currentCamera].currentRot, Cameras[currentCamera].targetRot, 0.1f);
-    Cameras[currentCamera].ViewMatrix = glm::lookAt(
-        Cameras[currentCamera].currentRot * glm::vec3(0.0f, 0.0f, Cameras[currentCamera].orbitRadius),
+/**
+ * @brief Sets the view matrix of `camera` between its last two simulated orientations.
+ *
+ * Only updates `Cameras`; the matrices reach the GPU when the frame packet is submitted.
+ */
+void MyApp::updateViewMatrix(CameraData& camera, float alpha) {
+    const glm::quat rotation = glm::slerp(camera.previousRot, camera.currentRot, alpha);
+    camera.ViewMatrix = glm::lookAt(
+        rotation * glm::vec3(0.0f, 0.0f, camera.orbitRadius),
         glm::vec3(0.0f, 0.0f, 0.0f),
-        Cameras[currentCamera].currentRot * glm::vec3(0.0f, 1.0f, 0.0f)
+        rotation * glm::vec3(0.0f, 1.0f, 0.0f)
     );
-    Camera->setViewMatrix(Cameras[currentCamera].ViewMatrix);
-
-    // Redraw scene
-    drawScene();
 }
 
 ////////////////////////////////////////////////////////////////////// CALLBACKS
 
 void MyApp::initCallback(GLFWwindow* win) {
+    const double startTime = glfwGetTime();
+    PendingShaders = std::make_unique<mgl::ShaderBatch>();
+    PendingShaders->setParallel(Stress.parallelShaders);
     glDisable(GL_CULL_FACE);
     createMeshes();
     createCamera();
-    transformations();
+    if (!loadTransforms()) {
+        transformations();
+    }
     createScenegraph();
+    if (Stress.gpuAnimation) {
+        setupGpuAnimation();
+    }
+    if (Stress.gpuTransforms && !gpuAnimation) {
+        setupGpuTransforms();
+    }
+    if (Stress.staticBatching) {
+        setupStaticBatching();
+    }
+    if (!Stress.streamFile.empty()) {
+        setupStreaming();
+    }
+    PendingShaders->wait();
+    if (Stress.enabled) {
+        std::cout << "Startup: " << PendingShaders->getCreatedCount() << " shader programs, "
+            << 1000.0 * (glfwGetTime() - startTime) << " ms ("
+            << (PendingShaders->isParallel() ? "parallel" : "serial") << " compilation)";
+        if (mgl::Pak::getInstance().isOpen()) {
+            std::cout << ", assets from " << mgl::Pak::getInstance().getFilename();
+        }
+        std::cout << std::endl;
+    }
+    PendingShaders.reset();
+    const mgl::Engine& engine = mgl::Engine::getInstance();
+    Viewport = glm::ivec4(0, 0, engine.WindowWidth, engine.WindowHeight);
 }
 
 void MyApp::windowSizeCallback(GLFWwindow* win, int winx, int winy) {
-    glViewport(0, 0, winx, winy);
+    Viewport = glm::ivec4(0, 0, winx, winy);
     float aspect = static_cast<float>(winx) / static_cast<float>(winy);
     Cameras[0].PerspectiveMatrix =
         glm::perspective(glm::radians(30.0f), aspect, 1.0f, 500.0f);
     Cameras[1].PerspectiveMatrix =
         glm::perspective(glm::radians(30.0f), aspect, 1.0f, 500.0f);
-    updateCamera();
 }
 
 void MyApp::displayCallback(GLFWwindow* win, double elapsed) {
-    animationT += animationDirection * animationSpeed * elapsed;
+    Packet.clear();
+    simulateCallback(win, elapsed, Packet);
+    Packet.submit();
+}
 
-    animationT = glm::clamp(animationT, 0.0f, 1.0f);
+/**
+ * @brief Advances animation and cameras by one simulation step of `dt` seconds.
+ *
+ * The previous state is kept so frames can be drawn between steps.
+ */
+void MyApp::fixedUpdateCallback(GLFWwindow* win, double dt) {
+    processInput();
+    previousAnimationT = animationT;
+    if (Stress.enabled) {
+        // Stress runs animate unattended so every frame exercises the update path
+        stressTime += animationSpeed * dt;
+        animationT = 1.0f - glm::abs(1.0f - static_cast<float>(glm::mod(stressTime, 2.0)));
+    }
+    else {
+        animationT += animationDirection * animationSpeed * static_cast<float>(dt);
+        animationT = glm::clamp(animationT, 0.0f, 1.0f);
+    }
+    for (CameraData& camera : Cameras) {
+        updateCamera(camera, dt);
+    }
+}
 
-    Root->updateAnimation(animationT);
-	processInput();
-    drawScene();
+void MyApp::simulateCallback(GLFWwindow* win, double elapsed, mgl::FramePacket& packet) {
+    mgl::Engine& engine = mgl::Engine::getInstance();
+    const float alpha = static_cast<float>(engine.getInterpolationAlpha());
+
+    const double animationStart = glfwGetTime();
+    ScenegraphNode* root = ScenegraphNode::get(Root);
+    renderedAnimationT = glm::mix(previousAnimationT, animationT, alpha);
+    root->updateAnimation(renderedAnimationT);
+    mgl::currentFrameStats().AnimationTime += glfwGetTime() - animationStart;
+    updateViewMatrix(Cameras[currentCamera], alpha);
+    Picker.update(root);
+    collectScene(packet);
+
+    // In on-demand mode, only keep drawing while something is still moving
+    const CameraData& camera = Cameras[currentCamera];
+    const bool animating = Stress.enabled
+        || (animationDirection > 0 && animationT < 1.0f)
+        || (animationDirection < 0 && animationT > 0.0f)
+        || previousAnimationT != animationT;
+    const bool cameraMoving = camera.currentRot != camera.targetRot || camera.previousRot != camera.currentRot;
+    if (animating || cameraMoving) {
+        engine.requestRedraw();
+    }
 }
 
 /*
@@ -641,7 +1108,6 @@ void MyApp::keyCallback(GLFWwindow* win, int key, int scancode, int action, int
         keys[key] = true;
         if (key == GLFW_KEY_C) {
             currentCamera = (currentCamera + 1) % Cameras.size();
-            Camera->setViewMatrix(Cameras[currentCamera].ViewMatrix);
         }
         if (key == GLFW_KEY_P) {
             if (Cameras[currentCamera].isPerspective) {
@@ -655,7 +1121,6 @@ void MyApp::keyCallback(GLFWwindow* win, int key, int scancode, int action, int
     else if (action == GLFW_RELEASE) {
         keys[key] = false;
     }
-    updateCamera();
 }
 /**
  * @brief Processes input for keys that have hold down mechanics.
@@ -673,7 +1138,7 @@ void MyApp::mouseButtonCallback(GLFWwindow* win, int button, int action, int mod
     if (button == GLFW_MOUSE_BUTTON_RIGHT) {
         if (action == GLFW_PRESS) {
             rightMouseDown = true;
-            glfwGetCursorPos(win, &lastMouseX, &lastMouseY);
+            mgl::Engine::getInstance().getCursorPos(&lastMouseX, &lastMouseY);
         }
         else if (action == GLFW_RELEASE) {
             rightMouseDown = false;
@@ -682,7 +1147,8 @@ void MyApp::mouseButtonCallback(GLFWwindow* win, int button, int action, int mod
     if (button == GLFW_MOUSE_BUTTON_LEFT) {
         if (action == GLFW_PRESS) {
             leftMouseDown = true;
-            glfwGetCursorPos(win, &lastMouseX, &lastMouseY);
+            mgl::Engine::getInstance().getCursorPos(&lastMouseX, &lastMouseY);
+            pickPiece(lastMouseX, lastMouseY);
         }
         else if (action == GLFW_RELEASE) {
             leftMouseDown = false;
@@ -690,6 +1156,90 @@ void MyApp::mouseButtonCallback(GLFWwindow* win, int button, int action, int mod
 	}
 }
 
+/**
+ * @brief Prints how many nodes animate and how much memory their tracks take.
+ */
+void MyApp::reportAnimation() const {
+    size_t nodes = 0, bytes = 0;
+    ScenegraphNode::get(Root)->animationFootprint(nodes, bytes);
+    std::cout << "  animated nodes:      " << nodes << ", " << bytes << " bytes";
+    if (nodes > 0) {
+        std::cout << " (" << bytes / nodes << " bytes/node)";
+    }
+    std::cout << std::endl;
+}
+
+/**
+ * @brief Prints how much of the `--stream` model was resident and streamed, if any.
+ */
+void MyApp::reportStreaming() const {
+    if (!Streamed) {
+        return;
+    }
+    std::cout << "Streamed " << Streamed->getStreamedBytes() << " bytes, "
+        << Streamed->getResidentCount() << " of " << Streamed->getClusterCount()
+        << " clusters resident, " << Streamed->getDrawnCount() << " drawn last frame" << std::endl;
+}
+
+/**
+ * @brief Cooks the startup assets into the pak `filename`, without a window.
+ *
+ * Meshes are loaded and processed as `createMeshes()` does and stored ready to
+ * upload, shaders as their source text and the named transforms of
+ * `transformations()` as the scene entry. Loose files are not read again once
+ * the pak is mounted with `--pak`.
+ */
+void MyApp::cookPak(const std::string& filename) {
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+    mgl::PakWriter pak;
+    for (const auto& file : MESH_FILES) {
+        mgl::Mesh mesh;
+        mesh.joinIdenticalVertices();
+        mesh.load(MESH_DIR + file);
+        pak.add(MESH_DIR + file, mgl::PakType::Mesh, mesh.cook());
+    }
+    for (const auto& file : SHADER_FILES) {
+        pak.addFile(file, mgl::PakType::Shader);
+    }
+    transformations();
+    pak.add(SCENE_ENTRY, mgl::PakType::Scene, cookTransforms());
+    pak.write(filename);
+    std::cout << "Cooked " << pak.getEntryCount() << " assets into " << filename << ": "
+        << pak.getDataSize() << " bytes of data, "
+        << std::chrono::duration<double, std::milli>(Clock::now() - start).count() << " ms" << std::endl;
+}
+
+/**
+ * @brief Casts a ray from the cursor and highlights the piece it hits first.
+ *
+ * Queries the index refitted on the last simulated frame, i.e. what is on screen.
+ * The board is not a piece; clicking it (or empty space) clears the selection.
+ */
+void MyApp::pickPiece(double xpos, double ypos) {
+    const CameraData& camera = Cameras[currentCamera];
+    const glm::mat4 projection = camera.isPerspective ? camera.PerspectiveMatrix : camera.OrthoProjectionMatrix;
+    const mgl::Ray ray = mgl::Ray::fromScreen(
+        glm::vec2(static_cast<float>(xpos), static_cast<float>(ypos)), Viewport, projection * camera.ViewMatrix);
+
+    PickResult result = Picker.pick(ray);
+    if (result.hit() && result.node->getHandle() == Board) {
+        result.node = nullptr;
+    }
+
+    // The previous selection may have been destroyed since
+    ScenegraphNode* previous = ScenegraphNode::get(pickedNode);
+    if (previous) {
+        previous->setHighlighted(false);
+    }
+    pickedNode = result.hit() ? result.node->getHandle() : NodeHandle();
+    if (result.hit()) {
+        result.node->setHighlighted(true);
+        std::cout << "Picked triangle " << result.triangle << " at distance " << result.distance
+            << " (" << result.microseconds << " us)" << std::endl;
+    }
+}
+
 void MyApp::cursorCallback(GLFWwindow* win, double xpos, double ypos) {
     if (rightMouseDown) {
         float dx = static_cast<float>(xpos - lastMouseX);
@@ -706,8 +1256,6 @@ void MyApp::cursorCallback(GLFWwindow* win, double xpos, double ypos) {
         Cameras[currentCamera].targetRot = qPitch * Cameras[currentCamera].targetRot;
         lastMouseX = xpos;
         lastMouseY = ypos;
-
-        updateCamera();
     }
     if (leftMouseDown) {
         float dx = static_cast<float>(xpos - lastMouseX);
@@ -723,7 +1271,7 @@ void MyApp::cursorCallback(GLFWwindow* win, double xpos, double ypos) {
             camRight * dx * 0.1f +
             camForward * dy * 0.1f;
 
-		Root->setPosition((movement));
+		ScenegraphNode::get(Root)->setPosition((movement));
 
         lastMouseX = xpos;
         lastMouseY = ypos;
@@ -738,18 +1286,119 @@ void MyApp::scrollCallback(GLFWwindow* win, double xoffset, double yoffset) {
     if (Cameras[currentCamera].orbitRadius > 95.0f) {
         Cameras[currentCamera].orbitRadius = 95.0f;
     }
-    updateCamera();
 }
 
 /////////////////////////////////////////////////////////////////////////// MAIN
 
+/**
+ * @brief Applies engine-level command line options.
+ *
+ * --record FILE captures the input of the session to a binary log.
+ * --replay FILE drives the callbacks frame by frame from such a log, using the
+ * recorded frame times or a fixed --timestep DT.
+ * --threaded simulates the next frame on a second thread while this one renders.
+ * --async-uploads creates GPU buffers on an upload thread with a shared context.
+ * --gl MAJOR.MINOR requests that OpenGL context version instead of 4.6; 3.3
+ * is enough for the default scene.
+ * --no-dsa edits buffers and vertex arrays by binding them, as on 3.3 contexts,
+ * instead of through direct state access.
+ * --frames-in-flight N caps how far the CPU may run ahead of the GPU (0 disables).
+ * --fps N limits the frame rate.
+ * --on-demand only redraws when input arrives or the scene is still moving.
+ * --sim-rate HZ sets the simulation rate (0 steps once per frame instead).
+ * --stats-window N sets how many frames the rolling statistics cover.
+ * --stats-csv FILE writes every frame's render counters to FILE on exit.
+ */
+static void applyEngineArgs(int argc, char* argv[], mgl::Engine& engine) {
+    std::string replayFile;
+    double replayTimestep = 0.0;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--record" && hasValue) engine.recordInput(argv[++i]);
+        else if (arg == "--replay" && hasValue) replayFile = argv[++i];
+        else if (arg == "--timestep" && hasValue) replayTimestep = std::stod(argv[++i]);
+        else if (arg == "--threaded") engine.setThreaded(true);
+        else if (arg == "--async-uploads") engine.setAsyncUploads(true);
+        else if (arg == "--gl" && hasValue) {
+            const std::string version = argv[++i];
+            const std::size_t dot = version.find('.');
+            engine.setOpenGL(std::stoi(version.substr(0, dot)),
+                dot == std::string::npos ? 0 : std::stoi(version.substr(dot + 1)));
+        }
+        else if (arg == "--no-dsa") mgl::setDirectStateAccess(false);
+        else if (arg == "--frames-in-flight" && hasValue) engine.setMaxFramesInFlight(std::stoul(argv[++i]));
+        else if (arg == "--fps" && hasValue) engine.setTargetFrameRate(std::stod(argv[++i]));
+        else if (arg == "--on-demand") engine.setOnDemand(true);
+        else if (arg == "--sim-rate" && hasValue) {
+            const double rate = std::stod(argv[++i]);
+            engine.setFixedTimestep(rate > 0.0 ? 1.0 / rate : 0.0);
+        }
+        else if (arg == "--stats-window" && hasValue) engine.setStatsWindow(std::stoul(argv[++i]));
+        else if (arg == "--stats-csv" && hasValue) engine.dumpStatsCsv(argv[++i]);
+    }
+    if (!replayFile.empty()) {
+        engine.replayInput(replayFile, replayTimestep);
+    }
+}
+
 int main(int argc, char* argv[]) {
+    StressSceneConfig stress;
+    parseStressArgs(argc, argv, stress);
+    if (stress.bvhBenchNodes > 0) {
+        runBVHBenchmark(stress);
+        exit(EXIT_SUCCESS);
+    }
+    if (stress.jobBenchItems > 0) {
+        runJobBenchmark(stress);
+        exit(EXIT_SUCCESS);
+    }
+    if (stress.objBenchTriangles > 0) {
+        runObjBenchmark(stress);
+        exit(EXIT_SUCCESS);
+    }
+    if (stress.meshBenchTriangles > 0) {
+        runMeshBenchmark(stress);
+        exit(EXIT_SUCCESS);
+    }
+    if (!stress.clusterObj.empty()) {
+        runClusterBuild(stress);
+        exit(EXIT_SUCCESS);
+    }
+    if (!stress.cookPak.empty()) {
+        (new MyApp(stress))->cookPak(stress.cookPak);
+        exit(EXIT_SUCCESS);
+    }
+    if (!stress.pakFile.empty()) {
+        mgl::Pak::getInstance().open(stress.pakFile);
+    }
+
     mgl::Engine& engine = mgl::Engine::getInstance();
-    engine.setApp(new MyApp());
+    MyApp* app = new MyApp(stress);
+    engine.setApp(app);
     engine.setOpenGL(4, 6);
-    engine.setWindow(800, 600, "Hello Modern 3D World", 0, 1);
+    engine.setFixedTimestep(1.0 / 60.0);
+    applyEngineArgs(argc, argv, engine);
+    if (stress.enabled) {
+        // Uncapped frame rate so frame times reflect the cost of the scene
+        engine.setWindow(800, 600, "Pickagram Stress Scene", 0, 0);
+        engine.setHeadless(stress.headless);
+        engine.setFrameLimit(stress.frames);
+    }
+    else {
+        engine.setWindow(800, 600, "Hello Modern 3D World", 0, 1);
+    }
     engine.init();
     engine.run();
+    app->reportStreaming();
+    if (stress.enabled) {
+        reportStressRun(stress, engine);
+        app->reportAnimation();
+    }
+    else if (engine.isOnDemand()) {
+        std::cout << "Frames rendered: " << engine.getFrameCount()
+            << ", frames skipped: " << engine.getFramesSkipped() << std::endl;
+    }
     exit(EXIT_SUCCESS);
 }
 
@@ -0,0 +1,61 @@
+#include "ScenePicker.h"
+
+#include <chrono>
+
+void ScenePicker::update(ScenegraphNode* root) {
+	std::vector<Target> current;
+	current.reserve(targets.size());
+	root->forEachMesh([&](ScenegraphNode& node, mgl::Mesh& mesh, const glm::mat4& world) {
+		current.push_back({ node.getHandle(), &mesh, world });
+	});
+
+	if (current.size() != targets.size()) {
+		tree.clear();
+		for (const Target& target : current) {
+			tree.insert(target.mesh->getBoundingBox().transform(target.world));
+		}
+	}
+	else {
+		for (unsigned int proxy = 0; proxy < current.size(); proxy++) {
+			const Target& target = current[proxy];
+			if (target.node != targets[proxy].node || target.world != targets[proxy].world) {
+				tree.update(proxy, target.mesh->getBoundingBox().transform(target.world));
+			}
+		}
+	}
+	targets.swap(current);
+	tree.refit();
+}
+
+PickResult ScenePicker::pick(const mgl::Ray& ray) const {
+	const auto start = std::chrono::steady_clock::now();
+	PickResult result;
+	std::vector<mgl::ProxyHit> hits;
+	tree.raycast({ ray }, hits, [&](unsigned int proxy, const mgl::Ray& ray, float& distance) {
+		const Target& target = targets[proxy];
+		// The model-space ray keeps world distances, so hits compare directly
+		mgl::RayHit hit;
+		hit.Distance = distance;
+		if (!target.mesh->intersect(ray.transform(glm::inverse(target.world)), hit)) {
+			return false;
+		}
+		distance = hit.Distance;
+		result.triangle = hit.Triangle;
+		return true;
+	});
+	if (hits[0].isHit()) {
+		result.node = ScenegraphNode::get(targets[hits[0].Proxy].node);
+		result.distance = hits[0].Distance;
+	}
+	result.microseconds = std::chrono::duration<double, std::micro>(
+		std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+ScenegraphNode* ScenePicker::getNode(unsigned int proxy) const {
+	return ScenegraphNode::get(targets[proxy].node);
+}
+
+const mgl::DynamicBVH& ScenePicker::getTree() const {
+	return tree;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cfloat>
+#include <vector>
+#include "../mgl/mgl.hpp"
+#include "ScenegraphNode.h"
+
+/**
+ * @brief Closest piece under a ray.
+ */
+typedef struct PickResult {
+	ScenegraphNode* node = nullptr;
+	unsigned int triangle = 0;   // index into the node mesh's triangles
+	float distance = FLT_MAX;    // world units along the ray
+	double microseconds = 0.0;   // time spent in the query
+
+	bool hit() const { return node != nullptr; }
+} PickResult;
+
+/**
+ * @brief Spatial index over the mesh nodes of a scenegraph.
+ *
+ * Keeps a dynamic BVH over the world bounds of every mesh node, refitted each
+ * frame as animation moves the pieces. Rays are narrowed to a few candidates
+ * by the BVH and each candidate is then tested in model space against the
+ * triangle BVH its mesh built at load time. The tree also answers overlap,
+ * frustum and nearest-neighbour queries through `getTree()`.
+ */
+class ScenePicker {
+	public:
+		/**
+		 * @brief Captures the world transforms of `root`'s mesh nodes and refits the index.
+		 *
+		 * The node set is matched by traversal order; if it changes size, every
+		 * proxy is re-inserted, otherwise proxies whose node or transform changed
+		 * are updated.
+		 */
+		void update(ScenegraphNode* root);
+		/** @brief Returns the closest hit along a world-space ray. */
+		PickResult pick(const mgl::Ray& ray) const;
+		/** @brief Node owning a proxy returned by the tree's queries, null if it was destroyed. */
+		ScenegraphNode* getNode(unsigned int proxy) const;
+		const mgl::DynamicBVH& getTree() const;
+
+	private:
+		typedef struct Target {
+			NodeHandle node;
+			mgl::Mesh* mesh;
+			glm::mat4 world;
+		} Target;
+
+		std::vector<Target> targets;    // indexed by proxy
+		mgl::DynamicBVH tree;
+};
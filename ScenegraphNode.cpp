@@ -1,15 +1,8 @@
 #include "ScenegraphNode.h"
 
+#include <algorithm>
+#include <deque>
 
-static glm::mat4 interpolateTRS(TransformTRS& a, TransformTRS& b, float t) {
-	glm::vec3 pos = glm::mix(a.position, b.position, t);
-	glm::vec3 scale = glm::mix(a.scale, b.scale, t);
-	glm::quat rot = glm::slerp(a.rotation, b.rotation, t);
-
-	return glm::translate(glm::mat4(1.0f), pos)
-		* glm::mat4_cast(rot)
-		* glm::scale(glm::mat4(1.0f), scale);
-}
 
 ScenegraphNode::ScenegraphNode(mgl::Mesh* mesh, mgl::ShaderProgram* shaders, TransformTRS transformTRS, glm::vec4 color) {
 	Mesh = mesh;
@@ -18,61 +11,367 @@ ScenegraphNode::ScenegraphNode(mgl::Mesh* mesh, mgl::ShaderProgram* shaders, Tra
 					* glm::mat4_cast(transformTRS.rotation)
 					* glm::scale(glm::mat4(1.0f), transformTRS.scale);
 	this->color = color;
-	start = transformTRS;
-	end = transformTRS;
+}
+
+size_t ScenegraphNode::parallelThreshold = 4096;
+
+// Constructed on first use, so nodes can be created during static initialization
+static NodePool& pool() {
+	static NodePool nodes;
+	return nodes;
+}
+
+ScenegraphNode* ScenegraphNode::create() {
+	const NodeHandle handle = pool().create();
+	ScenegraphNode* node = pool().get(handle);
+	node->handle = handle;
+	return node;
+}
+
+ScenegraphNode* ScenegraphNode::create(mgl::Mesh* mesh, mgl::ShaderProgram* shaders, TransformTRS transformTRS, glm::vec4 color) {
+	const NodeHandle handle = pool().create(mesh, shaders, transformTRS, color);
+	ScenegraphNode* node = pool().get(handle);
+	node->handle = handle;
+	return node;
+}
+
+void ScenegraphNode::destroy(NodeHandle handle) {
+	ScenegraphNode* node = pool().get(handle);
+	if (node == nullptr) return;
+	node->detach();
+	node->destroySubtree();
+}
+
+void ScenegraphNode::destroySubtree() {
+	ScenegraphNode* child = firstChild;
+	while (child != nullptr) {
+		ScenegraphNode* next = child->nextSibling;
+		child->destroySubtree();
+		child = next;
+	}
+	pool().destroy(handle);
+}
+
+ScenegraphNode* ScenegraphNode::get(NodeHandle handle) {
+	return pool().get(handle);
+}
+
+const NodePool& ScenegraphNode::getPool() {
+	return pool();
+}
+
+NodeHandle ScenegraphNode::getHandle() const {
+	return handle;
+}
+
+ScenegraphNode* ScenegraphNode::getParent() const {
+	return parent;
+}
+
+const glm::mat4& ScenegraphNode::getLocalTransform() const {
+	return localTransform;
+}
+
+void ScenegraphNode::destroyChildren() {
+	while (firstChild != nullptr) {
+		destroy(firstChild->handle);
+	}
 }
 
 void ScenegraphNode::addChild(ScenegraphNode* child) {
-	this->children.push_back(std::unique_ptr<ScenegraphNode>(child));
+	child->detach();
 	child->parent = this;
+	child->previousSibling = lastChild;
+	if (lastChild != nullptr) lastChild->nextSibling = child;
+	else firstChild = child;
+	lastChild = child;
+	for (ScenegraphNode* node = this; node != nullptr; node = node->parent) {
+		node->subtreeSize += child->subtreeSize;
+	}
 }
 
-void ScenegraphNode::draw() {
-	if (!(Shaders == nullptr || Mesh == nullptr)) {
-		// Compute global transform
-		glm::mat4 globalTransform = localTransform;
-		ScenegraphNode* p = parent;
-		while (p != nullptr) {
-			globalTransform = p->localTransform * globalTransform;
-			p = p->parent;
+void ScenegraphNode::detach() {
+	if (parent == nullptr) return;
+	if (previousSibling != nullptr) previousSibling->nextSibling = nextSibling;
+	else parent->firstChild = nextSibling;
+	if (nextSibling != nullptr) nextSibling->previousSibling = previousSibling;
+	else parent->lastChild = previousSibling;
+	for (ScenegraphNode* node = parent; node != nullptr; node = node->parent) {
+		node->subtreeSize -= subtreeSize;
+	}
+	parent = previousSibling = nextSibling = nullptr;
+}
+
+size_t ScenegraphNode::getSubtreeSize() const {
+	return subtreeSize;
+}
+
+void ScenegraphNode::collect(mgl::FramePacket& packet, const mgl::Frustum& frustum, const glm::mat4& parentTransform, bool parentMoved) {
+	const glm::mat4 globalTransform = parentTransform * localTransform;
+	const bool moved = parentMoved || transformDirty;
+	transformDirty = false;
+	mgl::FrameStats& stats = mgl::currentFrameStats();
+	stats.NodesTraversed++;
+
+	if (staticIndex != mgl::StaticBatches::NONE) {
+		// Highlighted members leave their batch, as it has a single colour
+		if (moved || staticVisible == highlighted) {
+			staticVisible = !highlighted;
+			packet.StaticUpdates.push_back({ static_cast<GLuint>(staticIndex), globalTransform, staticVisible });
+		}
+	}
+	if (!(Shaders == nullptr || Mesh == nullptr) && !(staticIndex != mgl::StaticBatches::NONE && staticVisible)) {
+		if (frustum.intersects(Mesh->getBoundingBox().transform(globalTransform))) {
+			const glm::vec4 drawColor = highlighted ? glm::mix(color, glm::vec4(1.0f), 0.5f) : color;
+			packet.Items.push_back({ Shaders, Mesh, globalTransform, drawColor });
+		}
+		else {
+			stats.NodesCulled++;
 		}
+	}
 
-		Shaders->bind();
-		GLint ModelMatrixId = Shaders->Uniforms[mgl::MODEL_MATRIX].index;
-		GLint ColorId = Shaders->Uniforms[mgl::COLOR_ATTRIBUTE].index;
-		glUniformMatrix4fv(ModelMatrixId, 1, GL_FALSE, glm::value_ptr(globalTransform));
-		glUniform4fv(ColorId, 1, glm::value_ptr(color));
-		if (Mesh != nullptr) Mesh->draw();
-		Shaders->unbind();
+	// Collect children
+	for (ScenegraphNode* child = firstChild; child != nullptr; child = child->nextSibling) {
+		child->collect(packet, frustum, globalTransform, moved);
 	}
+}
 
-	// Draw children
-	for (auto& child : children) {
-		child->draw();
+void ScenegraphNode::setStatic(bool isStatic) {
+	staticNode = isStatic;
+}
+
+bool ScenegraphNode::isStatic() const {
+	return staticNode;
+}
+
+void ScenegraphNode::buildStaticBatches(mgl::StaticBatches& batches, const glm::mat4& parentTransform) {
+	const glm::mat4 globalTransform = parentTransform * localTransform;
+	staticIndex = mgl::StaticBatches::NONE;
+	staticVisible = true;
+	if (staticNode && Mesh != nullptr && Shaders != nullptr) {
+		staticIndex = batches.addMember(Mesh, Shaders, color, globalTransform);
+	}
+	for (ScenegraphNode* child = firstChild; child != nullptr; child = child->nextSibling) {
+		child->buildStaticBatches(batches, globalTransform);
 	}
 }
 
+void ScenegraphNode::forEachMesh(const std::function<void(ScenegraphNode&, mgl::Mesh&, const glm::mat4&)>& visit,
+	const glm::mat4& parentTransform) {
+	const glm::mat4 globalTransform = parentTransform * localTransform;
+	if (Mesh != nullptr) {
+		visit(*this, *Mesh, globalTransform);
+	}
+	for (ScenegraphNode* child = firstChild; child != nullptr; child = child->nextSibling) {
+		child->forEachMesh(visit, globalTransform);
+	}
+}
+
+void ScenegraphNode::animationFootprint(size_t& nodes, size_t& bytes) const {
+	if (track) {
+		nodes++;
+		bytes += track->getMemoryUsage();
+	}
+	for (ScenegraphNode* child = firstChild; child != nullptr; child = child->nextSibling) {
+		child->animationFootprint(nodes, bytes);
+	}
+}
+
+void ScenegraphNode::setHighlighted(bool highlighted) {
+	this->highlighted = highlighted;
+}
+
 void ScenegraphNode::setPosition(const glm::vec3& position) {
 	localTransform = glm::translate(glm::mat4(1.0f), position) * localTransform;
+	transformDirty = true;
 }
 
 void ScenegraphNode::setRotation(float angle, const glm::vec3& axis) {
 	localTransform = glm::rotate(glm::mat4(1.0f), glm::radians(angle), axis) * localTransform;
+	transformDirty = true;
 }
 
 void ScenegraphNode::setScale(const glm::vec3& scale) {
 	localTransform = glm::scale(glm::mat4(1.0f), scale) * localTransform;
+	transformDirty = true;
 }
 
 void ScenegraphNode::setAnimation(TransformTRS start, TransformTRS end) {
-	this->start = start;
-	this->end = end;
-	isAnimated = true;
+	const std::vector<float> both = { 0.0f, 1.0f }, one = { 0.0f };
+	std::unique_ptr<mgl::AnimationTrack> track(new mgl::AnimationTrack());
+	if (start.position != end.position) track->Translation = mgl::VectorChannel(both, { start.position, end.position });
+	else if (start.position != glm::vec3(0.0f)) track->Translation = mgl::VectorChannel(one, { start.position });
+	if (start.rotation != end.rotation) track->Rotation = mgl::RotationChannel(both, { start.rotation, end.rotation });
+	else if (start.rotation != glm::quat(1.0f, 0.0f, 0.0f, 0.0f)) track->Rotation = mgl::RotationChannel(one, { start.rotation });
+	if (start.scale != end.scale) track->Scale = mgl::VectorChannel(both, { start.scale, end.scale });
+	else if (start.scale != glm::vec3(1.0f)) track->Scale = mgl::VectorChannel(one, { start.scale });
+	setAnimationTrack(std::move(track));
+}
+
+void ScenegraphNode::setAnimationTrack(std::unique_ptr<mgl::AnimationTrack> track) {
+	this->track = std::move(track);
+}
+
+void ScenegraphNode::setAnimationPhase(float phase) {
+	this->phase = phase;
+}
+
+void ScenegraphNode::setParallelThreshold(size_t nodes) {
+	parallelThreshold = nodes;
+}
+
+/**
+ * @brief Updates this node's own transform; returns the t its children see.
+ */
+float ScenegraphNode::animateLocal(float t) {
+	if (phase != 0.0f) {
+		// Ping-pong keeps phased copies moving back and forth inside [0,1]
+		t = 1.0f - glm::abs(1.0f - glm::mod(t + phase, 2.0f));
+	}
+	if (track) {
+		const glm::mat4 local = track->evaluate(t);
+		if (local != localTransform) {
+			localTransform = local;
+			transformDirty = true;
+		}
+	}
+	return t;
+}
+
+void ScenegraphNode::updateSubtree(float t) {
+	t = animateLocal(t);
+	for (ScenegraphNode* child = firstChild; child != nullptr; child = child->nextSibling) {
+		child->updateSubtree(t);
+	}
+}
+
+/**
+ * @brief Updates the nodes above the cut and lists the subtrees of at most `grain` nodes below it.
+ */
+void ScenegraphNode::splitUpdate(float t, size_t grain, std::vector<std::pair<ScenegraphNode*, float>>& pieces) {
+	t = animateLocal(t);
+	for (ScenegraphNode* child = firstChild; child != nullptr; child = child->nextSibling) {
+		if (child->subtreeSize <= grain) {
+			pieces.push_back({ child, t });
+		}
+		else {
+			child->splitUpdate(t, grain, pieces);
+		}
+	}
+}
+
+bool ScenegraphNode::exportInstances(mgl::InstancedAnimation& instances,
+	const std::function<mgl::ShaderProgram*(mgl::Mesh*)>& shadersFor) const {
+	if (track || phase != 0.0f) return false;
+	std::vector<mgl::AnimationLayer> layers;
+	for (ScenegraphNode* child = firstChild; child != nullptr; child = child->nextSibling) {
+		if (!child->exportSubtree(instances, shadersFor, glm::mat4(1.0f), 0.0f, layers)) return false;
+	}
+	return true;
+}
+
+bool ScenegraphNode::exportSubtree(mgl::InstancedAnimation& instances,
+	const std::function<mgl::ShaderProgram*(mgl::Mesh*)>& shadersFor,
+	const glm::mat4& base, float phase, std::vector<mgl::AnimationLayer>& layers) const {
+	glm::mat4 nodeBase = base;
+	if (this->phase != 0.0f) {
+		// The shader applies one ping-pong, before any layer
+		if (phase != 0.0f || !layers.empty()) return false;
+		phase = this->phase;
+	}
+	if (track) {
+		mgl::AnimationLayer layer;
+		if (!track->getLayer(layer)) return false;
+		layers.push_back(layer);
+	}
+	else if (layers.empty()) {
+		nodeBase = base * localTransform;
+	}
+	else if (localTransform != glm::mat4(1.0f)) {
+		return false;
+	}
+
+	if (Mesh != nullptr && Shaders != nullptr) {
+		instances.addInstance(Mesh, shadersFor(Mesh), color, nodeBase, phase, layers);
+	}
+	bool exported = true;
+	for (ScenegraphNode* child = firstChild; child != nullptr && exported; child = child->nextSibling) {
+		exported = child->exportSubtree(instances, shadersFor, nodeBase, phase, layers);
+	}
+	if (track) layers.pop_back();
+	return exported;
+}
+
+void ScenegraphNode::buildTransformHierarchy(mgl::TransformHierarchy& transforms,
+	const std::function<mgl::ShaderProgram*(mgl::Mesh*)>& shadersFor) {
+	// Breadth first, so every depth level is one dispatch over a contiguous range
+	std::deque<ScenegraphNode*> queue = { this };
+	while (!queue.empty()) {
+		ScenegraphNode* node = queue.front();
+		queue.pop_front();
+		const GLint parentIndex = node == this ? -1 : node->parent->transformIndex;
+		node->transformIndex = static_cast<GLint>(transforms.addNode(parentIndex, node->localTransform));
+		node->transformDirty = false;
+		if (node->Mesh != nullptr && node->Shaders != nullptr) {
+			node->Shaders = shadersFor(node->Mesh);
+		}
+		for (ScenegraphNode* child = node->firstChild; child != nullptr; child = child->nextSibling) {
+			queue.push_back(child);
+		}
+	}
+}
+
+void ScenegraphNode::collectTransforms(mgl::FramePacket& packet) {
+	mgl::currentFrameStats().NodesTraversed++;
+	// Nodes added after buildTransformHierarchy have no slot in the hierarchy
+	if (transformDirty && transformIndex >= 0) {
+		packet.TransformUpdates.push_back({ static_cast<GLuint>(transformIndex), localTransform });
+		transformDirty = false;
+	}
+	if (!(Shaders == nullptr || Mesh == nullptr)) {
+		const glm::vec4 drawColor = highlighted ? glm::mix(color, glm::vec4(1.0f), 0.5f) : color;
+		packet.Items.push_back({ Shaders, Mesh, glm::mat4(1.0f), drawColor, transformIndex });
+	}
+	for (ScenegraphNode* child = firstChild; child != nullptr; child = child->nextSibling) {
+		child->collectTransforms(packet);
+	}
+}
+
+GLint ScenegraphNode::getTransformIndex() const {
+	return transformIndex;
 }
 
 void ScenegraphNode::updateAnimation(float t) {
-	if (isAnimated) localTransform = interpolateTRS(start, end, t);
-	for (auto& child : children) {
-		child->updateAnimation(t);
+	updateAnimation(t, mgl::JobSystem::getInstance());
+}
+
+void ScenegraphNode::updateAnimation(float t, mgl::JobSystem& jobs) {
+	if (parallelThreshold == 0 || subtreeSize < parallelThreshold || jobs.getThreadCount() == 1) {
+		updateSubtree(t);
+		return;
 	}
+
+	// Nodes only read the t handed down by their parent, so subtrees are independent
+	const size_t grain = std::max<size_t>(256, subtreeSize / (8 * jobs.getThreadCount()));
+	std::vector<std::pair<ScenegraphNode*, float>> pieces;
+	splitUpdate(t, grain, pieces);
+
+	// Batch consecutive small subtrees into jobs of about `grain` nodes
+	std::vector<size_t> batches = { 0 };
+	size_t batchSize = 0;
+	for (size_t i = 0; i < pieces.size(); i++) {
+		batchSize += pieces[i].first->subtreeSize;
+		if (batchSize >= grain) {
+			batches.push_back(i + 1);
+			batchSize = 0;
+		}
+	}
+	if (batches.back() != pieces.size()) {
+		batches.push_back(pieces.size());
+	}
+	jobs.parallelFor(0, batches.size() - 1, 1, [&](size_t first, size_t last) {
+		for (size_t i = batches[first]; i < batches[last]; i++) {
+			pieces[i].first->updateSubtree(pieces[i].second);
+		}
+	});
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <memory>
 #include "../mgl/mgl.hpp"
 
@@ -20,53 +21,177 @@ typedef struct TransformTRS {
 	TransformTRS() = default;
 } TransformTRS;
 
-/**
- * @brief Interpolates between two TRS transforms and returns a composed matrix.
- * @param a Start transform.
- * @param b End transform.
- * @param t Blend factor [0,1].
- * @return Interpolated model matrix.
- */
-static glm::mat4 interpolateTRS(TransformTRS& a, TransformTRS& b, float t);
+class ScenegraphNode;
+
+/** @brief Reference to a scenegraph node that resolves to null once the node is destroyed. */
+typedef mgl::Handle<ScenegraphNode> NodeHandle;
+
+/** @brief Storage of all scenegraph nodes. */
+typedef mgl::Pool<ScenegraphNode> NodePool;
 
 /**
  * @brief Scene graph node that can render a mesh and manage hierarchical transforms.
  *
- * Supports local transforms, color, child nodes, and optional animation between
- * two TRS states driven by a parameter t in [0,1].
+ * Supports local transforms, color, child nodes, and an optional keyframed
+ * animation track driven by a parameter t, usually in [0,1].
+ *
+ * Nodes are allocated from a shared pool with `create()` and freed with
+ * `destroy()`. Pointers to a node stay valid until it is destroyed; references
+ * that must survive that, e.g. a selection, should hold a `NodeHandle`.
+ * Children are kept in an intrusive list, so adding, removing and reparenting
+ * are constant time apart from updating the subtree sizes of the ancestors.
  */
 class ScenegraphNode {
 	public:
+		/** @brief Creates an empty group node. */
+		static ScenegraphNode* create();
+		/** @brief Creates a renderable node with mesh, shaders, base transform and color. */
+		static ScenegraphNode* create(mgl::Mesh* mesh, mgl::ShaderProgram* shaders, TransformTRS transformTRS, glm::vec4 color);
+		/** @brief Detaches the node from its parent and destroys it with its subtree; stale handles are ignored. */
+		static void destroy(NodeHandle handle);
+		/** @brief Returns the node, or null if it was destroyed. */
+		static ScenegraphNode* get(NodeHandle handle);
+		static const NodePool& getPool();
+
+		ScenegraphNode(const ScenegraphNode&) = delete;
+		ScenegraphNode& operator=(const ScenegraphNode&) = delete;
+		NodeHandle getHandle() const;
+		ScenegraphNode* getParent() const;
+		/** @brief Appends `child` to this node's children, moving it from its previous parent if any. */
+		void addChild(ScenegraphNode* child);
+		/** @brief Detaches this node from its parent, leaving it as the root of its own tree. */
+		void detach();
+		/** @brief Destroys every descendant of this node. */
+		void destroyChildren();
+		const glm::mat4& getLocalTransform() const;
 		/**
-		 * @brief Constructs a renderable node with mesh, shaders, base transform and color.
+		 * @brief Appends a draw item for this node and its visible descendants.
+		 *
+		 * World transforms are composed top-down from `parentTransform`; nodes whose
+		 * mesh bounds fall outside `frustum` are skipped. Nodes in a static batch
+		 * are drawn by it instead, and only add an update to the packet when they
+		 * or an ancestor moved, or their highlight changed. Issues no GL calls, so
+		 * it can run on the simulation thread.
 		 */
-		ScenegraphNode(mgl::Mesh* mesh, mgl::ShaderProgram* shaders, TransformTRS transformTRS, glm::vec4 color);
-		ScenegraphNode() = default;
-		/** @brief Adds a child node to this node. */
-		void addChild(ScenegraphNode* child);
-		/** @brief Draws this node and recursively draws children. */
-		void draw();
+		void collect(mgl::FramePacket& packet, const mgl::Frustum& frustum,
+			const glm::mat4& parentTransform = glm::mat4(1.0f), bool parentMoved = false);
+		/**
+		 * @brief Calls `visit` with every node that has a mesh, along with its world transform.
+		 */
+		void forEachMesh(const std::function<void(ScenegraphNode&, mgl::Mesh&, const glm::mat4&)>& visit,
+			const glm::mat4& parentTransform = glm::mat4(1.0f));
+		/** @brief Marks the node as one that does not move, so `buildStaticBatches()` can merge it. */
+		void setStatic(bool isStatic);
+		bool isStatic() const;
+		/**
+		 * @brief Adds every static mesh node of this subtree to `batches`, at its current world transform.
+		 *
+		 * Nodes whose mesh arrays are not kept on the CPU stay drawn on their own.
+		 * Highlighted members are taken out of their batch and drawn on their own
+		 * while highlighted. Destroying a member leaves it in its batch, so the
+		 * batches have to be built again afterwards.
+		 */
+		void buildStaticBatches(mgl::StaticBatches& batches, const glm::mat4& parentTransform = glm::mat4(1.0f));
+		/** @brief Draws this node brightened, e.g. while it is picked. */
+		void setHighlighted(bool highlighted);
 		/** @brief Sets local position component of the transform. */
 		void setPosition(const glm::vec3& position);
 		/** @brief Sets local rotation from axis-angle. */
 		void setRotation(float angle, const glm::vec3& axis);
 		/** @brief Sets local scale component of the transform. */
 		void setScale(const glm::vec3& scale);
-		/** @brief Defines start/end TRS states for animation. */
+		/**
+		 * @brief Animates between two TRS states over t in [0,1].
+		 *
+		 * Builds a two-key track; channels that do not change get a single key.
+		 */
 		void setAnimation(TransformTRS start, TransformTRS end);
-		/** @brief Updates node animation using blend factor t in [0,1]. */
+		/** @brief Replaces the node's animation with a keyframed track (null stops animating). */
+		void setAnimationTrack(std::unique_ptr<mgl::AnimationTrack> track);
+		/**
+		 * @brief Evaluates the animation tracks of this subtree at t.
+		 *
+		 * Subtrees of at least `setParallelThreshold()` nodes are split into
+		 * independent pieces that update on the job system's worker threads. Every
+		 * node still computes exactly what the serial traversal would.
+		 */
 		void updateAnimation(float t);
+		/** @brief As `updateAnimation(t)`, on the threads of `jobs` instead of the shared job system. */
+		void updateAnimation(float t, mgl::JobSystem& jobs);
+		/** @brief Smallest subtree that updates in parallel; 0 always updates serially. */
+		static void setParallelThreshold(size_t nodes);
+		/** @brief Number of nodes in this subtree, including this one. */
+		size_t getSubtreeSize() const;
+		/** @brief Adds the number of animated nodes in this subtree and the bytes their tracks use. */
+		void animationFootprint(size_t& nodes, size_t& bytes) const;
+		/** @brief Offsets the blend factor seen by this node and its subtree (ping-pong wrapped). */
+		void setAnimationPhase(float phase);
+		/**
+		 * @brief Adds every mesh node below this one to `instances`, to be animated on the GPU.
+		 *
+		 * Each instance is relative to this node, whose own transform becomes the
+		 * model matrix of the draw. Static ancestors of a piece fold into its base
+		 * matrix, and its animated ancestors become its layers; above the first
+		 * animated node there may be one phase. `shadersFor` picks the instanced
+		 * program of a mesh. Returns false, leaving `instances` partly filled, if
+		 * this node animates or a piece cannot be expressed that way.
+		 */
+		bool exportInstances(mgl::InstancedAnimation& instances,
+			const std::function<mgl::ShaderProgram*(mgl::Mesh*)>& shadersFor) const;
+		/**
+		 * @brief Adds this subtree to `transforms` breadth first, so its world matrices can be computed on the GPU.
+		 *
+		 * Mesh nodes switch to the program `shadersFor` returns, which must read
+		 * their world matrix from the hierarchy instead of the model matrix.
+		 */
+		void buildTransformHierarchy(mgl::TransformHierarchy& transforms,
+			const std::function<mgl::ShaderProgram*(mgl::Mesh*)>& shadersFor);
+		/**
+		 * @brief Like `collect()` for a subtree added to a transform hierarchy.
+		 *
+		 * Draw items refer to the world matrices of the hierarchy, which are not
+		 * known on the CPU, so nothing is culled. Only the local transforms that
+		 * changed since the last call are added to the packet's updates.
+		 */
+		void collectTransforms(mgl::FramePacket& packet);
+		/** @brief Index of this node in its transform hierarchy, or -1. */
+		GLint getTransformIndex() const;
 		
 	private:
+		friend NodePool;
+		ScenegraphNode() = default;
+		ScenegraphNode(mgl::Mesh* mesh, mgl::ShaderProgram* shaders, TransformTRS transformTRS, glm::vec4 color);
+
 		const GLuint UBO_BP = 0;
 		mgl::ShaderProgram* Shaders = nullptr;
 		mgl::Mesh* Mesh = nullptr;
-		std::vector<std::unique_ptr<ScenegraphNode>> children;
+		NodeHandle handle;
 		ScenegraphNode* parent = nullptr;
+		ScenegraphNode* firstChild = nullptr;
+		ScenegraphNode* lastChild = nullptr;
+		ScenegraphNode* previousSibling = nullptr;
+		ScenegraphNode* nextSibling = nullptr;
 		glm::mat4 localTransform = glm::mat4(1.0f);
 		glm::vec4 color = glm::vec4(1.0f);
-		TransformTRS start;
-		TransformTRS end;;
-		bool isAnimated = false;
+		std::unique_ptr<mgl::AnimationTrack> track;
+		float phase = 0.0f;
+		bool highlighted = false;
+		size_t subtreeSize = 1;
+		GLint transformIndex = -1;
+		bool transformDirty = false;
+		bool staticNode = false;
+		GLint staticIndex = mgl::StaticBatches::NONE;
+		bool staticVisible = true;
+
+		static size_t parallelThreshold;
+
+		void destroySubtree();
+		bool exportSubtree(mgl::InstancedAnimation& instances,
+			const std::function<mgl::ShaderProgram*(mgl::Mesh*)>& shadersFor,
+			const glm::mat4& base, float phase, std::vector<mgl::AnimationLayer>& layers) const;
+
+		float animateLocal(float t);
+		void updateSubtree(float t);
+		void splitUpdate(float t, size_t grain, std::vector<std::pair<ScenegraphNode*, float>>& pieces);
 };
 
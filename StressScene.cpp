@@ -0,0 +1,670 @@
+#include "StressScene.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void stressUsage(const std::string& error) {
+	std::cerr << "[ERROR] " << error << std::endl
+		<< "Usage: --stress N [--layout grid|random] [--depth D] [--fanout F]" << std::endl
+		<< "       [--spacing S] [--seed S] [--frames N] [--no-phase] [--headless]" << std::endl
+		<< "       [--update-threshold N] [--gpu-animation]" << std::endl
+		<< "       [--gpu-transforms] [--serial-shaders]" << std::endl
+		<< "       [--boards] [--static-batching]" << std::endl
+		<< "       [--color constant|position|uv|normal|diffuse|shade]" << std::endl
+		<< "       [--mesh-residency release|keep|mapped]" << std::endl
+		<< "       --bvh-bench N [--seed S] [--frames N]" << std::endl
+		<< "       --jobs-bench N [--frames N]" << std::endl
+		<< "       --obj-bench N [--frames N]" << std::endl
+		<< "       --mesh-bench N [--frames N]" << std::endl
+		<< "       --cluster-obj IN OUT" << std::endl
+		<< "       [--stream FILE] [--stream-budget MB]" << std::endl
+		<< "       --cook-pak OUT" << std::endl
+		<< "       [--pak FILE]" << std::endl;
+	exit(EXIT_FAILURE);
+}
+
+void parseStressArgs(int argc, char* argv[], StressSceneConfig& config) {
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		auto value = [&]() -> std::string {
+			if (i + 1 >= argc) stressUsage("Missing value for " + arg);
+			return argv[++i];
+		};
+		try {
+			if (arg == "--stress") {
+				config.enabled = true;
+				config.copies = std::stoul(value());
+			}
+			else if (arg == "--layout") {
+				const std::string layout = value();
+				if (layout == "grid") config.layout = StressLayout::Grid;
+				else if (layout == "random") config.layout = StressLayout::Random;
+				else stressUsage("Unknown layout " + layout);
+			}
+			else if (arg == "--depth") config.depth = std::stoul(value());
+			else if (arg == "--fanout") config.fanout = std::stoul(value());
+			else if (arg == "--spacing") config.spacing = std::stof(value());
+			else if (arg == "--seed") config.seed = std::stoul(value());
+			else if (arg == "--frames") config.frames = std::stoull(value());
+			else if (arg == "--no-phase") config.phased = false;
+			else if (arg == "--headless") config.headless = true;
+			else if (arg == "--gpu-animation") config.gpuAnimation = true;
+			else if (arg == "--gpu-transforms") config.gpuTransforms = true;
+			else if (arg == "--serial-shaders") config.parallelShaders = false;
+			else if (arg == "--boards") config.boards = true;
+			else if (arg == "--static-batching") config.staticBatching = true;
+			else if (arg == "--color") {
+				const std::string color = value();
+				const char* colors[] = { "constant", "position", "uv", "normal", "diffuse", "shade" };
+				if (std::find(std::begin(colors), std::end(colors), color) == std::end(colors)) {
+					stressUsage("Unknown color " + color);
+				}
+				std::string define = "COLOR_" + color;
+				std::transform(define.begin(), define.end(), define.begin(), ::toupper);
+				config.colorDefine = define;
+			}
+			else if (arg == "--update-threshold") config.updateThreshold = std::stoul(value());
+			else if (arg == "--mesh-residency") {
+				const std::string residency = value();
+				if (residency == "release") config.meshResidency = mgl::MeshResidency::Release;
+				else if (residency == "keep") config.meshResidency = mgl::MeshResidency::Keep;
+				else if (residency == "mapped") config.meshResidency = mgl::MeshResidency::Mapped;
+				else stressUsage("Unknown mesh residency " + residency);
+			}
+			else if (arg == "--cluster-obj") {
+				config.clusterObj = value();
+				config.clusterFile = value();
+			}
+			else if (arg == "--stream") config.streamFile = value();
+			else if (arg == "--stream-budget") config.streamBudget = std::stoull(value()) << 20;
+			else if (arg == "--cook-pak") config.cookPak = value();
+			else if (arg == "--pak") config.pakFile = value();
+			else if (arg == "--bvh-bench") config.bvhBenchNodes = std::stoul(value());
+			else if (arg == "--jobs-bench") config.jobBenchItems = std::stoul(value());
+			else if (arg == "--obj-bench") config.objBenchTriangles = std::stoul(value());
+			else if (arg == "--mesh-bench") config.meshBenchTriangles = std::stoul(value());
+		}
+		catch (const std::logic_error&) {
+			stressUsage("Invalid value for " + arg);
+		}
+	}
+	if (config.enabled && (config.copies == 0 || config.fanout == 0)) {
+		stressUsage("--stress and --fanout must be positive");
+	}
+}
+
+StressSceneGenerator::StressSceneGenerator(const StressSceneConfig& config)
+	: config(config) {}
+
+void StressSceneGenerator::build(ScenegraphNode* parent, const std::function<ScenegraphNode*()>& createCopy) {
+	// Grow the group hierarchy level by level, never wider than the copy count
+	std::vector<ScenegraphNode*> level = { parent };
+	for (unsigned int d = 0; d < config.depth && level.size() < config.copies; d++) {
+		std::vector<ScenegraphNode*> next;
+		for (ScenegraphNode* group : level) {
+			for (unsigned int f = 0; f < config.fanout && next.size() < config.copies; f++) {
+				ScenegraphNode* child = ScenegraphNode::create();
+				group->addChild(child);
+				next.push_back(child);
+			}
+		}
+		level.swap(next);
+	}
+
+	std::mt19937 rng(config.seed);
+	for (unsigned int i = 0; i < config.copies; i++) {
+		// Copies animate their own roots, so placement and phase live on a wrapper node
+		ScenegraphNode* placement = ScenegraphNode::create();
+		placement->setPosition(copyPosition(i, rng));
+		if (config.phased) placement->setAnimationPhase(copyPhase(i, rng));
+		placement->addChild(createCopy());
+		level[i % level.size()]->addChild(placement);
+	}
+}
+
+glm::vec3 StressSceneGenerator::copyPosition(unsigned int index, std::mt19937& rng) const {
+	const unsigned int side = static_cast<unsigned int>(glm::ceil(glm::sqrt(static_cast<float>(config.copies))));
+	const float half = (side - 1) * config.spacing * 0.5f;
+	if (config.layout == StressLayout::Random) {
+		std::uniform_real_distribution<float> coord(-half, half);
+		const float x = coord(rng);
+		return glm::vec3(x, 0.0f, coord(rng));
+	}
+	return glm::vec3((index % side) * config.spacing - half, 0.0f, (index / side) * config.spacing - half);
+}
+
+float StressSceneGenerator::copyPhase(unsigned int index, std::mt19937& rng) const {
+	// A full ping-pong cycle spans [0,2)
+	if (config.layout == StressLayout::Random) {
+		return std::uniform_real_distribution<float>(0.0f, 2.0f)(rng);
+	}
+	return 2.0f * index / config.copies;
+}
+
+void runBVHBenchmark(const StressSceneConfig& config) {
+	typedef std::chrono::steady_clock Clock;
+	auto ms = [](Clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+	};
+	const unsigned int n = config.bvhBenchNodes;
+	const unsigned int batch = 256, k = 8;
+	const float extent = 10.0f * glm::sqrt(static_cast<float>(n));
+
+	std::mt19937 rng(config.seed);
+	std::uniform_real_distribution<float> coord(-extent, extent), unit(-1.0f, 1.0f);
+	std::vector<glm::vec3> origins(n), velocities(n);
+	for (unsigned int i = 0; i < n; i++) {
+		origins[i] = glm::vec3(coord(rng), 0.1f * coord(rng), coord(rng));
+		velocities[i] = glm::vec3(unit(rng), unit(rng), unit(rng));
+	}
+	auto boxAt = [&](unsigned int i, float time) {
+		// Pieces oscillate around their origin, like the ping-pong animation
+		const glm::vec3 center = origins[i] + 20.0f * glm::sin(time) * velocities[i];
+		mgl::BoundingBox box;
+		box.extend(center - glm::vec3(1.0f));
+		box.extend(center + glm::vec3(1.0f));
+		return box;
+	};
+
+	mgl::DynamicBVH tree;
+	std::vector<mgl::BoundingBox> boxes(n);
+	for (unsigned int i = 0; i < n; i++) {
+		boxes[i] = boxAt(i, 0.0f);
+		tree.insert(boxes[i]);
+	}
+	Clock::time_point start = Clock::now();
+	tree.refit();
+	const double buildTime = ms(start);
+
+	const unsigned long long frames = std::max<unsigned long long>(config.frames, 1);
+	double refitTime = 0.0, rayTime = 0.0, overlapTime = 0.0, cullTime = 0.0, nearestTime = 0.0;
+	double rayScanTime = 0.0, overlapScanTime = 0.0;
+	unsigned long long scannedFrames = 0, mismatches = 0;
+	std::vector<mgl::Ray> rays(batch);
+	std::vector<mgl::BoundingBox> regions(batch);
+	std::vector<glm::vec3> points(batch);
+	std::vector<mgl::ProxyHit> hits;
+	std::vector<std::vector<unsigned int>> found;
+	for (unsigned long long frame = 0; frame < frames; frame++) {
+		const float time = 0.05f * frame;
+		for (unsigned int i = 0; i < n; i++) {
+			boxes[i] = boxAt(i, time);
+			tree.update(i, boxes[i]);
+		}
+		start = Clock::now();
+		tree.refit();
+		refitTime += ms(start);
+
+		for (unsigned int q = 0; q < batch; q++) {
+			rays[q].Origin = glm::vec3(coord(rng), 100.0f, coord(rng));
+			rays[q].Direction = glm::normalize(glm::vec3(0.2f * unit(rng), -1.0f, 0.2f * unit(rng)));
+			const glm::vec3 center(coord(rng), 0.0f, coord(rng));
+			regions[q] = mgl::BoundingBox();
+			regions[q].extend(center - glm::vec3(25.0f));
+			regions[q].extend(center + glm::vec3(25.0f));
+			points[q] = center;
+		}
+
+		start = Clock::now();
+		tree.raycast(rays, hits);
+		rayTime += ms(start);
+		start = Clock::now();
+		tree.overlap(regions, found);
+		overlapTime += ms(start);
+
+		// The linear scans are slow, so only every tenth frame is checked
+		if (frame % 10 == 0) {
+			scannedFrames++;
+			start = Clock::now();
+			for (unsigned int q = 0; q < batch; q++) {
+				float closest = FLT_MAX;
+				for (unsigned int i = 0; i < n; i++) {
+					mgl::BVHNode node;
+					node.Min = boxes[i].Min;
+					node.Max = boxes[i].Max;
+					float t;
+					if (node.intersect(rays[q].Origin, 1.0f / rays[q].Direction, closest, t)) closest = t;
+				}
+				if (closest != hits[q].Distance) mismatches++;
+			}
+			rayScanTime += ms(start);
+			start = Clock::now();
+			for (unsigned int q = 0; q < batch; q++) {
+				size_t count = 0;
+				for (unsigned int i = 0; i < n; i++) {
+					const mgl::BoundingBox& box = boxes[i];
+					if (glm::all(glm::lessThanEqual(box.Min, regions[q].Max)) &&
+						glm::all(glm::greaterThanEqual(box.Max, regions[q].Min))) count++;
+				}
+				if (count != found[q].size()) mismatches++;
+			}
+			overlapScanTime += ms(start);
+		}
+
+		const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 50.0f, extent), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		const glm::mat4 projection = glm::perspective(glm::radians(30.0f), 4.0f / 3.0f, 1.0f, 4.0f * extent);
+		start = Clock::now();
+		tree.cull({ mgl::Frustum(projection * view) }, found);
+		cullTime += ms(start);
+
+		start = Clock::now();
+		tree.nearest(points, k, found);
+		nearestTime += ms(start);
+	}
+
+	std::cout << "Scene BVH benchmark: " << n << " moving nodes, " << frames << " frames, batches of " << batch << std::endl;
+	std::cout << "  initial build (ms):  " << buildTime << std::endl;
+	std::cout << "  refit/frame (ms):    " << refitTime / frames << " (" << tree.getRebuildCount()
+		<< " rebuilds, SAH cost x" << tree.getCostRatio() << " of last build)" << std::endl;
+	std::cout << "  rays/batch (ms):     " << rayTime / frames << ", linear scan " << rayScanTime / scannedFrames << std::endl;
+	std::cout << "  overlaps/batch (ms): " << overlapTime / frames << ", linear scan " << overlapScanTime / scannedFrames << std::endl;
+	std::cout << "  frustum cull (ms):   " << cullTime / frames << std::endl;
+	std::cout << "  " << k << "-nearest/batch (ms): " << nearestTime / frames << std::endl;
+	std::cout << "  mismatches:          " << mismatches << std::endl;
+}
+
+/** @brief Path of a benchmark input in the temp directory rather than next to the executable. */
+static std::string benchFilePath(const std::string& name) {
+	for (const char* variable : { "TMPDIR", "TEMP", "TMP" }) {
+		const char* directory = std::getenv(variable);
+		if (directory != nullptr && *directory != '\0') {
+			return std::string(directory) + "/" + name;
+		}
+	}
+#ifdef _WIN32
+	return name;
+#else
+	return "/tmp/" + name;
+#endif
+}
+
+typedef std::chrono::steady_clock BenchClock;
+
+/** @brief Milliseconds since `since`. */
+static double benchMs(BenchClock::time_point since) {
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - since).count();
+}
+
+/** @brief File benchmarks repeat up to five times, fewer if --frames asks for fewer. */
+static unsigned long long benchRuns(const StressSceneConfig& config) {
+	return std::max<unsigned long long>(std::min<unsigned long long>(config.frames, 5), 1);
+}
+
+/**
+ * @brief Writes a textured grid of `side` x `side` quads over a 100 x 100 sine landscape.
+ *
+ * Shared vertices come with normals and quad faces; otherwise every triangle
+ * gets its own vertices and no normals, as exporters without indexing write them.
+ */
+static void writeGridObj(const std::string& filename, unsigned int side, bool sharedVertices) {
+	std::ofstream out(filename);
+	out << std::fixed << std::setprecision(6);
+	auto vertex = [&](unsigned int x, unsigned int z) {
+		const float u = static_cast<float>(x) / side, v = static_cast<float>(z) / side;
+		out << "v " << 100.0f * u << " " << glm::sin(20.0f * u) * glm::cos(20.0f * v) << " " << 100.0f * v << "\n"
+			<< "vt " << u << " " << v << "\n";
+	};
+	if (sharedVertices) {
+		for (unsigned int z = 0; z <= side; z++) {
+			for (unsigned int x = 0; x <= side; x++) {
+				vertex(x, z);
+				out << "vn 0.0 1.0 0.0\n";
+			}
+		}
+		for (unsigned int z = 0; z < side; z++) {
+			for (unsigned int x = 0; x < side; x++) {
+				const unsigned int a = z * (side + 1) + x + 1, b = a + 1, c = a + side + 2, d = a + side + 1;
+				out << "f " << a << "/" << a << "/1 " << b << "/" << b << "/1 " << c << "/" << c << "/1 "
+					<< d << "/" << d << "/1\n";
+			}
+		}
+		return;
+	}
+	unsigned int index = 0;
+	for (unsigned int z = 0; z < side; z++) {
+		for (unsigned int x = 0; x < side; x++) {
+			const unsigned int corners[6][2] = { {x, z}, {x + 1, z}, {x + 1, z + 1}, {x, z}, {x + 1, z + 1}, {x, z + 1} };
+			for (const auto& corner : corners) {
+				vertex(corner[0], corner[1]);
+			}
+			for (unsigned int t = 0; t < 2; t++, index += 3) {
+				out << "f " << index + 1 << "/" << index + 1 << " " << index + 2 << "/" << index + 2 << " "
+					<< index + 3 << "/" << index + 3 << "\n";
+			}
+		}
+	}
+}
+
+/** @brief Prints the Assimp, 1 thread and all threads rows, with throughput if `megabytes` is given, and the mismatches. */
+static void printBenchRows(double assimpTime, double serialTime, double parallelTime, unsigned long long runs,
+	unsigned long long mismatches, double megabytes = 0.0) {
+	auto row = [&](const std::string& name, double time) {
+		std::cout << "  " << std::left << std::setw(21) << name << std::right << std::setw(10) << time / runs << " ms, ";
+		if (megabytes > 0.0) {
+			std::cout << std::setw(8) << megabytes / (time / runs / 1000.0) << " MB/s, ";
+		}
+		std::cout << assimpTime / time << "x Assimp" << std::endl;
+	};
+	row("Assimp:", assimpTime);
+	row("native, 1 thread:", serialTime);
+	row("native, " + std::to_string(mgl::JobSystem::getInstance().getThreadCount()) + " threads:", parallelTime);
+	std::cout << "  mismatches:          " << mismatches << std::endl;
+}
+
+void runObjBenchmark(const StressSceneConfig& config) {
+	const std::string filename = benchFilePath("obj-bench.obj");
+	writeGridObj(filename, std::max(1u, static_cast<unsigned int>(glm::sqrt(config.objBenchTriangles / 2.0f))), true);
+	std::ifstream in(filename, std::ios::binary | std::ios::ate);
+	const double megabytes = static_cast<double>(in.tellg()) / (1024.0 * 1024.0);
+	in.close();
+	const unsigned long long runs = benchRuns(config);
+
+	size_t assimpTriangles = 0;
+	double assimpTime = 0.0;
+	for (unsigned long long run = 0; run < runs; run++) {
+		BenchClock::time_point start = BenchClock::now();
+		Assimp::Importer importer;
+		const aiScene* scene = importer.ReadFile(filename, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices);
+		assimpTime += benchMs(start);
+		assimpTriangles = 0;
+		for (unsigned int i = 0; scene && i < scene->mNumMeshes; i++) {
+			assimpTriangles += scene->mMeshes[i]->mNumFaces;
+		}
+	}
+
+	mgl::JobSystem serialJobs(0);
+	mgl::ObjLoader serial(serialJobs), parallel;
+	mgl::ObjData serialData, parallelData;
+	double serialTime = 0.0, parallelTime = 0.0;
+	for (unsigned long long run = 0; run < runs; run++) {
+		BenchClock::time_point start = BenchClock::now();
+		serial.load(filename, serialData);
+		serialTime += benchMs(start);
+		start = BenchClock::now();
+		parallel.load(filename, parallelData);
+		parallelTime += benchMs(start);
+	}
+	std::remove(filename.c_str());
+	const unsigned long long mismatches =
+		(serialData.Positions != parallelData.Positions) + (serialData.Normals != parallelData.Normals)
+		+ (serialData.Texcoords != parallelData.Texcoords) + (serialData.Indices != parallelData.Indices)
+		+ (serialData.Indices.size() / 3 != assimpTriangles);
+
+	std::cout << "OBJ loading benchmark: " << serialData.Indices.size() / 3 << " triangles, "
+		<< serialData.Positions.size() << " vertices, " << std::setprecision(3) << megabytes << " MB, "
+		<< runs << " runs" << std::endl;
+	printBenchRows(assimpTime, serialTime, parallelTime, runs, mismatches, megabytes);
+}
+
+void runMeshBenchmark(const StressSceneConfig& config) {
+	const std::string filename = benchFilePath("mesh-bench.obj");
+	writeGridObj(filename, std::max(1u, static_cast<unsigned int>(glm::sqrt(config.meshBenchTriangles / 2.0f))), false);
+	const unsigned long long runs = benchRuns(config);
+
+	size_t assimpVertices = 0;
+	double assimpTime = 0.0;
+	for (unsigned long long run = 0; run < runs; run++) {
+		Assimp::Importer importer;
+		importer.ReadFile(filename, aiProcess_Triangulate);
+		BenchClock::time_point start = BenchClock::now();
+		const aiScene* scene = importer.ApplyPostProcessing(
+			aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace);
+		assimpTime += benchMs(start);
+		assimpVertices = 0;
+		for (unsigned int i = 0; scene && i < scene->mNumMeshes; i++) {
+			assimpVertices += scene->mMeshes[i]->mNumVertices;
+		}
+	}
+
+	mgl::ObjData source;
+	mgl::ObjLoader().load(filename, source);
+	std::remove(filename.c_str());
+	mgl::JobSystem serialJobs(0);
+	mgl::MeshProcessor serial(serialJobs), parallel;
+	mgl::ObjData serialData, parallelData;
+	std::vector<glm::vec3> serialTangents, serialBitangents, parallelTangents, parallelBitangents;
+	auto process = [&](const mgl::MeshProcessor& processor, mgl::ObjData& data,
+		std::vector<glm::vec3>& tangents, std::vector<glm::vec3>& bitangents) {
+		data = source;
+		BenchClock::time_point start = BenchClock::now();
+		processor.weldVertices(data.Positions, data.Normals, data.Texcoords, data.Indices);
+		processor.computeSmoothNormals(data.Positions, data.Indices, data.Normals);
+		processor.computeTangents(data.Positions, data.Normals, data.Texcoords, data.Indices, tangents, bitangents);
+		return benchMs(start);
+	};
+	double serialTime = 0.0, parallelTime = 0.0;
+	for (unsigned long long run = 0; run < runs; run++) {
+		serialTime += process(serial, serialData, serialTangents, serialBitangents);
+		parallelTime += process(parallel, parallelData, parallelTangents, parallelBitangents);
+	}
+	const unsigned long long mismatches =
+		(serialData.Positions != parallelData.Positions) + (serialData.Normals != parallelData.Normals)
+		+ (serialData.Indices != parallelData.Indices) + (serialTangents != parallelTangents)
+		+ (serialBitangents != parallelBitangents);
+
+	std::cout << "Mesh processing benchmark: " << source.Indices.size() / 3 << " triangles, "
+		<< source.Positions.size() << " vertices welded to " << serialData.Positions.size()
+		<< " (Assimp " << assimpVertices << "), " << runs << " runs" << std::endl;
+	printBenchRows(assimpTime, serialTime, parallelTime, runs, mismatches);
+}
+
+void runClusterBuild(const StressSceneConfig& config) {
+	typedef std::chrono::steady_clock Clock;
+	auto ms = [](Clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+	};
+	Clock::time_point start = Clock::now();
+	mgl::ObjData data;
+	mgl::ObjLoader().load(config.clusterObj, data);
+	const double loadTime = ms(start);
+	start = Clock::now();
+	const size_t clusters = mgl::ClusterBuilder().build(data, config.clusterFile);
+	const double buildTime = ms(start);
+	std::ifstream out(config.clusterFile, std::ios::binary | std::ios::ate);
+	std::cout << "Clustered " << config.clusterObj << " into " << config.clusterFile << ": "
+		<< data.Indices.size() / 3 << " triangles, " << clusters << " clusters, "
+		<< static_cast<unsigned long long>(out.tellg()) << " bytes" << std::endl;
+	std::cout << "  load (ms):           " << loadTime << std::endl;
+	std::cout << "  cluster (ms):        " << buildTime << std::endl;
+}
+
+/** @brief Stand-in for a node update: composes `rounds` small transforms. */
+static float jobWork(size_t item, unsigned int rounds) {
+	glm::mat4 matrix(1.0f);
+	for (unsigned int r = 0; r < rounds; r++) {
+		matrix = glm::rotate(matrix, 0.01f * (item % 7 + 1), glm::vec3(0.0f, 1.0f, 0.0f));
+		matrix = glm::translate(matrix, glm::vec3(0.001f * r, 0.0f, 0.0f));
+	}
+	return matrix[3][0];
+}
+
+/** @brief Spawns jobs for both halves of [first, last) down to `leaf` items, like a subtree update. */
+static void jobTree(mgl::JobSystem& jobs, std::vector<float>& out, size_t first, size_t last, size_t leaf, mgl::JobCounter& counter) {
+	if (last - first <= leaf) {
+		for (size_t i = first; i < last; i++) out[i] = jobWork(i, 16);
+		return;
+	}
+	const size_t middle = first + (last - first) / 2;
+	jobs.run([&jobs, &out, first, middle, leaf, &counter]() { jobTree(jobs, out, first, middle, leaf, counter); }, &counter);
+	jobTree(jobs, out, middle, last, leaf, counter);
+}
+
+void runJobBenchmark(const StressSceneConfig& config) {
+	typedef std::chrono::steady_clock Clock;
+	auto ms = [](Clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+	};
+	const size_t n = config.jobBenchItems;
+	const unsigned int cores = std::max(std::thread::hardware_concurrency(), 1u);
+	const unsigned long long frames = std::max<unsigned long long>(std::min<unsigned long long>(config.frames, 50), 1);
+	auto irregularRounds = [](size_t i) { return 1u + static_cast<unsigned int>((i * 2654435761u) % 64); };
+
+	// Serial reference
+	std::vector<float> uniform(n), irregular(n), tree(n);
+	for (size_t i = 0; i < n; i++) {
+		uniform[i] = jobWork(i, 16);
+		irregular[i] = jobWork(i, irregularRounds(i));
+	}
+	double reference = 0.0;
+	for (size_t i = 0; i < n; i++) reference += uniform[i];
+
+	std::cout << "Job system benchmark: " << n << " items, " << frames << " repetitions, up to "
+		<< cores << " threads" << std::endl;
+	std::cout << "  threads  uniform (ms)  irregular (ms)  tree+reduce (ms)  speedup" << std::endl;
+	double baseline = 0.0;
+	unsigned long long mismatches = 0;
+	for (unsigned int threads = 1; threads <= cores; threads++) {
+		mgl::JobSystem jobs(threads - 1);
+		std::vector<float> out(n);
+		double uniformTime = 0.0, irregularTime = 0.0, treeTime = 0.0;
+		for (unsigned long long frame = 0; frame < frames; frame++) {
+			Clock::time_point start = Clock::now();
+			jobs.parallelFor(0, n, 0, [&](size_t first, size_t last) {
+				for (size_t i = first; i < last; i++) out[i] = jobWork(i, 16);
+			});
+			uniformTime += ms(start);
+			if (out != uniform) mismatches++;
+
+			start = Clock::now();
+			jobs.parallelFor(0, n, 64, [&](size_t first, size_t last) {
+				for (size_t i = first; i < last; i++) out[i] = jobWork(i, irregularRounds(i));
+			});
+			irregularTime += ms(start);
+			if (out != irregular) mismatches++;
+
+			start = Clock::now();
+			mgl::JobCounter built, reduced;
+			double sum = 0.0;
+			jobs.run([&]() { jobTree(jobs, tree, 0, n, 256, built); }, &built);
+			jobs.runAfter(built, [&]() {
+				for (size_t i = 0; i < n; i++) sum += tree[i];
+			}, &reduced);
+			jobs.wait(reduced);
+			treeTime += ms(start);
+			if (sum != reference) mismatches++;
+		}
+		const double total = (uniformTime + irregularTime + treeTime) / frames;
+		if (threads == 1) baseline = total;
+		std::cout << "  " << std::setw(7) << threads << std::setw(14) << uniformTime / frames
+			<< std::setw(16) << irregularTime / frames << std::setw(18) << treeTime / frames
+			<< std::setw(9) << baseline / total << "x" << std::endl;
+	}
+	std::cout << "  mismatches:          " << mismatches << std::endl;
+	// Scenegraph update: copies of an animated root with six animated children
+	StressSceneConfig sceneConfig = config;
+	sceneConfig.copies = static_cast<unsigned int>(std::max<size_t>(n / 8, 1));
+	sceneConfig.depth = 2;
+	mgl::Mesh marker; // never created; lets forEachMesh report every animated node
+	ScenegraphNode* root = ScenegraphNode::create();
+	StressSceneGenerator(sceneConfig).build(root, [&]() {
+		ScenegraphNode* copy = ScenegraphNode::create(&marker, nullptr, TransformTRS(), glm::vec4(1.0f));
+		copy->setAnimation(TransformTRS(glm::vec3(0.0f)), TransformTRS(glm::vec3(0.0f, 2.0f, 0.0f)));
+		for (int c = 0; c < 6; c++) {
+			ScenegraphNode* child = ScenegraphNode::create(&marker, nullptr, TransformTRS(), glm::vec4(1.0f));
+			child->setAnimation(TransformTRS(glm::vec3(0.0f)),
+				TransformTRS(glm::angleAxis(glm::radians(60.0f * c), glm::vec3(0.0f, 1.0f, 0.0f))));
+			copy->addChild(child);
+		}
+		return copy;
+	});
+	auto worldMatrices = [&]() {
+		std::vector<glm::mat4> matrices;
+		root->forEachMesh([&](ScenegraphNode&, mgl::Mesh&, const glm::mat4& world) { matrices.push_back(world); });
+		return matrices;
+	};
+	const float checkTime = 0.37f;
+	mgl::JobSystem serial(0);
+	ScenegraphNode::setParallelThreshold(0);
+	root->updateAnimation(checkTime, serial);
+	const std::vector<glm::mat4> serialMatrices = worldMatrices();
+
+	std::cout << "Scenegraph update: " << root->getSubtreeSize() << " nodes" << std::endl;
+	std::cout << "  threads  update (ms)  speedup" << std::endl;
+	ScenegraphNode::setParallelThreshold(1);
+	unsigned long long sceneMismatches = 0;
+	for (unsigned int threads = 1; threads <= cores; threads++) {
+		mgl::JobSystem jobs(threads - 1);
+		const Clock::time_point start = Clock::now();
+		for (unsigned long long frame = 0; frame < frames; frame++) {
+			root->updateAnimation(0.01f * frame, jobs);
+		}
+		const double updateTime = ms(start) / frames;
+		if (threads == 1) baseline = updateTime;
+		root->updateAnimation(checkTime, jobs);
+		const std::vector<glm::mat4> matrices = worldMatrices();
+		if (matrices.size() != serialMatrices.size() ||
+			std::memcmp(matrices.data(), serialMatrices.data(), sizeof(glm::mat4) * matrices.size()) != 0) {
+			sceneMismatches++;
+		}
+		std::cout << "  " << std::setw(7) << threads << std::setw(13) << updateTime
+			<< std::setw(9) << baseline / updateTime << "x" << std::endl;
+	}
+	std::cout << "  mismatches:          " << sceneMismatches << std::endl;
+	ScenegraphNode::setParallelThreshold(config.updateThreshold);
+	ScenegraphNode::destroy(root->getHandle());
+}
+
+void reportStressRun(const StressSceneConfig& config, const mgl::Engine& engine) {
+	const unsigned long long frames = engine.getFrameCount();
+	if (frames == 0) {
+		std::cout << "Stress run finished without rendering a frame." << std::endl;
+		return;
+	}
+	const mgl::FrameStats& total = engine.getTotalStats();
+	std::cout << "Stress scene: " << config.copies << " copies, "
+		<< (config.layout == StressLayout::Grid ? "grid" : "random") << " layout, depth "
+		<< config.depth << ", fan-out " << config.fanout << std::endl;
+	std::cout << "  frames:              " << frames << std::endl;
+	std::cout << "  frame time (ms):     avg " << 1000.0 * total.FrameTime / frames
+		<< ", min " << 1000.0 * engine.getMinFrameTime()
+		<< ", max " << 1000.0 * engine.getMaxFrameTime() << std::endl;
+	std::cout << "  draw calls/frame:    " << total.DrawCalls / frames << std::endl;
+	std::cout << "  state changes/frame: " << total.stateChanges() / frames << std::endl;
+	std::cout << "  triangles/frame:     " << total.Triangles / frames << std::endl;
+	std::cout << "  vertices/frame:      " << total.Vertices / frames << std::endl;
+	std::cout << "  uniforms/frame:      " << total.UniformUploads / frames << std::endl;
+	std::cout << "  animation (ms):      avg " << 1000.0 * total.AnimationTime / frames << std::endl;
+	const NodePool& nodes = ScenegraphNode::getPool();
+	std::cout << "  node pool:           " << nodes.size() << " nodes in " << nodes.getChunkCount()
+		<< " chunks, " << nodes.getMemoryUsage() << " bytes" << std::endl;
+	std::cout << "  nodes/frame:         " << total.NodesTraversed / frames
+		<< " traversed, " << total.NodesCulled / frames << " culled" << std::endl;
+	const mgl::GeometryMemory geometry = mgl::Mesh::getTotalMemory();
+	std::cout << "  mesh geometry:       " << geometry.CpuBytes << " CPU, " << geometry.MappedBytes
+		<< " mapped, " << geometry.GpuBytes << " GPU bytes" << std::endl;
+	const mgl::UploadQueue& uploads = mgl::UploadQueue::getInstance();
+	const double uploadTime = uploads.getUploadTime();
+	std::cout << "  uploads:             " << uploads.getUploadCount() << ", "
+		<< uploads.getUploadedBytes() << " bytes";
+	if (uploadTime > 0.0) {
+		std::cout << " at " << uploads.getUploadedBytes() / uploadTime / 1.0e6 << " MB/s";
+	}
+	std::cout << std::endl;
+	// The total includes uploads made before the first frame
+	std::cout << "  upload stall (ms):   avg " << 1000.0 * total.UploadTime / frames
+		<< ", max " << 1000.0 * uploads.getMaxStall()
+		<< ", total " << 1000.0 * uploads.getTotalStall() << std::endl;
+
+	const mgl::StatRange recent = engine.getStatRange(mgl::StatCounter::FrameTime);
+	std::cout << "  last " << engine.getStatsHistory().size() << " frames (ms): avg " << 1000.0 * recent.Avg
+		<< ", min " << 1000.0 * recent.Min << ", max " << 1000.0 * recent.Max << std::endl;
+
+	const mgl::FramePacer& pacer = engine.getFramePacer();
+	std::cout << "  fence wait (ms):     avg " << 1000.0 * pacer.getTotalFenceWait() / frames
+		<< ", max " << 1000.0 * pacer.getMaxFenceWait() << std::endl;
+	std::cout << "  limiter wait (ms):   avg " << 1000.0 * pacer.getTotalLimiterWait() / frames << std::endl;
+	if (pacer.getLatencySamples() > 0) {
+		std::cout << "  input latency (ms):  avg " << 1000.0 * pacer.getTotalLatency() / pacer.getLatencySamples()
+			<< ", max " << 1000.0 * pacer.getMaxLatency() << std::endl;
+	}
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <functional>
+#include <random>
+#include <string>
+#include "../mgl/mgl.hpp"
+#include "ScenegraphNode.h"
+
+/**
+ * @brief Placement of the generated copies on the XZ plane.
+ */
+enum class StressLayout { Grid, Random };
+
+/**
+ * @brief Parameters of a synthetic stress scene and of the run measuring it.
+ */
+typedef struct StressSceneConfig {
+	bool enabled = false;
+	unsigned int copies = 1000;
+	StressLayout layout = StressLayout::Grid;
+	unsigned int depth = 1;              // group levels between the root and the copies
+	unsigned int fanout = 8;             // children per group node
+	float spacing = 12.0f;               // distance between neighbouring copies
+	unsigned int seed = 18;
+	bool phased = true;                  // offset the animation of every copy
+	unsigned long long frames = 600;
+	bool headless = false;
+	bool gpuAnimation = false;           // animate the copies in the vertex shader
+	bool gpuTransforms = false;          // compute world matrices in a compute shader
+	bool parallelShaders = true;         // let the driver compile shaders on its own threads
+	bool boards = false;                 // a static board below every copy
+	bool staticBatching = false;         // merge static nodes into one draw per shader and colour
+	std::string colorDefine = "COLOR_SHADE"; // fragment colouring variant, see cube-fs.glsl
+	size_t updateThreshold = 4096;       // smallest subtree animated in parallel, 0 = serial
+	unsigned int bvhBenchNodes = 0;      // run the scene BVH benchmark instead of rendering
+	unsigned int jobBenchItems = 0;      // run the job system benchmark instead of rendering
+	unsigned int objBenchTriangles = 0;  // run the OBJ loading benchmark instead of rendering
+	unsigned int meshBenchTriangles = 0; // run the mesh processing benchmark instead of rendering
+	mgl::MeshResidency meshResidency = mgl::MeshResidency::Release; // CPU copies of the meshes after upload
+	std::string clusterObj, clusterFile;  // preprocess an OBJ into a cluster file instead of rendering
+	std::string streamFile;              // cluster file streamed into the scene
+	std::string cookPak;                 // cook the startup assets into a pak instead of rendering
+	std::string pakFile;                 // pak the startup assets are loaded from
+	unsigned long long streamBudget = 256ull << 20; // GPU bytes for resident clusters
+} StressSceneConfig;
+
+/**
+ * @brief Fills `config` from the command line.
+ *
+ * Recognised options: --stress N, --layout grid|random, --depth D, --fanout F,
+ * --spacing S, --seed S, --frames N, --no-phase, --headless, --bvh-bench N,
+ * --update-threshold N, --gpu-animation, --gpu-transforms, --serial-shaders,
+ * --boards, --static-batching,
+ * --jobs-bench N, --obj-bench N, --mesh-bench N,
+ * --mesh-residency release|keep|mapped,
+ * --color constant|position|uv|normal|diffuse|shade,
+ * --cluster-obj IN OUT, --stream FILE, --stream-budget MB,
+ * --cook-pak OUT, --pak FILE.
+ * Exits the process with a usage message on malformed arguments.
+ */
+void parseStressArgs(int argc, char* argv[], StressSceneConfig& config);
+
+/**
+ * @brief Instantiates a subtree many times under a hierarchy of group nodes.
+ *
+ * `depth` levels of empty group nodes with up to `fanout` children each are
+ * created below the parent, and the copies are spread round-robin over the
+ * deepest level. Group nodes carry no transform; each copy hangs below its own
+ * placement node, positioned in world space by the layout and carrying the
+ * copy's animation phase.
+ */
+class StressSceneGenerator {
+	public:
+		explicit StressSceneGenerator(const StressSceneConfig& config);
+		/** @brief Builds the groups and copies below `parent` using `createCopy` for each copy. */
+		void build(ScenegraphNode* parent, const std::function<ScenegraphNode*()>& createCopy);
+
+	private:
+		const StressSceneConfig& config;
+
+		glm::vec3 copyPosition(unsigned int index, std::mt19937& rng) const;
+		float copyPhase(unsigned int index, std::mt19937& rng) const;
+};
+
+/**
+ * @brief Times the dynamic scene BVH on `bvhBenchNodes` moving boxes, without a window.
+ *
+ * Every frame all boxes move, the tree is refitted, and batches of ray, overlap,
+ * frustum and k-nearest queries are run. Ray and overlap batches are also
+ * answered by a linear scan, which the results are checked against.
+ */
+void runBVHBenchmark(const StressSceneConfig& config);
+
+/**
+ * @brief Times loading an OBJ of `objBenchTriangles` triangles with Assimp and natively, without a window.
+ *
+ * A textured, lit grid of quads is written to obj-bench.obj in the temp
+ * directory (TMPDIR, TEMP or TMP) and loaded with Assimp (triangulating and
+ * joining vertices, as the meshes are), with the native loader on one thread
+ * and with it on every hardware thread. The native results are checked
+ * against each other and the triangle count against Assimp's. The file is
+ * removed afterwards.
+ */
+void runObjBenchmark(const StressSceneConfig& config);
+
+/**
+ * @brief Times welding, smooth normals and tangents on `meshBenchTriangles` triangles with Assimp and natively, without a window.
+ *
+ * A textured grid of quads with separate vertices for every triangle and no
+ * normals is written to mesh-bench.obj in the temp directory and
+ * post-processed by Assimp (JoinIdenticalVertices, GenSmoothNormals and
+ * CalcTangentSpace), and by mgl::MeshProcessor on one thread and on every
+ * hardware thread. The native results are checked against each other. The
+ * file is removed once loaded.
+ */
+void runMeshBenchmark(const StressSceneConfig& config);
+
+/**
+ * @brief Preprocesses the OBJ `clusterObj` into the cluster file `clusterFile` for streaming, without a window.
+ */
+void runClusterBuild(const StressSceneConfig& config);
+
+/**
+ * @brief Times the job system on synthetic workloads of `jobBenchItems` items, without a window.
+ *
+ * Each workload runs with 1 up to one thread per hardware thread: a uniform
+ * parallel-for, an irregular one that relies on stealing, and a tree of nested
+ * jobs followed by a dependent reduction. A stress scenegraph of about as many
+ * animated nodes is then updated with `ScenegraphNode::updateAnimation()` on
+ * each thread count. Results, including the scenegraph's world matrices, are
+ * checked bit for bit against a serial run.
+ */
+void runJobBenchmark(const StressSceneConfig& config);
+
+/**
+ * @brief Prints per-frame averages gathered by the engine during a stress run.
+ */
+void reportStressRun(const StressSceneConfig& config, const mgl::Engine& engine);
@@ -0,0 +1,28 @@
+// Colourings of cube-fs.glsl, from the interpolated vertex outputs.
+
+vec3 constantColor(void) {
+    return vec3(0.5);
+}
+
+vec3 positionColor(void) {
+    return (exPosition + vec3(1.0)) * 0.5;
+}
+
+vec3 uvColor(void) {
+    return vec3(exTexcoord, 0.0);
+}
+
+vec3 normalColor(void) {
+    return (exNormal + vec3(1.0)) * 0.5;
+}
+
+vec3 diffuseColor(void) {
+    vec3 N = normalize(exNormal);
+    vec3 direction = vec3(1.0, 0.5, 0.25);
+    float intensity = max(dot(direction, N), 0.0);
+    return vec3(intensity);
+}
+vec3 normalShadeColor(void) {
+    vec3 N = normalize(exNormal) * 0.1;
+    return vec3(exColor.x + N.x, exColor.y + N.y, exColor.z + N.z);
+}
@@ -0,0 +1,38 @@
+// Shared by the cube vertex shaders. Attributes a mesh lacks are left out of
+// its variant: HAS_NORMALS and HAS_TEXCOORDS say which ones it has.
+
+layout(location = 1) in vec3 inPosition;
+#ifdef HAS_NORMALS
+layout(location = 2) in vec3 inNormal;
+#endif
+#ifdef HAS_TEXCOORDS
+layout(location = 3) in vec2 inTexcoord;
+#endif
+
+out vec3 exPosition;
+out vec2 exTexcoord;
+out vec3 exNormal;
+out vec4 exColor;
+
+uniform vec4 inColor;
+
+uniform Camera {
+   mat4 ViewMatrix;
+   mat4 ProjectionMatrix;
+};
+
+void passAttributes(void)
+{
+	exPosition = inPosition;
+#ifdef HAS_NORMALS
+	exNormal = inNormal;
+#else
+	exNormal = vec3(0.0);
+#endif
+#ifdef HAS_TEXCOORDS
+	exTexcoord = inTexcoord;
+#else
+	exTexcoord = vec2(0.0);
+#endif
+	exColor = inColor;
+}
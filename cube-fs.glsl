@@ -7,41 +7,23 @@ in vec4 exColor;
 
 out vec4 FragmentColor;
 
-vec3 constantColor(void) {
-    return vec3(0.5);
-}
-
-vec3 positionColor(void) {
-    return (exPosition + vec3(1.0)) * 0.5;
-}
-
-vec3 uvColor(void) {
-    return vec3(exTexcoord, 0.0);
-}
-
-vec3 normalColor(void) {
-    return (exNormal + vec3(1.0)) * 0.5;
-}
-
-vec3 diffuseColor(void) {
-    vec3 N = normalize(exNormal);
-    vec3 direction = vec3(1.0, 0.5, 0.25);
-    float intensity = max(dot(direction, N), 0.0);
-    return vec3(intensity);
-}
-vec3 normalShadeColor(void) {
-    vec3 N = normalize(exNormal) * 0.1;
-    return vec3(exColor.x + N.x, exColor.y + N.y, exColor.z + N.z);
-}
+#include "colors.glsl"
 
+// Each colouring is its own variant, chosen with a COLOR_* define
 void main(void)
 {
-    vec3 color;
-    // color = constantColor();
-    // color = positionColor();
-    // color = uvColor();
-    // color = normalColor();
-    // color = diffuseColor();
-    color = normalShadeColor();
+#if defined(COLOR_CONSTANT)
+    vec3 color = constantColor();
+#elif defined(COLOR_POSITION)
+    vec3 color = positionColor();
+#elif defined(COLOR_UV)
+    vec3 color = uvColor();
+#elif defined(COLOR_NORMAL)
+    vec3 color = normalColor();
+#elif defined(COLOR_DIFFUSE)
+    vec3 color = diffuseColor();
+#else
+    vec3 color = normalShadeColor();
+#endif
     FragmentColor = vec4(color, 1.0);
 }
@@ -0,0 +1,18 @@
+#version 430 core
+
+#include "cube-common-vs.glsl"
+
+uniform uint TransformIndex;
+
+// Written by hierarchy-cs.glsl
+layout(std430, binding = 4) readonly buffer WorldTransforms {
+	mat4 Worlds[];
+};
+
+void main(void)
+{
+	passAttributes();
+
+	vec4 MCPosition = vec4(inPosition, 1.0);
+	gl_Position = ProjectionMatrix * ViewMatrix * Worlds[TransformIndex] * MCPosition;
+}
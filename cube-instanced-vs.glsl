@@ -0,0 +1,85 @@
+#version 430 core
+
+#include "cube-common-vs.glsl"
+
+uniform mat4 ModelMatrix;
+uniform float AnimationTime;
+uniform uint InstanceOffset;
+
+struct AnimationLayer {
+	vec4 StartTranslation;
+	vec4 EndTranslation;
+	vec4 StartRotation;
+	vec4 EndRotation;
+	vec4 StartScale;
+	vec4 EndScale;
+};
+
+struct AnimatedInstance {
+	mat4 Base;
+	float Phase;
+	uint LayerFirst;
+	uint LayerCount;
+	uint Padding;
+};
+
+layout(std430, binding = 0) readonly buffer AnimationLayers {
+	AnimationLayer Layers[];
+};
+
+layout(std430, binding = 1) readonly buffer AnimatedInstances {
+	AnimatedInstance Instances[];
+};
+
+// Same as glm::slerp: shortest arc, linear when the rotations nearly coincide
+vec4 slerp(vec4 a, vec4 b, float t)
+{
+	float cosTheta = dot(a, b);
+	if (cosTheta < 0.0) {
+		b = -b;
+		cosTheta = -cosTheta;
+	}
+	if (cosTheta > 1.0 - 1.19209290e-7) {
+		return mix(a, b, t);
+	}
+	float angle = acos(cosTheta);
+	return (sin((1.0 - t) * angle) * a + sin(t * angle) * b) / sin(angle);
+}
+
+// T * R * S of one layer at t, like mgl::AnimationTrack::evaluate
+mat4 layerMatrix(AnimationLayer layer, float t)
+{
+	vec3 T = mix(layer.StartTranslation.xyz, layer.EndTranslation.xyz, t);
+	vec4 q = slerp(layer.StartRotation, layer.EndRotation, t);
+	vec3 S = mix(layer.StartScale.xyz, layer.EndScale.xyz, t);
+
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+	mat3 R = mat3(
+		1.0 - 2.0 * (yy + zz), 2.0 * (xy + wz), 2.0 * (xz - wy),
+		2.0 * (xy - wz), 1.0 - 2.0 * (xx + zz), 2.0 * (yz + wx),
+		2.0 * (xz + wy), 2.0 * (yz - wx), 1.0 - 2.0 * (xx + yy));
+	return mat4(vec4(R[0] * S.x, 0.0), vec4(R[1] * S.y, 0.0), vec4(R[2] * S.z, 0.0), vec4(T, 1.0));
+}
+
+void main(void)
+{
+	AnimatedInstance instance = Instances[InstanceOffset + gl_InstanceID];
+	float t = AnimationTime;
+	if (instance.Phase != 0.0) {
+		// Ping-pong, as ScenegraphNode::updateAnimation does for phased nodes
+		t = 1.0 - abs(1.0 - mod(t + instance.Phase, 2.0));
+	}
+	t = clamp(t, 0.0, 1.0);
+
+	mat4 model = ModelMatrix * instance.Base;
+	for (uint i = 0; i < instance.LayerCount; i++) {
+		model = model * layerMatrix(Layers[instance.LayerFirst + i], t);
+	}
+
+	passAttributes();
+
+	vec4 MCPosition = vec4(inPosition, 1.0);
+	gl_Position = ProjectionMatrix * ViewMatrix * model * MCPosition;
+}
@@ -1,28 +1,12 @@
 #version 330 core
 
-layout(location = 1) in vec3 inPosition;
-layout(location = 2) in vec3 inNormal;
-layout(location = 3) in vec2 inTexcoord;
-
-out vec3 exPosition;
-out vec2 exTexcoord;
-out vec3 exNormal;
-out vec4 exColor;
+#include "cube-common-vs.glsl"
 
 uniform mat4 ModelMatrix;
-uniform vec4 inColor;
-
-uniform Camera {
-   mat4 ViewMatrix;
-   mat4 ProjectionMatrix;
-};
 
 void main(void)
 {
-	exPosition = inPosition;
-	exNormal = inNormal;
-	exTexcoord = inTexcoord;
-	exColor = inColor;
+	passAttributes();
 
 	vec4 MCPosition = vec4(inPosition, 1.0);
 	gl_Position = ProjectionMatrix * ViewMatrix * ModelMatrix * MCPosition;
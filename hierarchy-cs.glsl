@@ -0,0 +1,29 @@
+#version 430 core
+
+layout(local_size_x = 64) in;
+
+layout(std430, binding = 2) readonly buffer LocalTransforms {
+	mat4 Locals[];
+};
+
+layout(std430, binding = 3) readonly buffer ParentIndices {
+	int Parents[];
+};
+
+layout(std430, binding = 4) buffer WorldTransforms {
+	mat4 Worlds[];
+};
+
+uniform uint LevelFirst;
+uniform uint LevelCount;
+
+// One level of the hierarchy; the parents were written by the previous dispatch
+void main(void)
+{
+	if (gl_GlobalInvocationID.x >= LevelCount) {
+		return;
+	}
+	uint node = LevelFirst + gl_GlobalInvocationID.x;
+	int parent = Parents[node];
+	Worlds[node] = parent < 0 ? Locals[node] : Worlds[parent] * Locals[node];
+}